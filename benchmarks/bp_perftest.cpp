@@ -0,0 +1,101 @@
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "tbb/global_control.h"
+
+#include "forward_index.hpp"
+#include "recursive_graph_bisection.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+
+using pisa::do_not_optimize_away;
+using pisa::get_time_usecs;
+
+/// Measures the term gains computed per second by `bp::compute_term_gains` and one at a time.
+void perftest_term_gains(std::size_t term_count)
+{
+    std::mt19937 gen(42);
+    // Degrees of terms in Zipfian collections are mostly small.
+    std::geometric_distribution<uint32_t> degree(0.01);
+    std::vector<uint32_t> from_degrees(term_count);
+    std::vector<uint32_t> to_degrees(term_count);
+    for (std::size_t pos = 0; pos < term_count; ++pos) {
+        from_degrees[pos] = degree(gen) + 1;
+        to_degrees[pos] = degree(gen);
+    }
+    std::vector<double> gains(term_count);
+    float logn1 = std::log2(1'000'000);
+    float logn2 = std::log2(1'000'000);
+    std::size_t const runs = 20;
+
+    auto tick = get_time_usecs();
+    for (std::size_t run = 0; run < runs; ++run) {
+        pisa::bp::compute_term_gains(
+            logn1, logn2, from_degrees.data(), to_degrees.data(), gains.data(), term_count);
+        do_not_optimize_away(gains[run]);
+    }
+    double batched = get_time_usecs() - tick;
+
+    tick = get_time_usecs();
+    for (std::size_t run = 0; run < runs; ++run) {
+        for (std::size_t pos = 0; pos < term_count; ++pos) {
+            gains[pos] = pisa::bp::term_gain(logn1, logn2, from_degrees[pos], to_degrees[pos]);
+        }
+        do_not_optimize_away(gains[run]);
+    }
+    double scalar = get_time_usecs() - tick;
+    spdlog::info(
+        "Term gains: batched {:.1f} M/s, scalar {:.1f} M/s",
+        runs * term_count / batched,
+        runs * term_count / scalar);
+}
+
+/// Measures the iterations per second of the first partition of graph bisection.
+void perftest_bisection(pisa::flat_forward_index const& fwd, int iterations)
+{
+    std::vector<uint32_t> documents(fwd.size());
+    std::iota(documents.begin(), documents.end(), 0U);
+    std::vector<double> gains(fwd.size(), 0.0);
+    pisa::document_range<std::vector<uint32_t>::iterator> range(
+        documents.begin(), documents.end(), fwd, gains);
+    auto partition = range.split();
+    pisa::bp::ThreadLocal thread_local_data;
+
+    auto tick = get_time_usecs();
+    pisa::process_partition(
+        partition,
+        pisa::compute_move_gains_caching<true, std::vector<uint32_t>::iterator>,
+        thread_local_data,
+        iterations);
+    double elapsed = get_time_usecs() - tick;
+    spdlog::info(
+        "Bisection of {} documents: {} iterations in {:.1f} ms, {:.2f} iterations/s",
+        fwd.size(),
+        iterations,
+        elapsed / 1000,
+        iterations / (elapsed / 1e6));
+}
+
+int main(int argc, const char** argv)
+{
+    if (argc < 2 || argc > 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <collection basename> [iterations] [threads] [--nogb]" << std::endl;
+        return 1;
+    }
+    std::string input_basename = argv[1];
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 20;
+    std::size_t threads = argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+    bool compressed = not(argc > 4 && std::string(argv[4]) == "--nogb");
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, threads);
+
+    auto flat_fwd = pisa::flat_forward_index::from_inverted_index(input_basename, 0, compressed);
+    perftest_term_gains(flat_fwd.term_count());
+    perftest_bisection(flat_fwd, iterations);
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "index_types.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+
+using pisa::do_not_optimize_away;
+using pisa::get_time_usecs;
+
+template <typename IndexType>
+struct block_size_of;
+
+template <typename BlockCodec>
+struct block_size_of<pisa::block_freq_index<BlockCodec>> {
+    static constexpr std::size_t value = BlockCodec::block_size;
+};
+
+/// Opens the cursors of short queries and reads their first postings, which is all the work
+/// done for the many queries whose terms have short posting lists. With `allocate`, each cursor
+/// also allocates two block-sized buffers, as enumerators did before their decode buffers
+/// were stored inline, to show the overhead removed.
+template <typename IndexType, bool allocate>
+double run(IndexType const& index, std::vector<std::vector<std::size_t>> const& queries, int runs)
+{
+    using enumerator_type = typename IndexType::document_enumerator;
+    constexpr std::size_t block_size = block_size_of<IndexType>::value;
+    auto tick = get_time_usecs();
+    for (int run = 0; run < runs; ++run) {
+        for (auto const& query: queries) {
+            std::vector<enumerator_type> cursors;
+            std::vector<std::vector<uint32_t>> buffers;
+            cursors.reserve(query.size());
+            for (auto term: query) {
+                cursors.push_back(index[term]);
+                if constexpr (allocate) {
+                    buffers.emplace_back(block_size);
+                    buffers.emplace_back(block_size);
+                }
+            }
+            for (auto& cursor: cursors) {
+                for (int posting = 0; posting < 4 && cursor.docid() < index.num_docs(); ++posting) {
+                    do_not_optimize_away(cursor.freq());
+                    cursor.next();
+                }
+            }
+            do_not_optimize_away(buffers.size());
+        }
+    }
+    double elapsed = get_time_usecs() - tick;
+    return 1000 * elapsed / (static_cast<double>(runs) * queries.size());
+}
+
+template <typename IndexType>
+void perftest(const char* index_filename, std::string const& type)
+{
+    spdlog::info("Loading index from {}", index_filename);
+    IndexType index(pisa::MemorySource::mapped_file(std::string(index_filename)));
+
+    std::size_t max_length = 1024;
+    std::vector<std::size_t> short_lists;
+    for (std::size_t term = 0; term < index.size(); ++term) {
+        if (index[term].size() <= max_length) {
+            short_lists.push_back(term);
+        }
+    }
+    if (short_lists.empty()) {
+        spdlog::error("No posting lists shorter than {}", max_length);
+        return;
+    }
+
+    std::mt19937 rng(1729);
+    std::uniform_int_distribution<std::size_t> terms(0, short_lists.size() - 1);
+    for (std::size_t query_length = 1; query_length <= 4; ++query_length) {
+        std::vector<std::vector<std::size_t>> queries(100'000);
+        for (auto& query: queries) {
+            std::generate_n(std::back_inserter(query), query_length, [&] {
+                return short_lists[terms(rng)];
+            });
+        }
+        auto inline_ns = run<IndexType, false>(index, queries, 5);
+        auto allocated_ns = run<IndexType, true>(index, queries, 5);
+        spdlog::info(
+            "{} terms: {:.1f} ns per query with inline buffers, {:.1f} ns with allocated buffers",
+            query_length,
+            inline_ns,
+            allocated_ns);
+        spdlog::info("{}\topen\t{}\t{:.1f}\t{:.1f}", type, query_length, inline_ns, allocated_ns);
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    using namespace pisa;
+
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <index type> <index filename>" << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    const char* index_filename = argv[2];
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                    \
+    }                                                            \
+    else if (type == BOOST_PP_STRINGIZE(T))                      \
+    {                                                            \
+        perftest<BOOST_PP_CAT(T, _index)>(index_filename, type); \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_BLOCK_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}, only block indexes are supported", type);
+    }
+}
@@ -1,5 +1,3 @@
-#include "mappable/mapper.hpp"
-#include "mio/mmap.hpp"
 #include "spdlog/spdlog.h"
 
 #include "index_types.hpp"
@@ -59,7 +57,8 @@ void perftest(IndexType const& index, std::string const& type)
 
     uint64_t min_calls_per_list = 100;
     uint64_t max_calls_per_list = 20000;
-    for (uint64_t skip = 1; skip <= 16384; skip <<= 1) {
+    // Long skips cross thousands of blocks, as in selective conjunctive queries.
+    for (uint64_t skip = 1; skip <= (1U << 20U); skip <<= 1) {
         uint64_t min_length = min_calls_per_list * skip;
         std::vector<std::pair<size_t, std::vector<uint64_t>>> skip_values;
         for (size_t i = 0; i < index.size(); ++i) {
@@ -76,6 +75,11 @@ void perftest(IndexType const& index, std::string const& type)
             }
         }
 
+        if (skip_values.empty()) {
+            spdlog::info("No posting lists long enough for skip={}", skip);
+            break;
+        }
+
         auto tick = get_time_usecs();
         size_t calls = 0;
         for (auto const& p: skip_values) {
@@ -103,16 +107,34 @@ void perftest(IndexType const& index, std::string const& type)
     }
 }
 
+/// Block indexes whose enumerators materialize absolute docids of each decoded block.
+template <typename IndexType>
+struct with_absolute_docs {
+    using type = void;
+};
+
+template <typename BlockCodec>
+struct with_absolute_docs<pisa::block_freq_index<BlockCodec, false, false>> {
+    using type = pisa::block_freq_index<BlockCodec, false, true>;
+};
+
 template <typename IndexType>
 void perftest(const char* index_filename, std::string const& type)
 {
     spdlog::info("Loading index from {}", index_filename);
-    IndexType index;
-    mio::mmap_source m(index_filename);
-    pisa::mapper::map(index, m, pisa::mapper::map_flags::warmup);
+    IndexType index(pisa::MemorySource::mapped_file(std::string(index_filename)));
 
     perftest<IndexType, false>(index, type);
     perftest<IndexType, true>(index, type);
+
+    using absolute_index_type = typename with_absolute_docs<IndexType>::type;
+    if constexpr (not std::is_void_v<absolute_index_type>) {
+        spdlog::info("Materializing absolute docids of each block");
+        absolute_index_type absolute_index(
+            pisa::MemorySource::mapped_file(std::string(index_filename)), 0);
+        perftest<absolute_index_type, false>(absolute_index, type + "+absolute");
+        perftest<absolute_index_type, true>(absolute_index, type + "+absolute");
+    }
 }
 
 int main(int argc, const char** argv)
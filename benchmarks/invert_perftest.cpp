@@ -0,0 +1,182 @@
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "tbb/global_control.h"
+
+#include "binary_collection.hpp"
+#include "invert.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+
+using pisa::Document_Id;
+using pisa::do_not_optimize_away;
+using pisa::Frequency;
+using pisa::get_time_usecs;
+using pisa::Term_Id;
+
+namespace {
+
+std::atomic<std::size_t> allocated_bytes{0};
+std::atomic<std::size_t> peak_bytes{0};
+
+void track_allocation(void* ptr)
+{
+    auto allocated = allocated_bytes.fetch_add(malloc_usable_size(ptr)) + malloc_usable_size(ptr);
+    auto peak = peak_bytes.load();
+    while (allocated > peak && not peak_bytes.compare_exchange_weak(peak, allocated)) {
+    }
+}
+
+}  // namespace
+
+void* operator new(std::size_t size)
+{
+    void* ptr = std::malloc(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    track_allocation(ptr);
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr != nullptr) {
+        allocated_bytes -= malloc_usable_size(ptr);
+        std::free(ptr);
+    }
+}
+
+struct RunStats {
+    double elapsed_usecs;
+    std::size_t peak_bytes;
+};
+
+/// Runs `fn` and measures its time and the peak memory it allocates.
+template <typename Fn>
+RunStats measure(Fn fn)
+{
+    auto base = allocated_bytes.load();
+    peak_bytes = base;
+    auto tick = get_time_usecs();
+    fn();
+    double elapsed = get_time_usecs() - tick;
+    return {elapsed, peak_bytes.load() - base};
+}
+
+/// Inverts `documents` as `invert_range` did before counting postings: by materializing
+/// (term, document) pairs, sorting them, and grouping them by term into hash maps.
+std::size_t invert_by_sorting(
+    gsl::span<gsl::span<Term_Id const>> documents, Document_Id first_document_id, size_t threads)
+{
+    std::size_t chunk_size = (documents.size() + threads - 1) / threads;
+    std::vector<std::vector<std::pair<Term_Id, Document_Id>>> chunks(threads);
+    tbb::parallel_for(std::size_t(0), threads, [&](auto c) {
+        auto first = std::min(c * chunk_size, documents.size());
+        auto last = std::min(first + chunk_size, documents.size());
+        auto docid = first_document_id + Document_Id(first);
+        for (auto const& document: documents.subspan(first, last - first)) {
+            for (auto term: document) {
+                chunks[c].emplace_back(term, docid);
+            }
+            ++docid;
+        }
+    });
+    std::vector<std::pair<Term_Id, Document_Id>> postings;
+    for (auto const& chunk: chunks) {
+        postings.insert(postings.end(), chunk.begin(), chunk.end());
+    }
+    chunks.clear();
+    chunks.shrink_to_fit();
+    std::sort(pstl::execution::par_unseq, postings.begin(), postings.end());
+
+    std::unordered_map<Term_Id, std::vector<Document_Id>> lists;
+    std::unordered_map<Term_Id, std::vector<Frequency>> frequencies;
+    for (auto first = postings.begin(); first != postings.end();) {
+        auto last = std::find_if(first, postings.end(), [&](auto const& p) { return p != *first; });
+        lists[first->first].push_back(first->second);
+        frequencies[first->first].push_back(Frequency(std::distance(first, last)));
+        first = last;
+    }
+    return lists.size();
+}
+
+int main(int argc, const char** argv)
+{
+    if (argc < 2 || argc > 4) {
+        std::cerr << "Usage: " << argv[0] << " <forward index> [batch size] [threads]"
+                  << std::endl;
+        return 1;
+    }
+    std::string input_basename = argv[1];
+    std::size_t batch_size = argc > 2 ? std::stoul(argv[2]) : 100'000;
+    std::size_t threads = argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, threads + 1);
+
+    pisa::binary_collection coll(input_basename.c_str());
+    std::size_t term_count = 0;
+    for (auto doc_iter = ++coll.begin(); doc_iter != coll.end(); ++doc_iter) {
+        for (auto term: *doc_iter) {
+            term_count = std::max<std::size_t>(term_count, term + 1);
+        }
+    }
+    spdlog::info("{} terms, batches of {} documents, {} threads", term_count, batch_size, threads);
+
+    RunStats counting_total{0, 0};
+    RunStats sorting_total{0, 0};
+    std::size_t batch = 0;
+    std::size_t first_document = 0;
+    for (auto doc_iter = ++coll.begin(); doc_iter != coll.end(); ++batch) {
+        std::vector<gsl::span<Term_Id const>> documents;
+        std::size_t occurrences = 0;
+        for (; doc_iter != coll.end() && documents.size() < batch_size; ++doc_iter) {
+            auto document = *doc_iter;
+            documents.emplace_back(
+                reinterpret_cast<Term_Id const*>(document.begin()), document.size());
+            occurrences += document.size();
+        }
+        auto first_document_id = Document_Id(first_document);
+        std::size_t postings = 0;
+        auto counting = measure([&] {
+            auto lists =
+                pisa::invert::invert_range(documents, first_document_id, term_count, threads);
+            postings = lists.documents.size();
+        });
+        auto sorting = measure([&] {
+            do_not_optimize_away(invert_by_sorting(documents, first_document_id, threads));
+        });
+        spdlog::info(
+            "Batch {}: {} documents, {} occurrences, {} postings",
+            batch,
+            documents.size(),
+            occurrences,
+            postings);
+        spdlog::info(
+            "\tcounting: {:.1f} ms, {:.1f} MiB; sorting: {:.1f} ms, {:.1f} MiB",
+            counting.elapsed_usecs / 1000,
+            counting.peak_bytes / 1048576.0,
+            sorting.elapsed_usecs / 1000,
+            sorting.peak_bytes / 1048576.0);
+        counting_total.elapsed_usecs += counting.elapsed_usecs;
+        counting_total.peak_bytes = std::max(counting_total.peak_bytes, counting.peak_bytes);
+        sorting_total.elapsed_usecs += sorting.elapsed_usecs;
+        sorting_total.peak_bytes = std::max(sorting_total.peak_bytes, sorting.peak_bytes);
+        first_document += documents.size();
+    }
+    spdlog::info(
+        "Total: counting {:.1f} s, peak {:.1f} MiB; sorting {:.1f} s, peak {:.1f} MiB",
+        counting_total.elapsed_usecs / 1e6,
+        counting_total.peak_bytes / 1048576.0,
+        sorting_total.elapsed_usecs / 1e6,
+        sorting_total.peak_bytes / 1048576.0);
+}
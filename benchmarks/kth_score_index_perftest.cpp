@@ -0,0 +1,58 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "kth_score_index.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+
+using pisa::do_not_optimize_away;
+using pisa::get_time_usecs;
+using pisa::KthScoreIndex;
+using pisa::term_id_type;
+
+double lookup_nsecs(
+    KthScoreIndex const& kth_scores, std::vector<KthScoreIndex::term_pair> const& lookups, int runs)
+{
+    float sum = 0.0F;
+    auto tick = get_time_usecs();
+    for (int run = 0; run < runs; ++run) {
+        for (auto const& [left, right]: lookups) {
+            sum += kth_scores.pair_score(left, right, 0).value_or(0.0F);
+        }
+    }
+    double elapsed = get_time_usecs() - tick;
+    do_not_optimize_away(sum);
+    return 1000 * elapsed / (static_cast<double>(runs) * lookups.size());
+}
+
+int main(int argc, const char** argv)
+{
+    std::size_t num_pairs = argc > 1 ? std::stoul(argv[1]) : 1U << 22U;
+    std::size_t num_lookups = argc > 2 ? std::stoul(argv[2]) : 1U << 20U;
+    term_id_type num_terms = 1U << 24U;
+    std::vector<std::uint64_t> ks{10, 100, 1000};
+
+    spdlog::info("Building index of {} pairs", num_pairs);
+    std::mt19937 rng(1729);
+    std::uniform_int_distribution<term_id_type> terms(0, num_terms - 1);
+    std::vector<std::pair<KthScoreIndex::term_pair, std::vector<float>>> pairs;
+    pairs.reserve(num_pairs);
+    for (std::size_t idx = 0; idx < num_pairs; ++idx) {
+        pairs.push_back({{terms(rng), terms(rng)}, {3.0F, 2.0F, 1.0F}});
+    }
+    KthScoreIndex kth_scores(ks, {}, pairs);
+
+    std::vector<KthScoreIndex::term_pair> hits;
+    std::vector<KthScoreIndex::term_pair> misses;
+    std::uniform_int_distribution<std::size_t> positions(0, num_pairs - 1);
+    for (std::size_t idx = 0; idx < num_lookups; ++idx) {
+        hits.push_back(pairs[positions(rng)].first);
+        misses.emplace_back(terms(rng), terms(rng));
+    }
+
+    spdlog::info("Stored pairs: {:.1f} ns per lookup", lookup_nsecs(kth_scores, hits, 5));
+    spdlog::info("Random pairs: {:.1f} ns per lookup", lookup_nsecs(kth_scores, misses, 5));
+}
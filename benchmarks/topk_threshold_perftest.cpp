@@ -0,0 +1,104 @@
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "topk_queue.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+
+using pisa::do_not_optimize_away;
+using pisa::get_time_usecs;
+using pisa::Threshold;
+using pisa::topk_queue;
+
+struct RunStats {
+    double elapsed_usecs;
+    std::size_t scored;
+    float kth_score;
+};
+
+RunStats run(std::vector<float> const& scores, std::size_t threads, std::size_t k, bool shared)
+{
+    std::atomic<Threshold> shared_threshold(0.0F);
+    std::vector<topk_queue> queues(threads, topk_queue(k));
+    std::vector<std::size_t> scored(threads, 0);
+    std::size_t const chunk = (scores.size() + threads - 1) / threads;
+
+    auto tick = get_time_usecs();
+    std::vector<std::thread> workers;
+    for (std::size_t thread_idx = 0; thread_idx < threads; ++thread_idx) {
+        workers.emplace_back([&, thread_idx] {
+            auto& topk = queues[thread_idx];
+            if (shared) {
+                topk.set_shared_threshold(&shared_threshold);
+            }
+            auto first = std::min(thread_idx * chunk, scores.size());
+            auto last = std::min(first + chunk, scores.size());
+            std::size_t count = 0;
+            for (auto docid = first; docid < last; ++docid) {
+                if (topk.would_enter(scores[docid])) {
+                    // Pull the bound found by other threads before the expensive work.
+                    topk.refresh_threshold();
+                    if (not topk.would_enter(scores[docid])) {
+                        continue;
+                    }
+                    ++count;
+                    topk.insert(scores[docid], docid);
+                }
+            }
+            scored[thread_idx] = count;
+        });
+    }
+    for (auto& worker: workers) {
+        worker.join();
+    }
+    double elapsed = get_time_usecs() - tick;
+
+    topk_queue merged(k);
+    std::size_t total_scored = 0;
+    for (std::size_t thread_idx = 0; thread_idx < threads; ++thread_idx) {
+        for (auto const& [score, docid]: queues[thread_idx].topk()) {
+            merged.insert(score, docid);
+        }
+        total_scored += scored[thread_idx];
+    }
+    merged.finalize();
+    do_not_optimize_away(merged.topk().size());
+    return {elapsed, total_scored, merged.topk().empty() ? 0.0F : merged.topk().back().first};
+}
+
+int main(int argc, const char** argv)
+{
+    std::size_t max_threads = argc > 1 ? std::stoul(argv[1]) : std::thread::hardware_concurrency();
+    std::size_t k = argc > 2 ? std::stoul(argv[2]) : 10;
+    std::size_t num_docs = argc > 3 ? std::stoul(argv[3]) : 1U << 24U;
+
+    // Scores grow with docids, as in an index ordered by document quality,
+    // so that the ranges processed by different threads have different thresholds.
+    spdlog::info("Generating {} scores", num_docs);
+    std::mt19937 rng(1729);
+    std::exponential_distribution<float> distribution(1.0F);
+    std::vector<float> scores(num_docs);
+    for (std::size_t docid = 0; docid < num_docs; ++docid) {
+        scores[docid] = distribution(rng) * (1.0F + 2.0F * docid / num_docs);
+    }
+
+    for (std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+        for (bool shared: {false, true}) {
+            auto stats = run(scores, threads, k, shared);
+            spdlog::info(
+                "threads = {}; {}: scored {} of {} documents ({:.4f}%) in {:.1f} ms; k-th score = {}",
+                threads,
+                shared ? "shared threshold" : "independent heaps",
+                stats.scored,
+                num_docs,
+                100.0 * stats.scored / num_docs,
+                stats.elapsed_usecs / 1000,
+                stats.kth_score);
+        }
+    }
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <gsl/span>
+
 #include "bit_vector.hpp"
 
 #include "codec/compact_elias_fano.hpp"
@@ -17,7 +19,7 @@ class bitvector_collection {
             m_endpoints.push_back(0);
         }
 
-        void append(bit_vector_builder& bvb)
+        void append(bit_vector_builder const& bvb)
         {
             m_bitvectors.append(bvb);
             m_endpoints.push_back(m_bitvectors.size());
@@ -44,6 +46,8 @@ class bitvector_collection {
 
     bit_vector const& bits() const { return m_bitvectors; }
 
+    bit_vector const& endpoints() const { return m_endpoints; }
+
     bit_vector::enumerator get(global_parameters const& params, size_t i) const
     {
         assert(i < size());
@@ -53,6 +57,29 @@ class bitvector_collection {
         return bit_vector::enumerator(m_bitvectors, endpoint);
     }
 
+    /// Positions of the first bit of bit vector `i` and past its last bit.
+    std::pair<uint64_t, uint64_t> bit_range(global_parameters const& params, size_t i) const
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_bitvectors.size(), m_size, params);
+
+        auto begin = endpoints.move(i).second;
+        auto end = i + 1 == size() ? m_bitvectors.size() : endpoints.move(i + 1).second;
+        return {begin, end};
+    }
+
+    /// Memory holding the words of bit vector `i`.
+    gsl::span<char const> memory(global_parameters const& params, size_t i) const
+    {
+        auto [begin, end] = bit_range(params, i);
+        auto const* words = m_bitvectors.data().data();
+        auto first_word = begin / 64;
+        auto last_word = (end + 63) / 64;
+        return gsl::make_span(
+            reinterpret_cast<char const*>(words + first_word),
+            (last_word - first_word) * sizeof(uint64_t));
+    }
+
     void swap(bitvector_collection& other)
     {
         std::swap(m_size, other.m_size);
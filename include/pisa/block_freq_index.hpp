@@ -1,27 +1,33 @@
 #pragma once
 
+#include <gsl/span>
+
 #include "bit_vector.hpp"
 #include "mappable/mappable_vector.hpp"
 #include "mappable/mapper.hpp"
 
 #include "block_posting_list.hpp"
 #include "codec/compact_elias_fano.hpp"
+#include "index_header.hpp"
 #include "mappable/mapper.hpp"
 #include "memory_source.hpp"
 #include "temporary_directory.hpp"
+#include "util/xxhash.hpp"
 
 namespace pisa {
 
 struct BlockIndexTag;
 
-template <typename BlockCodec, bool Profile = false>
+template <typename BlockCodec, bool Profile = false, bool AbsoluteDocs = false>
 class block_freq_index {
   public:
     using index_layout_tag = BlockIndexTag;
     block_freq_index() = default;
-    explicit block_freq_index(MemorySource source) : m_source(std::move(source))
+    /// Maps the index in `source`, verifying its checksums if `flags` has `map_flags::warmup`.
+    explicit block_freq_index(MemorySource source, uint64_t flags = mapper::map_flags::warmup)
+        : m_source(std::move(source))
     {
-        mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
+        map_index(*this, m_source, flags);
     }
 
     class builder {
@@ -32,6 +38,9 @@ class block_freq_index {
             m_endpoints.push_back(0);
         }
 
+        /// A posting list encoded by `encode_posting_list`, not yet added to the index.
+        using encoded_posting_list = std::vector<uint8_t>;
+
         template <typename DocsIterator, typename FreqsIterator>
         void add_posting_list(
             uint64_t n,
@@ -46,6 +55,25 @@ class block_freq_index {
             m_endpoints.push_back(m_lists.size());
         }
 
+        /// Encodes a posting list into `list` without modifying the builder, so that lists can
+        /// be encoded concurrently and then added in order with `add_encoded_posting_list`.
+        template <typename DocsIterator, typename FreqsIterator>
+        void encode_posting_list(
+            encoded_posting_list& list,
+            uint64_t n,
+            DocsIterator docs_begin,
+            FreqsIterator freqs_begin,
+            uint64_t /* occurrences */) const
+        {
+            if (!n) {
+                throw std::invalid_argument("List must be nonempty");
+            }
+            list.clear();
+            block_posting_list<BlockCodec, Profile>::write(list, n, docs_begin, freqs_begin);
+        }
+
+        void add_encoded_posting_list(encoded_posting_list const& list) { add_posting_list(list); }
+
         template <typename BlockDataRange>
         void add_posting_list(uint64_t n, BlockDataRange const& blocks)
         {
@@ -63,7 +91,8 @@ class block_freq_index {
             m_endpoints.push_back(m_lists.size());
         }
 
-        void build(block_freq_index& sq)
+        /// Builds the index into `sq`, recording `encoding` in its header.
+        void build(block_freq_index& sq, std::string const& encoding = "")
         {
             sq.m_params = m_params;
             sq.m_size = m_endpoints.size() - 1;
@@ -78,6 +107,11 @@ class block_freq_index {
                 sq.m_size,
                 m_params);  // XXX
             bit_vector(&bvb).swap(sq.m_endpoints);
+
+            sq.m_header = IndexHeader(encoding, m_params, m_num_docs, sq.m_size);
+            sq.m_header.add_section(
+                "endpoints", mapper::offset_of(sq, sq.m_endpoints.data()), sq.m_endpoints.data());
+            sq.m_header.add_section("lists", mapper::offset_of(sq, sq.m_lists), sq.m_lists);
         }
 
       private:
@@ -96,6 +130,8 @@ class block_freq_index {
             m_endpoints.push_back(0);
         }
 
+        using encoded_posting_list = std::vector<uint8_t>;
+
         template <typename DocsIterator, typename FreqsIterator>
         void add_posting_list(
             uint64_t n,
@@ -108,11 +144,28 @@ class block_freq_index {
             }
             std::vector<std::uint8_t> buf;
             block_posting_list<BlockCodec, Profile>::write(buf, n, docs_begin, freqs_begin);
-            m_postings_bytes_written += buf.size();
-            m_postings_output.write(reinterpret_cast<char const*>(buf.data()), buf.size());
-            m_endpoints.push_back(m_postings_bytes_written);
+            write_postings(buf);
         }
 
+        /// Encodes a posting list into `list` without modifying the builder, so that lists can
+        /// be encoded concurrently and then added in order with `add_encoded_posting_list`.
+        template <typename DocsIterator, typename FreqsIterator>
+        void encode_posting_list(
+            encoded_posting_list& list,
+            uint64_t n,
+            DocsIterator docs_begin,
+            FreqsIterator freqs_begin,
+            uint64_t /* occurrences */) const
+        {
+            if (!n) {
+                throw std::invalid_argument("List must be nonempty");
+            }
+            list.clear();
+            block_posting_list<BlockCodec, Profile>::write(list, n, docs_begin, freqs_begin);
+        }
+
+        void add_encoded_posting_list(encoded_posting_list const& list) { write_postings(list); }
+
         template <typename BlockDataRange>
         void add_posting_list(uint64_t n, BlockDataRange const& blocks)
         {
@@ -121,33 +174,43 @@ class block_freq_index {
             }
             std::vector<std::uint8_t> buf;
             block_posting_list<BlockCodec>::write_blocks(buf, n, blocks);
-            m_postings_bytes_written += buf.size();
-            m_postings_output.write(reinterpret_cast<char const*>(buf.data()), buf.size());
-            m_endpoints.push_back(m_postings_bytes_written);
+            write_postings(buf);
         }
 
         template <typename BytesRange>
         void add_posting_list(BytesRange const& data)
         {
-            m_postings_bytes_written += data.size();
-            m_postings_output.write(reinterpret_cast<char const*>(data.data()), data.size());
-            m_endpoints.push_back(m_postings_bytes_written);
+            write_postings(data);
         }
 
-        void build(std::string const& index_path)
+        /// Writes the index to `index_path`, recording `encoding` in its header.
+        void build(std::string const& index_path, std::string const& encoding = "")
         {
             std::ofstream os(index_path.c_str());
-            mapper::detail::freeze_visitor freezer(os, 0);
-            freezer(m_params, "m_params");
             std::size_t size = m_endpoints.size() - 1;
-            freezer(size, "size");
-            freezer(m_num_docs, "m_num_docs");
+            IndexHeader header(encoding, m_params, m_num_docs, size);
+            std::size_t endpoints_offset;
+            std::size_t lists_offset;
+            {
+                // The sections are located while writing, and the header is rewritten below.
+                mapper::detail::freeze_visitor freezer(os, 0);
+                freezer(header, "m_header");
+                freezer(m_params, "m_params");
+                freezer(size, "size");
+                freezer(m_num_docs, "m_num_docs");
 
-            bit_vector_builder bvb;
-            compact_elias_fano::write(
-                bvb, m_endpoints.begin(), m_postings_bytes_written, size, m_params);
-            bit_vector endpoints(&bvb);
-            freezer(endpoints, "endpoints");
+                bit_vector_builder bvb;
+                compact_elias_fano::write(
+                    bvb, m_endpoints.begin(), m_postings_bytes_written, size, m_params);
+                bit_vector endpoints(&bvb);
+                endpoints_offset = freezer.written() + mapper::offset_of(endpoints, endpoints.data())
+                    - sizeof(uint64_t);
+                header.add_section("endpoints", endpoints_offset, endpoints.data());
+                freezer(endpoints, "endpoints");
+                lists_offset = freezer.written() + sizeof(m_postings_bytes_written);
+            }
+            header.add_section(
+                "lists", lists_offset, m_postings_bytes_written, m_postings_hash.digest());
 
             std::ifstream buf((tmp.path() / "buffer").c_str());
             m_postings_output.close();
@@ -155,6 +218,10 @@ class block_freq_index {
                 reinterpret_cast<char const*>(&m_postings_bytes_written),
                 sizeof(m_postings_bytes_written));
             os << buf.rdbuf();
+
+            os.seekp(0);
+            mapper::detail::freeze_visitor freezer(os, 0);
+            freezer(header, "m_header");
         }
 
       private:
@@ -165,13 +232,24 @@ class block_freq_index {
         Temporary_Directory tmp{};
         std::ofstream m_postings_output;
         std::size_t m_postings_bytes_written{0};
+        xxhash64 m_postings_hash{};
+
+        template <typename BytesRange>
+        void write_postings(BytesRange const& data)
+        {
+            m_postings_bytes_written += data.size();
+            m_postings_output.write(reinterpret_cast<char const*>(data.data()), data.size());
+            m_postings_hash.update(data.data(), data.size());
+            m_endpoints.push_back(m_postings_bytes_written);
+        }
     };
 
     size_t size() const { return m_size; }
 
     uint64_t num_docs() const { return m_num_docs; }
 
-    using document_enumerator = typename block_posting_list<BlockCodec, Profile>::document_enumerator;
+    using document_enumerator =
+        typename block_posting_list<BlockCodec, Profile, AbsoluteDocs>::document_enumerator;
 
     document_enumerator operator[](size_t i) const
     {
@@ -182,7 +260,9 @@ class block_freq_index {
         return document_enumerator(m_lists.data() + endpoint, num_docs(), i);
     }
 
-    void warmup(size_t i) const
+    /// Encoded posting list of term `i`, which `document_enumerator(data, num_docs(), i)`
+    /// enumerates wherever it is copied.
+    gsl::span<uint8_t const> posting_list_data(size_t i) const
     {
         assert(i < size());
         compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
@@ -192,16 +272,23 @@ class block_freq_index {
         if (i + 1 != size()) {
             end = endpoints.move(i + 1).second;
         }
+        return gsl::make_span(m_lists.data() + begin, end - begin);
+    }
 
+    void warmup(size_t i) const
+    {
         volatile uint32_t tmp;
-        for (size_t i = begin; i != end; ++i) {
-            tmp = m_lists[i];
+        for (auto byte: posting_list_data(i)) {
+            tmp = byte;
         }
         (void)tmp;
     }
 
+    IndexHeader const& header() const { return m_header; }
+
     void swap(block_freq_index& other)
     {
+        std::swap(m_header, other.m_header);
         std::swap(m_params, other.m_params);
         std::swap(m_size, other.m_size);
         m_endpoints.swap(other.m_endpoints);
@@ -211,11 +298,12 @@ class block_freq_index {
     template <typename Visitor>
     void map(Visitor& visit)
     {
-        visit(m_params, "m_params")(m_size, "m_size")(m_num_docs, "m_num_docs")(
-            m_endpoints, "m_endpoints")(m_lists, "m_lists");
+        visit(m_header, "m_header")(m_params, "m_params")(m_size, "m_size")(
+            m_num_docs, "m_num_docs")(m_endpoints, "m_endpoints")(m_lists, "m_lists");
     }
 
   private:
+    IndexHeader m_header;
     global_parameters m_params;
     size_t m_size{0};
     size_t m_num_docs{0};
@@ -1,12 +1,77 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+
+#if defined(__SSE4_1__)
+    #include <smmintrin.h>
+#endif
+
 #include "codec/block_codecs.hpp"
 #include "util/block_profiler.hpp"
 #include "util/util.hpp"
 
 namespace pisa {
 
-template <typename BlockCodec, bool Profile = false>
+namespace detail {
+
+    /// Turns the `n` d-gaps (minus one) in `docs`, whose first value is already absolute,
+    /// into absolute docids.
+    PISA_ALWAYSINLINE void prefix_sum_docs(uint32_t* docs, std::size_t n)
+    {
+        std::size_t i = 1;
+#if defined(__SSE4_1__)
+        __m128i carry = _mm_set1_epi32(docs[0]);
+        __m128i const ones = _mm_set1_epi32(1);
+        for (; i + 4 <= n; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(docs + i));
+            v = _mm_add_epi32(v, ones);
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi32(v, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(docs + i), v);
+            carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+#endif
+        for (; i < n; ++i) {
+            docs[i] += docs[i - 1] + 1;
+        }
+    }
+
+    /// Returns the first position in `[pos, n)` of the sorted `values` with a value of at least
+    /// `lower_bound`, which must exist.
+    PISA_ALWAYSINLINE auto
+    find_geq(uint32_t const* values, std::size_t pos, std::size_t n, uint32_t lower_bound)
+        -> std::size_t
+    {
+#if defined(__SSE4_1__)
+        __m128i const bound = _mm_set1_epi32(lower_bound);
+        for (; pos + 4 <= n; pos += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(values + pos));
+            // Unsigned v >= bound iff max(v, bound) == v.
+            __m128i geq = _mm_cmpeq_epi32(_mm_max_epu32(v, bound), v);
+            auto mask = _mm_movemask_ps(_mm_castsi128_ps(geq));
+            if (mask != 0) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+#endif
+        while (values[pos] < lower_bound) {
+            ++pos;
+        }
+        assert(pos < n);
+        return pos;
+    }
+
+}  // namespace detail
+
+/// Posting lists of docids and frequencies compressed in blocks with `BlockCodec`.
+///
+/// With `AbsoluteDocs`, the enumerator turns the d-gaps of each decoded block into absolute
+/// docids at once with a vectorized prefix sum, so that `next()` and `move()` read them directly
+/// and `next_geq()` finds its target in the block with vectorized comparisons, instead of adding
+/// up the gaps one at a time. The encoding is the same either way.
+template <typename BlockCodec, bool Profile = false, bool AbsoluteDocs = false>
 struct block_posting_list {
     template <typename DocsIterator, typename FreqsIterator>
     static void
@@ -91,8 +156,6 @@ struct block_posting_list {
                 // std::cout << "OPEN\t" << m_term_id << "\t" << m_blocks << "\n";
                 m_block_profile = block_profiler::open_list(term_id, m_blocks);
             }
-            m_docs_buf.resize(BlockCodec::block_size);
-            m_freqs_buf.resize(BlockCodec::block_size);
             reset();
         }
 
@@ -107,6 +170,8 @@ struct block_posting_list {
                     return;
                 }
                 decode_docs_block(m_cur_block + 1);
+            } else if constexpr (AbsoluteDocs) {
+                m_cur_docid = m_docs_buf[m_pos_in_block];
             } else {
                 m_cur_docid += m_docs_buf[m_pos_in_block] + 1;
             }
@@ -116,23 +181,24 @@ struct block_posting_list {
         {
             assert(lower_bound >= m_cur_docid || position() == 0);
             if (PISA_UNLIKELY(lower_bound > m_cur_block_max)) {
-                // binary search seems to perform worse here
                 if (lower_bound > block_max(m_blocks - 1)) {
                     m_cur_docid = m_universe;
                     return;
                 }
-
-                uint64_t block = m_cur_block + 1;
-                while (block_max(block) < lower_bound) {
-                    ++block;
-                }
-
-                decode_docs_block(block);
+                decode_docs_block(find_block(lower_bound));
             }
 
-            while (docid() < lower_bound) {
-                m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
-                assert(m_pos_in_block < m_cur_block_size);
+            if constexpr (AbsoluteDocs) {
+                if (docid() < lower_bound) {
+                    m_pos_in_block = detail::find_geq(
+                        m_docs_buf.data(), m_pos_in_block + 1, m_cur_block_size, lower_bound);
+                    m_cur_docid = m_docs_buf[m_pos_in_block];
+                }
+            } else {
+                while (docid() < lower_bound) {
+                    m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+                    assert(m_pos_in_block < m_cur_block_size);
+                }
             }
         }
 
@@ -143,8 +209,13 @@ struct block_posting_list {
             if (PISA_UNLIKELY(block != m_cur_block)) {
                 decode_docs_block(block);
             }
-            while (position() < pos) {
-                m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+            if constexpr (AbsoluteDocs) {
+                m_pos_in_block = pos % BlockCodec::block_size;
+                m_cur_docid = m_docs_buf[m_pos_in_block];
+            } else {
+                while (position() < pos) {
+                    m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+                }
             }
         }
 
@@ -256,6 +327,34 @@ struct block_posting_list {
       private:
         uint32_t block_max(uint32_t block) const { return ((uint32_t const*)m_block_maxs)[block]; }
 
+        /// Returns the first block after the current one with max at least `lower_bound`,
+        /// which must exist.
+        ///
+        /// Most jumps land in one of the next few blocks, which a plain binary search would
+        /// make slower, so the distance is found by galloping from the current block, narrowed
+        /// down with a binary search, and the last few blocks are scanned linearly.
+        uint64_t PISA_NOINLINE find_block(uint64_t lower_bound) const
+        {
+            constexpr uint64_t linear_scan_threshold = 16;
+            auto const* maxs = reinterpret_cast<uint32_t const*>(m_block_maxs);
+            auto bound = static_cast<uint32_t>(lower_bound);
+            uint64_t first = m_cur_block + 1;
+            uint64_t last = first;
+            for (uint64_t step = 1; maxs[last] < bound; step *= 2) {
+                first = last + 1;
+                last = std::min<uint64_t>(last + step, m_blocks - 1);
+            }
+            while (last - first > linear_scan_threshold) {
+                auto mid = first + (last - first) / 2;
+                if (maxs[mid] < bound) {
+                    first = mid + 1;
+                } else {
+                    last = mid;
+                }
+            }
+            return detail::find_geq(maxs, first, last + 1, bound);
+        }
+
         void PISA_NOINLINE decode_docs_block(uint64_t block)
         {
             static const uint64_t block_size = BlockCodec::block_size;
@@ -273,6 +372,9 @@ struct block_posting_list {
             intrinsics::prefetch(m_freqs_block_data);
 
             m_docs_buf[0] += cur_base;
+            if constexpr (AbsoluteDocs) {
+                detail::prefix_sum_docs(m_docs_buf.data(), m_cur_block_size);
+            }
 
             m_cur_block = block;
             m_pos_in_block = 0;
@@ -312,8 +414,10 @@ struct block_posting_list {
         uint8_t const* m_freqs_block_data{nullptr};
         bool m_freqs_decoded{false};
 
-        std::vector<uint32_t> m_docs_buf;
-        std::vector<uint32_t> m_freqs_buf;
+        // Decode buffers are stored inline, so that opening a cursor does not allocate,
+        // and cache-line aligned for the SIMD codecs writing to them.
+        alignas(64) std::array<uint32_t, BlockCodec::block_size> m_docs_buf;
+        alignas(64) std::array<uint32_t, BlockCodec::block_size> m_freqs_buf;
 
         block_profiler::counter_type* m_block_profile;
     };
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_group.h>
+
+#include "compress.hpp"
+#include "global_parameters.hpp"
+#include "invert.hpp"
+#include "mappable/mapper.hpp"
+#include "scorer/scorer.hpp"
+#include "util/util.hpp"
+#include "wand_utils.hpp"
+
+namespace pisa {
+
+/// Builds the compressed block index `output_filename` and the WAND data `wand_data_filename`
+/// of the forward index `input_basename` in one pass, without writing the inverted index.
+///
+/// The forward index is inverted in batches written to disk as by `invert`. While the posting
+/// lists of the batches are merged by ranges of terms, each range is passed to the WAND data
+/// builder and, at the same time, its lists are encoded concurrently and then added to the
+/// index in term order. The WAND data and the index are the same as those built from the
+/// inverted index by `create_wand_data` and `compress`, without quantized scores or dropped
+/// terms. Memory is bounded by `memory_budget` bytes as in `invert::invert_forward_index`,
+/// besides the document lengths, the WAND data, and the encoded lists of the range being added.
+///
+/// \throws std::invalid_argument  if `memory_budget` cannot hold the counts of a batch
+template <typename Index, typename Wand>
+void build_index(
+    std::string const& input_basename,
+    std::string const& output_filename,
+    std::string const& wand_data_filename,
+    std::string const& encoding,
+    ScorerParams const& scorer_params,
+    BlockSize const& block_size,
+    bool quantize,
+    std::size_t batch_size,
+    std::size_t threads,
+    std::optional<std::uint32_t> term_count = std::nullopt,
+    std::optional<std::size_t> memory_budget = std::nullopt)
+{
+    double tick = get_time_usecs();
+    term_count = invert::forward_index_term_count(input_basename, term_count);
+    auto limits = invert::memory_limits(*term_count, threads, memory_budget);
+    auto batches = invert::build_batches(
+        input_basename,
+        output_filename,
+        *term_count,
+        batch_size,
+        threads,
+        limits.batch_occurrences);
+
+    auto document_sizes = invert::read_document_sizes(batches);
+    auto num_docs = document_sizes.size();
+    spdlog::info("Building index and WAND data of {} documents", num_docs);
+    global_parameters params;
+    typename Index::stream_builder builder(num_docs, params);
+    typename Wand::builder wand_builder(
+        std::move(document_sizes), scorer_params, block_size, quantize);
+    auto encode = posting_list_encoder<typename Index::stream_builder, Wand>(builder, nullptr);
+
+    std::size_t term_id = 0;
+    std::size_t postings = 0;
+    invert::merge_posting_lists(
+        batches,
+        *term_count,
+        limits.range_postings,
+        threads,
+        [&](invert::Merged_Range const& merged) {
+            auto sequences = merged.sequences();
+            std::vector<typename Index::stream_builder::encoded_posting_list> lists(
+                sequences.size());
+            tbb::task_group group;
+            group.run([&] {
+                for (auto const& sequence: sequences) {
+                    wand_builder.add_posting_list(sequence);
+                }
+            });
+            tbb::parallel_for(std::size_t(0), sequences.size(), [&](std::size_t idx) {
+                encode(lists[idx], term_id + idx, sequences[idx]);
+            });
+            group.wait();
+            for (auto const& list: lists) {
+                builder.add_encoded_posting_list(list);
+            }
+            term_id += sequences.size();
+            postings += merged.postings;
+        });
+    invert::remove_batches(batches);
+
+    builder.build(output_filename, encoding);
+    Wand wdata;
+    wand_builder.build(wdata);
+    mapper::freeze(wdata, wand_data_filename.c_str());
+
+    double elapsed_secs = (get_time_usecs() - tick) / 1000000;
+    spdlog::info("{} terms and {} postings indexed in {} seconds", term_id, postings, elapsed_secs);
+    stats_line()("type", encoding)("worker_threads", threads)("construction_time", elapsed_secs);
+}
+
+}  // namespace pisa
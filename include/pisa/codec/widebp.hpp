@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "codec/block_codecs.hpp"
+#include "util/broadword.hpp"
+#include "util/likely.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+namespace detail::widebp {
+
+    /// Instruction sets of the unpacking kernels, in increasing order of width.
+    enum class isa { scalar, avx2, avx512 };
+
+    /// The widest instruction set supported by the CPU the program runs on.
+    inline auto supported_isa() -> isa
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return isa::avx512;
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return isa::avx2;
+        }
+        return isa::scalar;
+    }
+
+    constexpr auto mask(uint32_t b) -> uint32_t { return b == 32 ? uint32_t(-1) : (1U << b) - 1; }
+
+    /// Packs the `32 * Lanes` values of `in` with `b` bits each into `b * Lanes` words of `out`.
+    ///
+    /// Value `i` belongs to lane `i % Lanes`, and the values of each lane are packed into their
+    /// own stream of `b` words; word `w` of lane `l` is stored at `out[w * Lanes + l]`, so that
+    /// a whole row of values can be unpacked from consecutive words with SIMD shifts and masks.
+    template <std::size_t Lanes>
+    void pack(uint32_t const* in, uint32_t* out, uint32_t b)
+    {
+        if (b == 0) {
+            return;
+        }
+        std::fill(out, out + b * Lanes, 0U);
+        for (uint32_t row = 0; row < 32; ++row) {
+            uint32_t bit = row * b;
+            uint32_t word = bit / 32;
+            uint32_t shift = bit % 32;
+            for (std::size_t lane = 0; lane < Lanes; ++lane) {
+                uint32_t value = in[row * Lanes + lane];
+                out[word * Lanes + lane] |= value << shift;
+                if (shift + b > 32) {
+                    out[(word + 1) * Lanes + lane] |= value >> (32 - shift);
+                }
+            }
+        }
+    }
+
+    template <std::size_t Lanes, uint32_t B>
+    void unpack_scalar(uint32_t const* in, uint32_t* out)
+    {
+        for (uint32_t row = 0; row < 32; ++row) {
+            uint32_t bit = row * B;
+            uint32_t word = bit / 32;
+            uint32_t shift = bit % 32;
+            for (std::size_t lane = 0; lane < Lanes; ++lane) {
+                uint32_t value = 0;
+                if constexpr (B > 0) {
+                    value = in[word * Lanes + lane] >> shift;
+                    if (shift + B > 32) {
+                        value |= in[(word + 1) * Lanes + lane] << (32 - shift);
+                    }
+                }
+                out[row * Lanes + lane] = value & mask(B);
+            }
+        }
+    }
+
+    template <std::size_t Lanes, uint32_t B, std::size_t Row>
+    __attribute__((target("avx2"), always_inline)) inline void
+    unpack_row_avx2(uint32_t const* in, uint32_t* out)
+    {
+        constexpr uint32_t word = Row * B / 32;
+        constexpr uint32_t shift = Row * B % 32;
+        for (std::size_t lane = 0; lane < Lanes; lane += 8) {
+            __m256i value = _mm256_setzero_si256();
+            if constexpr (B > 0) {
+                value = _mm256_srli_epi32(
+                    _mm256_loadu_si256(reinterpret_cast<__m256i const*>(in + word * Lanes + lane)),
+                    shift);
+                if constexpr (shift + B > 32) {
+                    auto next = _mm256_loadu_si256(
+                        reinterpret_cast<__m256i const*>(in + (word + 1) * Lanes + lane));
+                    value = _mm256_or_si256(value, _mm256_slli_epi32(next, 32 - shift));
+                }
+                if constexpr (B < 32) {
+                    value = _mm256_and_si256(value, _mm256_set1_epi32(mask(B)));
+                }
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + Row * Lanes + lane), value);
+        }
+    }
+
+    template <std::size_t Lanes, uint32_t B, std::size_t... Rows>
+    __attribute__((target("avx2"))) void
+    unpack_avx2(uint32_t const* in, uint32_t* out, std::index_sequence<Rows...>)
+    {
+        (unpack_row_avx2<Lanes, B, Rows>(in, out), ...);
+    }
+
+    template <std::size_t Lanes, uint32_t B, std::size_t Row>
+    __attribute__((target("avx512f"), always_inline)) inline void
+    unpack_row_avx512(uint32_t const* in, uint32_t* out)
+    {
+        constexpr uint32_t word = Row * B / 32;
+        constexpr uint32_t shift = Row * B % 32;
+        for (std::size_t lane = 0; lane < Lanes; lane += 16) {
+            __m512i value = _mm512_setzero_si512();
+            if constexpr (B > 0) {
+                value = _mm512_srli_epi32(_mm512_loadu_si512(in + word * Lanes + lane), shift);
+                if constexpr (shift + B > 32) {
+                    auto next = _mm512_loadu_si512(in + (word + 1) * Lanes + lane);
+                    value = _mm512_or_si512(value, _mm512_slli_epi32(next, 32 - shift));
+                }
+                if constexpr (B < 32) {
+                    value = _mm512_and_si512(value, _mm512_set1_epi32(mask(B)));
+                }
+            }
+            _mm512_storeu_si512(out + Row * Lanes + lane, value);
+        }
+    }
+
+    template <std::size_t Lanes, uint32_t B, std::size_t... Rows>
+    __attribute__((target("avx512f"))) void
+    unpack_avx512(uint32_t const* in, uint32_t* out, std::index_sequence<Rows...>)
+    {
+        (unpack_row_avx512<Lanes, B, Rows>(in, out), ...);
+    }
+
+    using unpack_fn = void (*)(uint32_t const*, uint32_t*);
+    using unpack_table = std::array<unpack_fn, 33>;
+
+    template <std::size_t Lanes, isa Isa, uint32_t B>
+    void unpack(uint32_t const* in, uint32_t* out)
+    {
+        if constexpr (Isa == isa::avx512) {
+            unpack_avx512<Lanes, B>(in, out, std::make_index_sequence<32>{});
+        } else if constexpr (Isa == isa::avx2) {
+            unpack_avx2<Lanes, B>(in, out, std::make_index_sequence<32>{});
+        } else {
+            unpack_scalar<Lanes, B>(in, out);
+        }
+    }
+
+    template <std::size_t Lanes, isa Isa, std::size_t... Bs>
+    constexpr auto make_unpack_table(std::index_sequence<Bs...>) -> unpack_table
+    {
+        return {&unpack<Lanes, Isa, Bs>...};
+    }
+
+    /// Unpacking kernels of every bit width for the given instruction set, falling back to
+    /// narrower ones when the lanes do not fill a whole register.
+    template <std::size_t Lanes>
+    auto unpackers(isa target) -> unpack_table
+    {
+        auto bit_widths = std::make_index_sequence<33>{};
+        if (target == isa::avx512 && Lanes % 16 == 0) {
+            return make_unpack_table<Lanes, isa::avx512>(bit_widths);
+        }
+        if (target >= isa::avx2 && Lanes % 8 == 0) {
+            return make_unpack_table<Lanes, isa::avx2>(bit_widths);
+        }
+        return make_unpack_table<Lanes, isa::scalar>(bit_widths);
+    }
+
+    /// Kernels selected once for the CPU the program runs on.
+    template <std::size_t Lanes>
+    auto unpackers() -> unpack_table const&
+    {
+        static unpack_table const table = unpackers<Lanes>(supported_isa());
+        return table;
+    }
+
+}  // namespace detail::widebp
+
+/// Bit-packing of blocks of `BlockSize` values in `BlockSize / 32` interleaved lanes, i.e.,
+/// a register of 8 lanes for blocks of 256 and 16 lanes for blocks of 512.
+///
+/// All values of a block are packed with the bit width of the largest one, stored in the first
+/// byte. The layout does not depend on the instruction set, and decoding uses AVX-512 or AVX2
+/// kernels unrolled for each bit width, selected at runtime for the CPU. Partial blocks are
+/// encoded with interpolative coding.
+template <std::size_t BlockSize>
+struct widebp_block {
+    static_assert(BlockSize % 256 == 0, "Blocks must fill whole AVX2 registers");
+    static const uint64_t block_size = BlockSize;
+    static constexpr std::size_t lanes = BlockSize / 32;
+
+    static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out)
+    {
+        assert(n <= block_size);
+        if (n < block_size) {
+            encode_partial(in, sum_of_values, n, out);
+            return;
+        }
+        uint32_t bits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            bits |= in[i];
+        }
+        uint32_t b = bits == 0 ? 0 : broadword::msb(bits) + 1;
+        thread_local std::array<uint32_t, BlockSize> buf;
+        detail::widebp::pack<lanes>(in, buf.data(), b);
+        out.push_back(b);
+        auto const* bufptr = reinterpret_cast<uint8_t const*>(buf.data());
+        out.insert(out.end(), bufptr, bufptr + b * lanes * sizeof(uint32_t));
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n)
+    {
+        assert(n <= block_size);
+        if (PISA_UNLIKELY(n < block_size)) {
+            return decode_partial(in, out, sum_of_values, n);
+        }
+        uint32_t b = *in++;
+        detail::widebp::unpackers<lanes>()[b](reinterpret_cast<uint32_t const*>(in), out);
+        return in + b * lanes * sizeof(uint32_t);
+    }
+
+  private:
+    static constexpr size_t chunk_size = interpolative_block::block_size;
+
+    // Partial blocks may be longer than interpolative blocks, in which case they are split in
+    // chunks storing their own sums.
+    static void
+    encode_partial(uint32_t const* in, uint32_t sum_of_values, size_t n, std::vector<uint8_t>& out)
+    {
+        if (n <= chunk_size) {
+            interpolative_block::encode(in, sum_of_values, n, out);
+            return;
+        }
+        for (size_t pos = 0; pos < n; pos += chunk_size) {
+            auto chunk = std::min(chunk_size, n - pos);
+            interpolative_block::encode(in + pos, uint32_t(-1), chunk, out);
+        }
+    }
+
+    static uint8_t const*
+    decode_partial(uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n)
+    {
+        if (n <= chunk_size) {
+            return interpolative_block::decode(in, out, sum_of_values, n);
+        }
+        for (size_t pos = 0; pos < n; pos += chunk_size) {
+            auto chunk = std::min(chunk_size, n - pos);
+            in = interpolative_block::decode(in, out + pos, uint32_t(-1), chunk);
+        }
+        return in;
+    }
+};
+
+using widebp256_block = widebp_block<256>;
+using widebp512_block = widebp_block<512>;
+
+}  // namespace pisa
@@ -1,15 +1,20 @@
 #pragma once
 
 #include <algorithm>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <numeric>
+#include <memory>
 #include <optional>
 #include <thread>
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
 
 #include "configuration.hpp"
 #include "ensure.hpp"
@@ -65,56 +70,116 @@ struct QuantizedScorer {
     LinearQuantizer quantizer;
 };
 
+/// Number of postings of the posting lists encoded concurrently by `add_posting_lists`.
+constexpr std::size_t compress_batch_postings = std::size_t(1) << 22U;
+
+/// Adds the posting lists of `input` to `builder` in term order, encoding each with
+/// `encode(list, term_id, sequence)` into a `Builder::encoded_posting_list`.
+///
+/// The lists are taken in batches of about `batch_postings` postings. The lists of a batch are
+/// encoded concurrently, each into its own buffer, while those of the previous batch are added
+/// to the builder, so the index is the same as if the lists were added one at a time.
+///
+/// \returns the number of postings
+template <typename Builder, typename Encode>
+auto add_posting_lists(
+    Builder& builder,
+    binary_freq_collection const& input,
+    Encode encode,
+    std::size_t batch_postings = compress_batch_postings) -> std::size_t
+{
+    struct Batch {
+        std::size_t first_term_id = 0;
+        std::vector<binary_freq_collection::sequence> sequences;
+        std::deque<typename Builder::encoded_posting_list> lists;
+    };
+
+    pisa::progress progress("Create index", input.size());
+    std::size_t postings = 0;
+    std::size_t term_id = 0;
+    auto it = input.begin();
+    auto read_batch = [&] {
+        auto batch = std::make_unique<Batch>();
+        batch->first_term_id = term_id;
+        for (std::size_t batch_size = 0; it != input.end() && batch_size < batch_postings;
+             ++it, ++term_id) {
+            batch->sequences.push_back(*it);
+            batch->lists.emplace_back();
+            batch_size += it->docs.size();
+            postings += it->docs.size();
+        }
+        return batch;
+    };
+    auto encode_batch = [&](Batch& batch) {
+        tbb::parallel_for(std::size_t(0), batch.sequences.size(), [&](std::size_t idx) {
+            encode(batch.lists[idx], batch.first_term_id + idx, batch.sequences[idx]);
+        });
+    };
+
+    auto batch = read_batch();
+    encode_batch(*batch);
+    while (not batch->sequences.empty()) {
+        auto next_batch = read_batch();
+        tbb::task_group group;
+        group.run([&] { encode_batch(*next_batch); });
+        for (auto const& list: batch->lists) {
+            builder.add_encoded_posting_list(list);
+        }
+        progress.update(batch->sequences.size());
+        group.wait();
+        batch = std::move(next_batch);
+    }
+    return postings;
+}
+
+/// Returns a function encoding posting lists for `builder`, as `add_posting_lists` expects, with
+/// their frequencies or, if `quantized_scorer` is not null, their quantized scores.
+template <typename Builder, typename Wand>
+auto posting_list_encoder(Builder const& builder, QuantizedScorer<Wand> const* quantized_scorer)
+{
+    return [&builder, quantized_scorer](
+               auto& list, std::size_t term_id, binary_freq_collection::sequence const& plist) {
+        std::size_t size = plist.docs.size();
+        if (quantized_scorer != nullptr) {
+            auto term_scorer = quantized_scorer->scorer->term_scorer(term_id);
+            std::vector<std::uint64_t> quantized_scores(size);
+            for (size_t pos = 0; pos < size; ++pos) {
+                auto doc = *(plist.docs.begin() + pos);
+                auto freq = *(plist.freqs.begin() + pos);
+                quantized_scores[pos] = quantized_scorer->quantizer(term_scorer(doc, freq));
+            }
+            auto sum = std::accumulate(
+                quantized_scores.begin(), quantized_scores.end(), std::uint64_t(0));
+            builder.encode_posting_list(
+                list, size, plist.docs.begin(), quantized_scores.begin(), sum);
+        } else {
+            uint64_t freqs_sum =
+                std::accumulate(plist.freqs.begin(), plist.freqs.begin() + size, uint64_t(0));
+            builder.encode_posting_list(
+                list, size, plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+        }
+    };
+}
+
 template <typename CollectionType, typename Wand>
 void compress_index_streaming(
     binary_freq_collection const& input,
     pisa::global_parameters const& params,
     std::string const& output_filename,
     std::optional<QuantizedScorer<Wand>> quantized_scorer,
-    bool check)
+    bool check,
+    std::string const& seq_type)
 {
     spdlog::info("Processing {} documents (streaming)", input.num_docs());
     double tick = get_time_usecs();
 
     typename CollectionType::stream_builder builder(input.num_docs(), params);
-    size_t postings = 0;
-    {
-        pisa::progress progress("Create index", input.size());
-
-        size_t term_id = 0;
-        if (quantized_scorer) {
-            auto&& [scorer, quantizer] = *quantized_scorer;
-            std::vector<std::uint64_t> quantized_scores;
-            for (auto const& plist: input) {
-                auto term_scorer = scorer->term_scorer(term_id);
-                std::size_t size = plist.docs.size();
-                for (size_t pos = 0; pos < size; ++pos) {
-                    auto doc = *(plist.docs.begin() + pos);
-                    auto freq = *(plist.freqs.begin() + pos);
-                    auto score = term_scorer(doc, freq);
-                    quantized_scores.push_back(quantizer(score));
-                }
-                auto sum = std::accumulate(
-                    quantized_scores.begin(), quantized_scores.end(), std::uint64_t(0));
-                builder.add_posting_list(size, plist.docs.begin(), quantized_scores.begin(), sum);
-                term_id += 1;
-                quantized_scores.clear();
-                progress.update(1);
-            }
-        } else {
-            for (auto const& plist: input) {
-                size_t size = plist.docs.size();
-                uint64_t freqs_sum =
-                    std::accumulate(plist.freqs.begin(), plist.freqs.begin() + size, uint64_t(0));
-                builder.add_posting_list(size, plist.docs.begin(), plist.freqs.begin(), freqs_sum);
-                progress.update(1);
-                postings += size;
-                term_id += 1;
-            }
-        }
-    }
+    add_posting_lists(
+        builder,
+        input,
+        posting_list_encoder(builder, quantized_scorer ? &*quantized_scorer : nullptr));
 
-    builder.build(output_filename);
+    builder.build(output_filename, seq_type);
     double elapsed_secs = (get_time_usecs() - tick) / 1000000;
     spdlog::info("Index compressed in {} seconds", elapsed_secs);
 
@@ -134,7 +199,8 @@ void compress_index(
     std::string const& seq_type,
     std::optional<std::string> const& wand_data_filename,
     ScorerParams const& scorer_params,
-    bool quantized)
+    bool quantized,
+    double density_threshold)
 {
     if constexpr (std::is_same_v<typename CollectionType::index_layout_tag, BlockIndexTag>) {
         std::optional<QuantizedScorer<WandType>> quantized_scorer{};
@@ -156,67 +222,43 @@ void compress_index(
             quantized_scorer = QuantizedScorer(std::move(scorer), quantizer);
         }
         compress_index_streaming<CollectionType, WandType>(
-            input, params, *output_filename, std::move(quantized_scorer), check);
+            input, params, *output_filename, std::move(quantized_scorer), check, seq_type);
         return;
     }
 
     spdlog::info("Processing {} documents", input.num_docs());
     double tick = get_time_usecs();
 
-    typename CollectionType::builder builder(input.num_docs(), params);
-    size_t postings = 0;
-    {
-        pisa::progress progress("Create index", input.size());
-        WandType const wdata = [&] {
-            if (wand_data_filename) {
-                return WandType(MemorySource::mapped_file(*wand_data_filename));
-            }
-            return WandType{};
-        }();
-
-        std::unique_ptr<index_scorer<WandType>> scorer;
-
-        if (quantized) {
-            scorer = scorer::from_params(scorer_params, wdata);
+    auto builder = [&] {
+        if constexpr (std::is_same_v<typename CollectionType::index_layout_tag, HybridIndexTag>) {
+            return typename CollectionType::builder(input.num_docs(), params, density_threshold);
+        } else {
+            return typename CollectionType::builder(input.num_docs(), params);
         }
-
-        size_t term_id = 0;
-        for (auto const& plist: input) {
-            size_t size = plist.docs.size();
-            if (quantized) {
-                LinearQuantizer quantizer(
-                    wdata.index_max_term_weight(), configuration::get().quantization_bits);
-                auto term_scorer = scorer->term_scorer(term_id);
-                std::vector<uint64_t> quants;
-                for (size_t pos = 0; pos < size; ++pos) {
-                    uint64_t doc = *(plist.docs.begin() + pos);
-                    uint64_t freq = *(plist.freqs.begin() + pos);
-                    float score = term_scorer(doc, freq);
-                    uint64_t quant_score = quantizer(score);
-                    quants.push_back(quant_score);
-                }
-                assert(quants.size() == size);
-                uint64_t quants_sum =
-                    std::accumulate(quants.begin(), quants.begin() + quants.size(), uint64_t(0));
-                builder.add_posting_list(size, plist.docs.begin(), quants.begin(), quants_sum);
-            } else {
-                uint64_t freqs_sum =
-                    std::accumulate(plist.freqs.begin(), plist.freqs.begin() + size, uint64_t(0));
-                builder.add_posting_list(size, plist.docs.begin(), plist.freqs.begin(), freqs_sum);
-            }
-
-            progress.update(1);
-            postings += size;
-            term_id += 1;
+    }();
+    WandType const wdata = [&] {
+        if (wand_data_filename) {
+            return WandType(MemorySource::mapped_file(*wand_data_filename));
         }
+        return WandType{};
+    }();
+    std::optional<QuantizedScorer<WandType>> quantized_scorer{};
+    if (quantized) {
+        LinearQuantizer quantizer(
+            wdata.index_max_term_weight(), configuration::get().quantization_bits);
+        quantized_scorer = QuantizedScorer(scorer::from_params(scorer_params, wdata), quantizer);
     }
+    size_t postings = add_posting_lists(
+        builder,
+        input,
+        posting_list_encoder(builder, quantized_scorer ? &*quantized_scorer : nullptr));
 
     CollectionType coll;
-    builder.build(coll);
+    builder.build(coll, seq_type);
     double elapsed_secs = (get_time_usecs() - tick) / 1000000;
     spdlog::info("{} collection built in {} seconds", seq_type, elapsed_secs);
 
-    stats_line()("type", seq_type)("worker_threads", std::thread::hardware_concurrency())(
+    stats_line()("type", seq_type)("worker_threads", tbb::this_task_arena::max_concurrency())(
         "construction_time", elapsed_secs);
 
     dump_stats(coll, seq_type, postings);
@@ -241,7 +283,8 @@ void compress(
     std::string const& output_filename,
     ScorerParams const& scorer_params,
     bool quantize,
-    bool check)
+    bool check,
+    double density_threshold)
 {
     binary_freq_collection input(input_basename.c_str());
     global_parameters params;
@@ -259,7 +302,8 @@ void compress(
             index_encoding,                                                      \
             wand_data_filename,                                                  \
             scorer_params,                                                       \
-            quantize);                                                           \
+            quantize,                                                            \
+            density_threshold);                                                  \
         /**/
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
 #undef LOOP_BODY
@@ -40,14 +40,18 @@ class BlockMaxScoredCursor: public MaxScoredCursor<Cursor> {
     typename Wand::wand_data_enumerator m_wdata;
 };
 
+/// Replaces `cursors` with the block-max-scored cursors of `query`, reusing their storage.
 template <typename Index, typename WandType, typename Scorer>
-[[nodiscard]] auto make_block_max_scored_cursors(
-    Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
+void make_block_max_scored_cursors(
+    Index const& index,
+    WandType const& wdata,
+    Scorer const& scorer,
+    Query const& query,
+    std::vector<BlockMaxScoredCursor<typename Index::document_enumerator, WandType>>& cursors)
 {
-    auto terms = query.terms;
-    auto query_term_freqs = query_freqs(terms);
+    auto query_term_freqs = query_freqs(query.terms);
 
-    std::vector<BlockMaxScoredCursor<typename Index::document_enumerator, WandType>> cursors;
+    cursors.clear();
     cursors.reserve(query_term_freqs.size());
     std::transform(
         query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
@@ -60,6 +64,14 @@ template <typename Index, typename WandType, typename Scorer>
                 max_weight,
                 wdata.getenum(term.first));
         });
+}
+
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto make_block_max_scored_cursors(
+    Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
+{
+    std::vector<BlockMaxScoredCursor<typename Index::document_enumerator, WandType>> cursors;
+    make_block_max_scored_cursors(index, wdata, scorer, query, cursors);
     return cursors;
 }
 
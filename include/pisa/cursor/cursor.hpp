@@ -5,19 +5,26 @@
 
 namespace pisa {
 
+/// Replaces `cursors` with the cursors of `query`, reusing their storage.
 template <typename Index>
-[[nodiscard]] auto make_cursors(Index const& index, Query query)
+void make_cursors(
+    Index const& index, Query const& query, std::vector<typename Index::document_enumerator>& cursors)
 {
     auto terms = query.terms;
     remove_duplicate_terms(terms);
-    using cursor = typename Index::document_enumerator;
 
-    std::vector<cursor> cursors;
+    cursors.clear();
     cursors.reserve(terms.size());
     std::transform(terms.begin(), terms.end(), std::back_inserter(cursors), [&](auto&& term) {
         return index[term];
     });
+}
 
+template <typename Index>
+[[nodiscard]] auto make_cursors(Index const& index, Query query)
+{
+    std::vector<typename Index::document_enumerator> cursors;
+    make_cursors(index, query, cursors);
     return cursors;
 }
 
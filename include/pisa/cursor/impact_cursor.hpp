@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// Cursor over the impact-ordered segments of a term, scaled by the term's query weight.
+template <typename Enumerator>
+class ImpactCursor {
+  public:
+    ImpactCursor(Enumerator enumerator, float query_weight)
+        : m_enumerator(std::move(enumerator)), m_query_weight(query_weight)
+    {}
+    ImpactCursor(ImpactCursor const&) = delete;
+    ImpactCursor(ImpactCursor&&) = default;
+    ImpactCursor& operator=(ImpactCursor const&) = delete;
+    ImpactCursor& operator=(ImpactCursor&&) = default;
+    ~ImpactCursor() = default;
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto query_weight() const noexcept -> float
+    {
+        return m_query_weight;
+    }
+    [[nodiscard]] PISA_ALWAYSINLINE auto empty() const -> bool { return m_enumerator.empty(); }
+
+    /// Score contributed by each document of the current segment.
+    [[nodiscard]] PISA_ALWAYSINLINE auto score() const -> float
+    {
+        return m_enumerator.impact() * m_query_weight;
+    }
+    [[nodiscard]] PISA_ALWAYSINLINE auto segment_size() const -> std::uint32_t
+    {
+        return m_enumerator.segment_size();
+    }
+    template <typename Fn>
+    void PISA_ALWAYSINLINE consume_segment(Fn&& fn)
+    {
+        m_enumerator.consume_segment(std::forward<Fn>(fn));
+    }
+    [[nodiscard]] PISA_ALWAYSINLINE auto size() const -> std::size_t { return m_enumerator.size(); }
+
+  private:
+    Enumerator m_enumerator;
+    float m_query_weight = 1.0;
+};
+
+/// Replaces `cursors` with the impact cursors of `query`, reusing their storage.
+template <typename Index>
+void make_impact_cursors(
+    Index const& index,
+    Query const& query,
+    std::vector<ImpactCursor<typename Index::segment_enumerator>>& cursors)
+{
+    auto terms = query.terms;
+    auto query_term_freqs = query_freqs(terms);
+
+    cursors.clear();
+    cursors.reserve(query_term_freqs.size());
+    std::transform(
+        query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
+            return ImpactCursor<typename Index::segment_enumerator>(index[term.first], term.second);
+        });
+}
+
+template <typename Index>
+[[nodiscard]] auto make_impact_cursors(Index const& index, Query query)
+{
+    std::vector<ImpactCursor<typename Index::segment_enumerator>> cursors;
+    make_impact_cursors(index, query, cursors);
+    return cursors;
+}
+
+}  // namespace pisa
@@ -30,14 +30,18 @@ class MaxScoredCursor: public ScoredCursor<Cursor> {
     float m_query_weight = 1.0;
 };
 
+/// Replaces `cursors` with the max-scored cursors of `query`, reusing their storage.
 template <typename Index, typename WandType, typename Scorer>
-[[nodiscard]] auto
-make_max_scored_cursors(Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
+void make_max_scored_cursors(
+    Index const& index,
+    WandType const& wdata,
+    Scorer const& scorer,
+    Query const& query,
+    std::vector<MaxScoredCursor<typename Index::document_enumerator>>& cursors)
 {
-    auto terms = query.terms;
-    auto query_term_freqs = query_freqs(terms);
+    auto query_term_freqs = query_freqs(query.terms);
 
-    std::vector<MaxScoredCursor<typename Index::document_enumerator>> cursors;
+    cursors.clear();
     cursors.reserve(query_term_freqs.size());
     std::transform(
         query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
@@ -46,6 +50,14 @@ make_max_scored_cursors(Index const& index, WandType const& wdata, Scorer const&
             return MaxScoredCursor<typename Index::document_enumerator>(
                 index[term.first], scorer.term_scorer(term.first), query_weight, max_weight);
         });
+}
+
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto
+make_max_scored_cursors(Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
+{
+    std::vector<MaxScoredCursor<typename Index::document_enumerator>> cursors;
+    make_max_scored_cursors(index, wdata, scorer, query, cursors);
     return cursors;
 }
 
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "cursor/max_scored_cursor.hpp"
+#include "query/queries.hpp"
+#include "scorer/index_scorer.hpp"
+#include "wand_data.hpp"
+
+namespace pisa {
+
+/// Max-scored cursor that also provides score upper bounds for fixed-length docid ranges,
+/// as stored in `wand_data_range`.
+///
+/// Lists too short to have their range scores stored in the wand data are scanned once
+/// when the cursor is created, and only the ranges containing postings are kept.
+template <typename Cursor, typename Wand>
+class RangeMaxScoredCursor: public MaxScoredCursor<Cursor> {
+  public:
+    using base_cursor_type = Cursor;
+
+    RangeMaxScoredCursor(
+        Cursor cursor,
+        TermScorer term_scorer,
+        float weight,
+        float max_score,
+        std::size_t range_length,
+        typename Wand::wand_data_enumerator wdata,
+        std::optional<std::vector<std::pair<std::uint32_t, float>>> sparse_range_max_scores)
+        : MaxScoredCursor<Cursor>(std::move(cursor), std::move(term_scorer), weight, max_score),
+          m_range_length(range_length),
+          m_wdata(std::move(wdata)),
+          m_sparse(std::move(sparse_range_max_scores))
+    {}
+    RangeMaxScoredCursor(RangeMaxScoredCursor const&) = delete;
+    RangeMaxScoredCursor(RangeMaxScoredCursor&&) = default;
+    RangeMaxScoredCursor& operator=(RangeMaxScoredCursor const&) = delete;
+    RangeMaxScoredCursor& operator=(RangeMaxScoredCursor&&) = default;
+    ~RangeMaxScoredCursor() = default;
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto range_length() const noexcept -> std::size_t
+    {
+        return m_range_length;
+    }
+
+    /// Returns the maximum term score within the range of docids
+    /// `[range * range_length(), (range + 1) * range_length())`.
+    ///
+    /// Ranges must be requested in non-decreasing order.
+    [[nodiscard]] PISA_ALWAYSINLINE auto range_max_score(std::uint32_t range) -> float
+    {
+        if (not m_sparse) {
+            m_wdata.next_geq(range * m_range_length);
+            return m_wdata.score();
+        }
+        auto const& sparse = *m_sparse;
+        while (m_sparse_pos < sparse.size() && sparse[m_sparse_pos].first < range) {
+            ++m_sparse_pos;
+        }
+        if (m_sparse_pos < sparse.size() && sparse[m_sparse_pos].first == range) {
+            return sparse[m_sparse_pos].second;
+        }
+        return 0.0F;
+    }
+
+  private:
+    std::size_t m_range_length;
+    typename Wand::wand_data_enumerator m_wdata;
+    std::optional<std::vector<std::pair<std::uint32_t, float>>> m_sparse;
+    std::size_t m_sparse_pos = 0;
+};
+
+/// Replaces `cursors` with the range-max-scored cursors of `query`, reusing their storage.
+template <typename Index, typename WandType, typename Scorer>
+void make_range_max_scored_cursors(
+    Index const& index,
+    WandType const& wdata,
+    Scorer const& scorer,
+    Query const& query,
+    std::vector<RangeMaxScoredCursor<typename Index::document_enumerator, WandType>>& cursors)
+{
+    auto query_term_freqs = query_freqs(query.terms);
+    auto const& ranges = wdata.get_block_wand();
+
+    cursors.clear();
+    cursors.reserve(query_term_freqs.size());
+    std::transform(
+        query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
+            float weight = term.second;
+            auto max_weight = weight * wdata.max_term_weight(term.first);
+            auto term_scorer = scorer.term_scorer(term.first);
+            std::optional<std::vector<std::pair<std::uint32_t, float>>> sparse;
+            if (not ranges.has_block_max_scores(term.first)) {
+                auto list = index[term.first];
+                sparse = ranges.compute_sparse_block_max_scores(list, term_scorer);
+            }
+            return RangeMaxScoredCursor<typename Index::document_enumerator, WandType>(
+                std::move(index[term.first]),
+                std::move(term_scorer),
+                weight,
+                max_weight,
+                ranges.range_length(),
+                wdata.getenum(term.first),
+                std::move(sparse));
+        });
+}
+
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto make_range_max_scored_cursors(
+    Index const& index, WandType const& wdata, Scorer const& scorer, Query query)
+{
+    std::vector<RangeMaxScoredCursor<typename Index::document_enumerator, WandType>> cursors;
+    make_range_max_scored_cursors(index, wdata, scorer, query, cursors);
+    return cursors;
+}
+
+}  // namespace pisa
@@ -44,19 +44,30 @@ class ScoredCursor {
     float m_query_weight = 1.0;
 };
 
+/// Replaces `cursors` with the scored cursors of `query`, reusing their storage.
 template <typename Index, typename Scorer>
-[[nodiscard]] auto make_scored_cursors(Index const& index, Scorer const& scorer, Query query)
+void make_scored_cursors(
+    Index const& index,
+    Scorer const& scorer,
+    Query const& query,
+    std::vector<ScoredCursor<typename Index::document_enumerator>>& cursors)
 {
-    auto terms = query.terms;
-    auto query_term_freqs = query_freqs(terms);
+    auto query_term_freqs = query_freqs(query.terms);
 
-    std::vector<ScoredCursor<typename Index::document_enumerator>> cursors;
+    cursors.clear();
     cursors.reserve(query_term_freqs.size());
     std::transform(
         query_term_freqs.begin(), query_term_freqs.end(), std::back_inserter(cursors), [&](auto&& term) {
             return ScoredCursor<typename Index::document_enumerator>(
                 index[term.first], scorer.term_scorer(term.first), term.second);
         });
+}
+
+template <typename Index, typename Scorer>
+[[nodiscard]] auto make_scored_cursors(Index const& index, Scorer const& scorer, Query query)
+{
+    std::vector<ScoredCursor<typename Index::document_enumerator>> cursors;
+    make_scored_cursors(index, scorer, query, cursors);
     return cursors;
 }
 
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <cstdint>
+#include <fstream>
+#include <numeric>
 #include <string>
 #include <vector>
 
+#include "gsl/span"
+
 #include "binary_collection.hpp"
 #include "codec/block_codecs.hpp"
 #include "codec/varintgb.hpp"
@@ -32,6 +36,7 @@ class forward_index: public std::vector<std::vector<std::uint8_t>> {
 
     const std::size_t& term_count() const { return m_term_count; }
     const std::size_t& term_count(id_type document) const { return m_term_counts[document]; }
+    bool compressed() const { return m_compressed; }
 
     //! Compresses each document in `fwd` with a faster codec.
     static forward_index read(const std::string& input_file)
@@ -127,11 +132,10 @@ class forward_index: public std::vector<std::vector<std::uint8_t>> {
         }
     }
 
-    //! Decodes and returns the list of terms for a given document.
-    std::vector<id_type> terms(id_type document) const
+    //! Decodes the list of terms for a given document into `terms`, resized to their number.
+    void decode_terms(id_type document, std::vector<id_type>& terms) const
     {
         const entry_type& encoded_terms = (*this)[document];
-        std::vector<uint32_t> terms;
         if (m_compressed) {
             std::size_t term_count = m_term_counts[document];
             terms.resize(term_count);
@@ -142,8 +146,17 @@ class forward_index: public std::vector<std::vector<std::uint8_t>> {
             size_t n = 0;
             TightVariableByte::decode(encoded_terms.data(), terms.data(), encoded_terms.size(), n);
             terms.resize(n);
-            terms.shrink_to_fit();
+            // Terms are encoded as gaps.
+            std::partial_sum(terms.begin(), terms.end(), terms.begin());
         }
+    }
+
+    //! Decodes and returns the list of terms for a given document.
+    std::vector<id_type> terms(id_type document) const
+    {
+        std::vector<id_type> terms;
+        decode_terms(document, terms);
+        terms.shrink_to_fit();
         return terms;
     }
 
@@ -153,4 +166,234 @@ class forward_index: public std::vector<std::vector<std::uint8_t>> {
     bool m_compressed;
 };
 
+//! A forward index in compressed sparse row format: the terms of all documents are stored in one
+//! contiguous array, along with the offset of each document in it.
+//!
+//! Terms are stored either as term IDs or, if compressed, as varint-GB encoded gaps, in which case
+//! they are decoded into a buffer of the caller. Either way, iterating over the terms of a
+//! document allocates no memory once the buffer has grown to the longest document.
+class flat_forward_index {
+  public:
+    using id_type = forward_index::id_type;
+
+    flat_forward_index() = default;
+
+    //! Copies `fwd`, with its terms compressed if `compressed` is true.
+    flat_forward_index(const forward_index& fwd, bool compressed)
+        : m_term_count(fwd.term_count()),
+          m_offsets(fwd.size() + 1, 0),
+          m_term_counts(fwd.size()),
+          m_compressed(compressed)
+    {
+        progress p("Flattening forward index", fwd.size());
+        std::size_t total_count = 0;
+        std::size_t total_bytes = 0;
+        for (id_type doc = 0U; doc < fwd.size(); ++doc) {
+            total_count += fwd.term_count(doc);
+            total_bytes += fwd[doc].size();
+        }
+        if (m_compressed) {
+            m_bytes.reserve(total_bytes + padding);
+        } else {
+            m_terms.reserve(total_count);
+        }
+        std::vector<id_type> terms;
+        for (id_type doc = 0U; doc < fwd.size(); ++doc) {
+            fwd.decode_terms(doc, terms);
+            append_terms(doc, terms);
+            p.update(1);
+        }
+        finish();
+    }
+
+    //! Reads a forward index written by `forward_index::write` one document at a time, so that
+    //! only the flat copy is ever in memory. It is compressed if the file is.
+    static flat_forward_index read(const std::string& input_file)
+    {
+        std::ifstream in(input_file.c_str());
+        flat_forward_index fwd;
+        std::size_t docs_count;
+        in.read(reinterpret_cast<char*>(&fwd.m_compressed), sizeof(fwd.m_compressed));
+        in.read(reinterpret_cast<char*>(&fwd.m_term_count), sizeof(fwd.m_term_count));
+        in.read(reinterpret_cast<char*>(&docs_count), sizeof(docs_count));
+        fwd.m_offsets.resize(docs_count + 1, 0);
+        fwd.m_term_counts.resize(docs_count);
+        progress p("Reading forward index", docs_count);
+        std::vector<std::uint8_t> encoded_terms;
+        std::vector<id_type> terms;
+        for (id_type doc = 0; doc < docs_count; ++doc) {
+            std::size_t term_count;
+            std::size_t block_size;
+            in.read(reinterpret_cast<char*>(&term_count), sizeof(term_count));
+            in.read(reinterpret_cast<char*>(&block_size), sizeof(block_size));
+            if (fwd.m_compressed) {
+                // Both store the gaps between terms as varint-GB, so the bytes are copied as is.
+                auto offset = fwd.m_bytes.size();
+                fwd.m_bytes.resize(offset + block_size);
+                in.read(reinterpret_cast<char*>(fwd.m_bytes.data() + offset), block_size);
+                fwd.m_term_counts[doc] = term_count;
+                fwd.m_offsets[doc + 1] = fwd.m_bytes.size();
+            } else {
+                encoded_terms.resize(block_size);
+                in.read(reinterpret_cast<char*>(encoded_terms.data()), block_size);
+                terms.resize(block_size * 5);
+                std::size_t n = 0;
+                TightVariableByte::decode(encoded_terms.data(), terms.data(), block_size, n);
+                terms.resize(n);
+                std::partial_sum(terms.begin(), terms.end(), terms.begin());
+                fwd.append_terms(doc, terms);
+            }
+            p.update(1);
+        }
+        fwd.finish();
+        return fwd;
+    }
+
+    //! Builds the forward index of an inverted index without an intermediate `forward_index`,
+    //! skipping the posting lists shorter than `min_len`.
+    //!
+    //! Documents are transposed in batches of about `batch_postings` postings, so that besides the
+    //! result, only one batch of term IDs is held in memory.
+    static flat_forward_index from_inverted_index(
+        const std::string& input_basename,
+        std::size_t min_len,
+        bool compressed,
+        std::size_t batch_postings = std::size_t(1) << 24U)
+    {
+        binary_collection coll((input_basename + ".docs").c_str());
+
+        auto firstseq = *coll.begin();
+        if (firstseq.size() != 1) {
+            throw std::invalid_argument("First sequence should only contain number of documents");
+        }
+        auto num_docs = *firstseq.begin();
+
+        flat_forward_index fwd;
+        fwd.m_compressed = compressed;
+        fwd.m_offsets.resize(num_docs + 1, 0);
+        fwd.m_term_counts.resize(num_docs, 0);
+
+        // Term IDs of the lists that are long enough, with the next posting of each to transpose.
+        std::vector<id_type> list_terms;
+        std::vector<binary_collection::sequence> lists;
+        id_type tid = 0;
+        for (auto it = ++coll.begin(); it != coll.end(); ++it, ++tid) {
+            if (it->size() >= min_len) {
+                list_terms.push_back(tid);
+                lists.push_back(*it);
+                for (auto doc: *it) {
+                    fwd.m_term_counts[doc] += 1;
+                }
+            }
+        }
+        fwd.m_term_count = tid;
+        if (not compressed) {
+            auto const& counts = fwd.m_term_counts;
+            fwd.m_terms.reserve(std::accumulate(counts.begin(), counts.end(), std::size_t(0)));
+        }
+
+        progress p("Building forward index", num_docs);
+        std::vector<id_type> batch;
+        std::vector<std::size_t> ends;
+        for (id_type first = 0; first < num_docs;) {
+            // A batch has at least one document, however long.
+            id_type last = first + 1;
+            std::size_t batch_size = fwd.m_term_counts[first];
+            while (last < num_docs && batch_size + fwd.m_term_counts[last] <= batch_postings) {
+                batch_size += fwd.m_term_counts[last++];
+            }
+            ends.resize(last - first);
+            std::size_t end = 0;
+            for (id_type doc = first; doc < last; ++doc) {
+                ends[doc - first] = end;
+                end += fwd.m_term_counts[doc];
+            }
+            // Lists are in term order, so the terms of each document come out sorted.
+            batch.resize(batch_size);
+            for (std::size_t list = 0; list < lists.size(); ++list) {
+                auto& postings = lists[list];
+                auto pos = postings.begin();
+                for (; pos != postings.end() && *pos < last; ++pos) {
+                    batch[ends[*pos - first]++] = list_terms[list];
+                }
+                postings = binary_collection::sequence(pos, postings.end());
+            }
+            for (id_type doc = first; doc < last; ++doc) {
+                auto count = fwd.m_term_counts[doc];
+                auto terms = gsl::make_span(batch.data() + ends[doc - first] - count, count);
+                fwd.append_terms(doc, terms);
+            }
+            p.update(last - first);
+            first = last;
+        }
+        fwd.finish();
+        return fwd;
+    }
+
+    std::size_t size() const { return m_term_counts.size(); }
+    std::size_t term_count() const { return m_term_count; }
+    std::size_t term_count(id_type document) const { return m_term_counts[document]; }
+    bool compressed() const { return m_compressed; }
+
+    //! Returns the terms of `document`, decoded into `buffer` if compressed.
+    gsl::span<const id_type> terms(id_type document, std::vector<id_type>& buffer) const
+    {
+        auto count = m_term_counts[document];
+        if (not m_compressed) {
+            return gsl::make_span(m_terms.data() + m_offsets[document], count);
+        }
+        if (buffer.size() < count) {
+            buffer.resize(count);
+        }
+        VarIntGB<true> varintgb_codec;
+        varintgb_codec.decodeArray(m_bytes.data() + m_offsets[document], count, buffer.data());
+        return gsl::make_span(buffer.data(), count);
+    }
+
+    //! Calls `fn(term)` for each term of `document`, decoded into `buffer` if compressed.
+    template <typename Fn>
+    void for_each_term(id_type document, std::vector<id_type>& buffer, Fn fn) const
+    {
+        for (auto term: terms(document, buffer)) {
+            fn(term);
+        }
+    }
+
+  private:
+    static constexpr std::size_t padding = 4;
+
+    //! Appends the sorted `terms` of `document`, which must follow the last appended one.
+    void append_terms(id_type document, gsl::span<const id_type> terms)
+    {
+        m_term_counts[document] = terms.size();
+        if (m_compressed) {
+            VarIntGB<true> varintgb_codec;
+            auto offset = m_bytes.size();
+            m_bytes.resize(offset + 2 * terms.size() * sizeof(id_type));
+            auto* out = m_bytes.data() + offset;
+            auto byte_size = varintgb_codec.encodeArray(terms.data(), terms.size(), out);
+            m_bytes.resize(offset + byte_size);
+            m_offsets[document + 1] = m_bytes.size();
+        } else {
+            m_terms.insert(m_terms.end(), terms.begin(), terms.end());
+            m_offsets[document + 1] = m_terms.size();
+        }
+    }
+
+    void finish()
+    {
+        // Groups of terms are decoded with 4-byte reads, which may end past the last term.
+        m_bytes.resize(m_bytes.size() + padding);
+        m_bytes.shrink_to_fit();
+        m_terms.shrink_to_fit();
+    }
+
+    std::size_t m_term_count = 0;
+    std::vector<std::size_t> m_offsets{0};
+    std::vector<id_type> m_term_counts{};
+    std::vector<id_type> m_terms{};
+    std::vector<std::uint8_t> m_bytes{};
+    bool m_compressed = false;
+};
+
 }  // namespace pisa
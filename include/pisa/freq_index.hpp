@@ -1,11 +1,16 @@
 #pragma once
 
+#include <array>
+
+#include <gsl/span>
+
 #include "tbb/parallel_invoke.h"
 
 #include "bitvector_collection.hpp"
 #include "codec/compact_elias_fano.hpp"
 #include "codec/integer_codes.hpp"
 #include "global_parameters.hpp"
+#include "index_header.hpp"
 #include "mappable/mapper.hpp"
 #include "memory_source.hpp"
 
@@ -20,9 +25,11 @@ class freq_index {
 
     freq_index() = default;
 
-    explicit freq_index(MemorySource source) : m_source(std::move(source))
+    /// Maps the index in `source`, verifying its checksums if `flags` has `map_flags::warmup`.
+    explicit freq_index(MemorySource source, uint64_t flags = mapper::map_flags::warmup)
+        : m_source(std::move(source))
     {
-        mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
+        map_index(*this, m_source, flags);
     }
 
     class builder {
@@ -45,11 +52,7 @@ class freq_index {
             tbb::parallel_invoke(
                 [&] {
                     bit_vector_builder docs_bits;
-                    write_gamma_nonzero(docs_bits, occurrences);
-                    if (occurrences > 1) {
-                        docs_bits.append_bits(n, ceil_log2(occurrences + 1));
-                    }
-                    DocsSequence::write(docs_bits, docs_begin, m_num_docs, n, m_params);
+                    write_docs(docs_bits, n, docs_begin, occurrences);
                     m_docs_sequences.append(docs_bits);
                 },
                 [&] {
@@ -59,16 +62,73 @@ class freq_index {
                 });
         }
 
-        void build(freq_index& sq)
+        /// A posting list encoded by `encode_posting_list`, not yet added to the index.
+        struct encoded_posting_list {
+            bit_vector_builder docs;
+            bit_vector_builder freqs;
+        };
+
+        /// Encodes a posting list into `list` without modifying the builder, so that lists can
+        /// be encoded concurrently and then added in order with `add_encoded_posting_list`.
+        template <typename DocsIterator, typename FreqsIterator>
+        void encode_posting_list(
+            encoded_posting_list& list,
+            uint64_t n,
+            DocsIterator docs_begin,
+            FreqsIterator freqs_begin,
+            uint64_t occurrences) const
+        {
+            if (!n) {
+                throw std::invalid_argument("List must be nonempty");
+            }
+            bit_vector_builder().swap(list.docs);
+            bit_vector_builder().swap(list.freqs);
+            write_docs(list.docs, n, docs_begin, occurrences);
+            FreqsSequence::write(list.freqs, freqs_begin, occurrences + 1, n, m_params);
+        }
+
+        void add_encoded_posting_list(encoded_posting_list const& list)
+        {
+            m_docs_sequences.append(list.docs);
+            m_freqs_sequences.append(list.freqs);
+        }
+
+        /// Builds the index into `sq`, recording `encoding` in its header.
+        void build(freq_index& sq, std::string const& encoding = "")
         {
             sq.m_num_docs = m_num_docs;
             sq.m_params = m_params;
 
             m_docs_sequences.build(sq.m_docs_sequences);
             m_freqs_sequences.build(sq.m_freqs_sequences);
+
+            sq.m_header = IndexHeader(encoding, m_params, m_num_docs, sq.size());
+            auto add_sections = [&](std::string const& name, bitvector_collection const& sequences) {
+                auto const& endpoints = sequences.endpoints().data();
+                auto const& bits = sequences.bits().data();
+                sq.m_header.add_section(
+                    name + "_endpoints", mapper::offset_of(sq, endpoints), endpoints);
+                sq.m_header.add_section(name, mapper::offset_of(sq, bits), bits);
+            };
+            add_sections("docs", sq.m_docs_sequences);
+            add_sections("freqs", sq.m_freqs_sequences);
         }
 
       private:
+        template <typename DocsIterator>
+        void write_docs(
+            bit_vector_builder& docs_bits,
+            uint64_t n,
+            DocsIterator docs_begin,
+            uint64_t occurrences) const
+        {
+            write_gamma_nonzero(docs_bits, occurrences);
+            if (occurrences > 1) {
+                docs_bits.append_bits(n, ceil_log2(occurrences + 1));
+            }
+            DocsSequence::write(docs_bits, docs_begin, m_num_docs, n, m_params);
+        }
+
         global_parameters m_params;
         uint64_t m_num_docs = 0;
         bitvector_collection::builder m_docs_sequences;
@@ -156,15 +216,31 @@ class freq_index {
         return document_enumerator(docs_enum, freqs_enum);
     }
 
-    void warmup(size_t /* i */) const
+    /// Memory holding the docids and the frequencies of the posting list of term `i`.
+    std::array<gsl::span<char const>, 2> posting_list_memory(size_t i) const
+    {
+        assert(i < size());
+        return {m_docs_sequences.memory(m_params, i), m_freqs_sequences.memory(m_params, i)};
+    }
+
+    void warmup(size_t i) const
     {
-        // XXX implement this
+        volatile char tmp;
+        for (auto memory: posting_list_memory(i)) {
+            for (auto byte: memory) {
+                tmp = byte;
+            }
+        }
+        (void)tmp;
     }
 
     global_parameters const& params() const { return m_params; }
 
+    IndexHeader const& header() const { return m_header; }
+
     void swap(freq_index& other)
     {
+        std::swap(m_header, other.m_header);
         std::swap(m_params, other.m_params);
         std::swap(m_num_docs, other.m_num_docs);
         m_docs_sequences.swap(other.m_docs_sequences);
@@ -174,11 +250,12 @@ class freq_index {
     template <typename Visitor>
     void map(Visitor& visit)
     {
-        visit(m_params, "m_params")(m_num_docs, "m_num_docs")(m_docs_sequences, "m_docs_sequences")(
-            m_freqs_sequences, "m_freqs_sequences");
+        visit(m_header, "m_header")(m_params, "m_params")(m_num_docs, "m_num_docs")(
+            m_docs_sequences, "m_docs_sequences")(m_freqs_sequences, "m_freqs_sequences");
     }
 
   private:
+    IndexHeader m_header;
     global_parameters m_params;
     uint64_t m_num_docs = 0;
     bitvector_collection m_docs_sequences;
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "bit_vector.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
+
+#include "codec/compact_elias_fano.hpp"
+#include "hybrid_posting_list.hpp"
+#include "index_header.hpp"
+#include "memory_source.hpp"
+
+namespace pisa {
+
+struct HybridIndexTag;
+
+/// Fraction of the documents above which posting lists of hybrid indexes are stored as bitmaps.
+constexpr double default_density_threshold = 0.1;
+
+/// Index of block posting lists compressed with `BlockCodec`, where the lists of terms occurring
+/// in more than `density_threshold` of the documents are stored as bitmaps.
+///
+/// Dense lists, typically of stopword-like terms, are enumerated a word at a time instead of
+/// decoding a block of gaps per posting, and their intersections are word-level ANDs.
+template <typename BlockCodec>
+class hybrid_freq_index {
+  public:
+    using index_layout_tag = HybridIndexTag;
+
+    hybrid_freq_index() = default;
+    /// Maps the index in `source`, verifying its checksums if `flags` has `map_flags::warmup`.
+    explicit hybrid_freq_index(MemorySource source, uint64_t flags = mapper::map_flags::warmup)
+        : m_source(std::move(source))
+    {
+        map_index(*this, m_source, flags);
+    }
+
+    class builder {
+      public:
+        builder(
+            uint64_t num_docs,
+            global_parameters const& params,
+            double density_threshold = default_density_threshold)
+            : m_params(params), m_density_threshold(density_threshold)
+        {
+            m_num_docs = num_docs;
+            m_endpoints.push_back(0);
+        }
+
+        template <typename DocsIterator, typename FreqsIterator>
+        void add_posting_list(
+            uint64_t n,
+            DocsIterator docs_begin,
+            FreqsIterator freqs_begin,
+            uint64_t /* occurrences */)
+        {
+            if (!n) {
+                throw std::invalid_argument("List must be nonempty");
+            }
+            hybrid_posting_list<BlockCodec>::write(
+                m_lists,
+                m_bitmaps,
+                n,
+                docs_begin,
+                freqs_begin,
+                m_num_docs,
+                m_density_threshold,
+                m_params);
+            m_endpoints.push_back(m_lists.size());
+        }
+
+        /// A posting list encoded by `encode_posting_list`, whose docids, if it is dense, are
+        /// in its own bitmap until it is added to the index.
+        struct encoded_posting_list {
+            std::vector<uint8_t> data;
+            bit_vector_builder bitmap;
+        };
+
+        /// Encodes a posting list into `list` without modifying the builder, so that lists can
+        /// be encoded concurrently and then added in order with `add_encoded_posting_list`.
+        template <typename DocsIterator, typename FreqsIterator>
+        void encode_posting_list(
+            encoded_posting_list& list,
+            uint64_t n,
+            DocsIterator docs_begin,
+            FreqsIterator freqs_begin,
+            uint64_t /* occurrences */) const
+        {
+            if (!n) {
+                throw std::invalid_argument("List must be nonempty");
+            }
+            list.data.clear();
+            bit_vector_builder().swap(list.bitmap);
+            hybrid_posting_list<BlockCodec>::write(
+                list.data,
+                list.bitmap,
+                n,
+                docs_begin,
+                freqs_begin,
+                m_num_docs,
+                m_density_threshold,
+                m_params);
+        }
+
+        void add_encoded_posting_list(encoded_posting_list const& list)
+        {
+            auto begin = m_lists.size();
+            m_lists.insert(m_lists.end(), list.data.begin(), list.data.end());
+            hybrid_posting_list<BlockCodec>::relocate_bitmap(&m_lists[begin], m_bitmaps.size());
+            m_bitmaps.append(list.bitmap);
+            m_endpoints.push_back(m_lists.size());
+        }
+
+        /// Builds the index into `sq`, recording `encoding` in its header.
+        void build(hybrid_freq_index& sq, std::string const& encoding = "")
+        {
+            sq.m_params = m_params;
+            sq.m_size = m_endpoints.size() - 1;
+            sq.m_num_docs = m_num_docs;
+            sq.m_lists.steal(m_lists);
+            bit_vector(&m_bitmaps).swap(sq.m_bitmaps);
+
+            bit_vector_builder bvb;
+            compact_elias_fano::write(bvb, m_endpoints.begin(), sq.m_lists.size(), sq.m_size, m_params);
+            bit_vector(&bvb).swap(sq.m_endpoints);
+
+            sq.m_header = IndexHeader(encoding, m_params, m_num_docs, sq.m_size);
+            sq.m_header.add_section(
+                "endpoints", mapper::offset_of(sq, sq.m_endpoints.data()), sq.m_endpoints.data());
+            sq.m_header.add_section("lists", mapper::offset_of(sq, sq.m_lists), sq.m_lists);
+            sq.m_header.add_section(
+                "bitmaps", mapper::offset_of(sq, sq.m_bitmaps.data()), sq.m_bitmaps.data());
+        }
+
+      private:
+        global_parameters m_params;
+        double m_density_threshold;
+        size_t m_num_docs;
+        std::vector<uint64_t> m_endpoints;
+        std::vector<uint8_t> m_lists;
+        bit_vector_builder m_bitmaps;
+    };
+
+    size_t size() const { return m_size; }
+
+    uint64_t num_docs() const { return m_num_docs; }
+
+    IndexHeader const& header() const { return m_header; }
+
+    using document_enumerator = typename hybrid_posting_list<BlockCodec>::document_enumerator;
+
+    document_enumerator operator[](size_t i) const
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+
+        auto endpoint = endpoints.move(i).second;
+        return document_enumerator(m_lists.data() + endpoint, m_bitmaps, num_docs(), m_params, i);
+    }
+
+    void warmup(size_t i) const
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+
+        auto begin = endpoints.move(i).second;
+        auto end = m_lists.size();
+        if (i + 1 != size()) {
+            end = endpoints.move(i + 1).second;
+        }
+
+        volatile uint32_t tmp;
+        for (size_t i = begin; i != end; ++i) {
+            tmp = m_lists[i];
+        }
+        (void)tmp;
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_header, "m_header")(m_params, "m_params")(m_size, "m_size")(
+            m_num_docs, "m_num_docs")(m_endpoints, "m_endpoints")(m_lists, "m_lists")(
+            m_bitmaps, "m_bitmaps");
+    }
+
+  private:
+    IndexHeader m_header;
+    global_parameters m_params;
+    size_t m_size{0};
+    size_t m_num_docs{0};
+    bit_vector m_endpoints;
+    mapper::mappable_vector<uint8_t> m_lists;
+    bit_vector m_bitmaps;
+    MemorySource m_source;
+};
+}  // namespace pisa
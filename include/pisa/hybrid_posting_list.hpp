@@ -0,0 +1,318 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include "bit_vector.hpp"
+#include "block_posting_list.hpp"
+#include "codec/block_codecs.hpp"
+#include "codec/compact_ranked_bitvector.hpp"
+#include "global_parameters.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// Posting lists compressed in blocks with `BlockCodec` like `block_posting_list`, except for
+/// dense lists, with more than `density_threshold * universe` postings, whose docids are stored
+/// in a bitmap instead.
+///
+/// A dense list starts with a zero, which is never the length of a block posting list, followed
+/// by its length, the offset of its docids in a bit vector shared by all lists, and its
+/// frequencies compressed in blocks. The docids are a `compact_ranked_bitvector`, so that they
+/// are enumerated a word at a time and skipped with its rank samples.
+template <typename BlockCodec>
+struct hybrid_posting_list {
+    using sparse_list = block_posting_list<BlockCodec>;
+
+    static bool is_dense(uint64_t n, uint64_t universe, double density_threshold)
+    {
+        return static_cast<double>(n) > density_threshold * static_cast<double>(universe);
+    }
+
+    template <typename DocsIterator, typename FreqsIterator>
+    static void write(
+        std::vector<uint8_t>& out,
+        bit_vector_builder& bitmaps,
+        uint32_t n,
+        DocsIterator docs_begin,
+        FreqsIterator freqs_begin,
+        uint64_t universe,
+        double density_threshold,
+        global_parameters const& params)
+    {
+        if (not is_dense(n, universe, density_threshold)) {
+            sparse_list::write(out, n, docs_begin, freqs_begin);
+            return;
+        }
+
+        TightVariableByte::encode_single(0, out);
+        TightVariableByte::encode_single(n, out);
+        uint64_t offset = bitmaps.size();
+        auto const* offset_bytes = reinterpret_cast<uint8_t const*>(&offset);
+        out.insert(out.end(), offset_bytes, offset_bytes + sizeof(offset));
+        compact_ranked_bitvector::write(bitmaps, docs_begin, universe, n, params);
+
+        uint64_t block_size = BlockCodec::block_size;
+        uint64_t blocks = ceil_div(n, block_size);
+        size_t begin_block_endpoints = out.size();
+        size_t begin_blocks = begin_block_endpoints + 4 * (blocks - 1);
+        out.resize(begin_blocks);
+
+        FreqsIterator freqs_it(freqs_begin);
+        std::vector<uint32_t> freqs_buf(block_size);
+        for (size_t b = 0; b < blocks; ++b) {
+            uint32_t cur_block_size = ((b + 1) * block_size <= n) ? block_size : (n % block_size);
+            for (size_t i = 0; i < cur_block_size; ++i) {
+                freqs_buf[i] = *freqs_it++ - 1;
+            }
+            BlockCodec::encode(freqs_buf.data(), uint32_t(-1), cur_block_size, out);
+            if (b != blocks - 1) {
+                *((uint32_t*)&out[begin_block_endpoints + 4 * b]) = out.size() - begin_blocks;
+            }
+        }
+    }
+
+    /// Moves the docids of the list at `data` by `shift` bits in the shared bit vector, e.g.,
+    /// when the list was written with its own bit vector, which is then appended to the shared
+    /// one. The docids do not depend on their offset, so they need not be rewritten.
+    static void relocate_bitmap(uint8_t* data, uint64_t shift)
+    {
+        uint32_t n;
+        auto* offset_bytes = const_cast<uint8_t*>(TightVariableByte::decode(data, &n, 1));
+        if (n != 0) {
+            return;
+        }
+        offset_bytes = const_cast<uint8_t*>(TightVariableByte::decode(offset_bytes, &n, 1));
+        uint64_t offset;
+        std::memcpy(&offset, offset_bytes, sizeof(offset));
+        offset += shift;
+        std::memcpy(offset_bytes, &offset, sizeof(offset));
+    }
+
+    /// Enumerates a dense list, given its data after the leading zero.
+    class dense_enumerator {
+      public:
+        dense_enumerator(
+            uint8_t const* data,
+            bit_vector const& bitmaps,
+            uint64_t universe,
+            global_parameters const& params)
+            : m_blocks_data(TightVariableByte::decode(data, &m_n, 1) + sizeof(uint64_t)),
+              m_bitmaps(&bitmaps),
+              m_universe(universe),
+              m_docs(bitmaps, bitmap_offset(data), universe, m_n, params),
+              m_bits_offset(
+                  compact_ranked_bitvector::offsets(bitmap_offset(data), universe, m_n, params)
+                      .bits_offset)
+        {
+            m_blocks = ceil_div(m_n, BlockCodec::block_size);
+            m_block_endpoints = m_blocks_data;
+            m_blocks_data += 4 * (m_blocks - 1);
+            reset();
+        }
+
+        void reset() { std::tie(m_position, m_docid) = m_docs.move(0); }
+
+        void PISA_ALWAYSINLINE next() { std::tie(m_position, m_docid) = m_docs.next(); }
+
+        void PISA_ALWAYSINLINE next_geq(uint64_t lower_bound)
+        {
+            std::tie(m_position, m_docid) = m_docs.next_geq(lower_bound);
+        }
+
+        void PISA_ALWAYSINLINE move(uint64_t pos)
+        {
+            std::tie(m_position, m_docid) = m_docs.move(pos);
+        }
+
+        uint64_t docid() const { return m_docid; }
+
+        uint64_t PISA_ALWAYSINLINE freq()
+        {
+            uint64_t block = m_position / BlockCodec::block_size;
+            if (PISA_UNLIKELY(block != m_freqs_block)) {
+                decode_freqs_block(block);
+            }
+            return m_freqs_buf[m_position % BlockCodec::block_size] + 1;
+        }
+
+        uint64_t position() const { return m_position; }
+
+        uint64_t size() const { return m_n; }
+
+        /// The 64 bits of the bitmap starting at `docid`, which must be less than the universe;
+        /// bit `i` is set if document `docid + i` is in the list.
+        uint64_t docs_word(uint64_t docid) const
+        {
+            assert(docid < m_universe);
+            uint64_t word = m_bitmaps->get_word(m_bits_offset + docid);
+            if (m_universe - docid < 64) {
+                word &= (uint64_t(1) << (m_universe - docid)) - 1;
+            }
+            return word;
+        }
+
+        uint64_t stats_freqs_size() const
+        {
+            std::array<uint32_t, BlockCodec::block_size> buf;
+            uint64_t last_block = m_blocks - 1;
+            uint8_t const* end = BlockCodec::decode(
+                block_data(last_block), buf.data(), uint32_t(-1), block_size(last_block));
+            return end - m_block_endpoints;
+        }
+
+      private:
+        static uint64_t bitmap_offset(uint8_t const* data)
+        {
+            uint32_t n;
+            uint64_t offset;
+            std::memcpy(&offset, TightVariableByte::decode(data, &n, 1), sizeof(offset));
+            return offset;
+        }
+
+        uint8_t const* block_data(uint64_t block) const
+        {
+            uint32_t endpoint = block != 0U ? ((uint32_t const*)m_block_endpoints)[block - 1] : 0;
+            return m_blocks_data + endpoint;
+        }
+
+        uint32_t block_size(uint64_t block) const
+        {
+            static const uint64_t block_size = BlockCodec::block_size;
+            return ((block + 1) * block_size <= size()) ? block_size : (size() % block_size);
+        }
+
+        void PISA_NOINLINE decode_freqs_block(uint64_t block)
+        {
+            BlockCodec::decode(
+                block_data(block), m_freqs_buf.data(), uint32_t(-1), block_size(block));
+            m_freqs_block = block;
+        }
+
+        uint32_t m_n{0};
+        uint8_t const* m_blocks_data;
+        uint8_t const* m_block_endpoints{nullptr};
+        uint64_t m_blocks{0};
+        bit_vector const* m_bitmaps;
+        uint64_t m_universe;
+        compact_ranked_bitvector::enumerator m_docs;
+        uint64_t m_bits_offset;
+
+        uint64_t m_position{0};
+        uint64_t m_docid{0};
+        uint64_t m_freqs_block{uint64_t(-1)};
+        alignas(64) std::array<uint32_t, BlockCodec::block_size> m_freqs_buf;
+    };
+
+    /// Enumerates either kind of list, with the interface of the block posting list enumerator.
+    class document_enumerator {
+      public:
+        using sparse_enumerator = typename sparse_list::document_enumerator;
+
+        document_enumerator(
+            uint8_t const* data,
+            bit_vector const& bitmaps,
+            uint64_t universe,
+            global_parameters const& params,
+            size_t term_id = 0)
+            : m_enumerator(open(data, bitmaps, universe, params, term_id))
+        {}
+
+        void reset()
+        {
+            visit([](auto& e) { e.reset(); });
+        }
+
+        void PISA_ALWAYSINLINE next()
+        {
+            visit([](auto& e) { e.next(); });
+        }
+
+        void PISA_ALWAYSINLINE next_geq(uint64_t lower_bound)
+        {
+            visit([lower_bound](auto& e) { e.next_geq(lower_bound); });
+        }
+
+        void PISA_ALWAYSINLINE move(uint64_t pos)
+        {
+            visit([pos](auto& e) { e.move(pos); });
+        }
+
+        uint64_t PISA_ALWAYSINLINE docid() const
+        {
+            return visit([](auto const& e) -> uint64_t { return e.docid(); });
+        }
+
+        uint64_t PISA_ALWAYSINLINE freq()
+        {
+            return visit([](auto& e) -> uint64_t { return e.freq(); });
+        }
+
+        uint64_t position() const
+        {
+            return visit([](auto const& e) { return e.position(); });
+        }
+
+        uint64_t size() const
+        {
+            return visit([](auto const& e) -> uint64_t { return e.size(); });
+        }
+
+        /// Whether the docids are stored in a bitmap, which can be read with `docs_word()`.
+        bool dense() const { return std::holds_alternative<dense_enumerator>(m_enumerator); }
+
+        uint64_t docs_word(uint64_t docid) const
+        {
+            assert(dense());
+            return std::get_if<dense_enumerator>(&m_enumerator)->docs_word(docid);
+        }
+
+        uint64_t stats_freqs_size() const
+        {
+            return visit([](auto const& e) { return e.stats_freqs_size(); });
+        }
+
+      private:
+        using variant_type = std::variant<sparse_enumerator, dense_enumerator>;
+
+        static variant_type open(
+            uint8_t const* data,
+            bit_vector const& bitmaps,
+            uint64_t universe,
+            global_parameters const& params,
+            size_t term_id)
+        {
+            uint32_t n;
+            uint8_t const* rest = TightVariableByte::decode(data, &n, 1);
+            if (n == 0) {
+                return variant_type(std::in_place_index<1>, rest, bitmaps, universe, params);
+            }
+            return variant_type(std::in_place_index<0>, data, universe, term_id);
+        }
+
+        template <typename Fn>
+        PISA_ALWAYSINLINE decltype(auto) visit(Fn fn)
+        {
+            if (auto* dense = std::get_if<dense_enumerator>(&m_enumerator); dense != nullptr) {
+                return fn(*dense);
+            }
+            return fn(*std::get_if<sparse_enumerator>(&m_enumerator));
+        }
+
+        template <typename Fn>
+        PISA_ALWAYSINLINE decltype(auto) visit(Fn fn) const
+        {
+            if (auto const* dense = std::get_if<dense_enumerator>(&m_enumerator); dense != nullptr) {
+                return fn(*dense);
+            }
+            return fn(*std::get_if<sparse_enumerator>(&m_enumerator));
+        }
+
+        variant_type m_enumerator;
+    };
+};
+
+}  // namespace pisa
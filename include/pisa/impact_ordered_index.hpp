@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "bit_vector.hpp"
+#include "codec/block_codecs.hpp"
+#include "codec/compact_elias_fano.hpp"
+#include "global_parameters.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+struct ImpactIndexTag;
+
+/// Inverted index of quantized scores (impacts) ordered by impact instead of document ID,
+/// for score-at-a-time query processing.
+///
+/// Each posting list is a sequence of segments in decreasing order of impact, where a segment
+/// holds the increasing IDs of all documents with the same impact for the term, compressed in
+/// blocks with `BlockCodec`. Postings with zero impact do not contribute to any score and are
+/// not stored, so a posting list may be empty.
+template <typename BlockCodec>
+class impact_ordered_index {
+  public:
+    using index_layout_tag = ImpactIndexTag;
+
+    impact_ordered_index() = default;
+    explicit impact_ordered_index(MemorySource source, uint64_t flags = mapper::map_flags::warmup)
+        : m_source(std::move(source))
+    {
+        mapper::map(*this, m_source.data(), flags);
+    }
+
+    class builder {
+      public:
+        builder(uint64_t num_docs, global_parameters const& params) : m_params(params)
+        {
+            m_num_docs = num_docs;
+            m_endpoints.push_back(0);
+        }
+
+        /// Adds the posting list of the next term, given in increasing order of document IDs
+        /// along with the impact of each posting.
+        template <typename DocsIterator, typename ImpactsIterator>
+        void add_posting_list(uint64_t n, DocsIterator docs_begin, ImpactsIterator impacts_begin)
+        {
+            m_postings.clear();
+            for (uint64_t pos = 0; pos < n; ++pos, ++docs_begin, ++impacts_begin) {
+                if (*impacts_begin > 0) {
+                    m_postings.emplace_back(*impacts_begin, *docs_begin);
+                }
+            }
+            // Stable, so that documents of each segment stay sorted.
+            std::stable_sort(
+                m_postings.begin(), m_postings.end(), [](auto const& lhs, auto const& rhs) {
+                    return lhs.first > rhs.first;
+                });
+            write(m_lists, m_postings);
+            m_endpoints.push_back(m_lists.size());
+        }
+
+        void build(impact_ordered_index& index)
+        {
+            index.m_params = m_params;
+            index.m_size = m_endpoints.size() - 1;
+            index.m_num_docs = m_num_docs;
+            index.m_lists.steal(m_lists);
+
+            bit_vector_builder bvb;
+            compact_elias_fano::write(
+                bvb, m_endpoints.begin(), index.m_lists.size(), index.m_size, m_params);
+            bit_vector(&bvb).swap(index.m_endpoints);
+        }
+
+      private:
+        static void
+        write(std::vector<uint8_t>& out, std::vector<std::pair<uint32_t, uint32_t>> const& postings)
+        {
+            auto segment_end = [&](auto first) {
+                return std::find_if(first, postings.end(), [impact = first->first](auto const& p) {
+                    return p.first != impact;
+                });
+            };
+            uint32_t segments = 0;
+            for (auto first = postings.begin(); first != postings.end();
+                 first = segment_end(first)) {
+                ++segments;
+            }
+            TightVariableByte::encode_single(postings.size(), out);
+            TightVariableByte::encode_single(segments, out);
+
+            std::vector<uint32_t> docs_buf(BlockCodec::block_size);
+            for (auto first = postings.begin(); first != postings.end();) {
+                auto last = segment_end(first);
+                TightVariableByte::encode_single(first->first, out);
+                TightVariableByte::encode_single(std::distance(first, last), out);
+                int64_t last_doc = -1;
+                while (first != last) {
+                    auto block_size = std::min<std::size_t>(
+                        BlockCodec::block_size, std::distance(first, last));
+                    for (std::size_t i = 0; i < block_size; ++i, ++first) {
+                        docs_buf[i] = first->second - last_doc - 1;
+                        last_doc = first->second;
+                    }
+                    BlockCodec::encode(docs_buf.data(), uint32_t(-1), block_size, out);
+                }
+            }
+        }
+
+        global_parameters m_params;
+        size_t m_num_docs;
+        std::vector<uint64_t> m_endpoints;
+        std::vector<uint8_t> m_lists;
+        std::vector<std::pair<uint32_t, uint32_t>> m_postings;
+    };
+
+    /// Enumerates the segments of a posting list in decreasing order of impact.
+    class segment_enumerator {
+      public:
+        explicit segment_enumerator(uint8_t const* data)
+        {
+            uint32_t header[2];
+            m_data = TightVariableByte::decode(data, header, 2);
+            m_size = header[0];
+            m_num_segments = header[1];
+            read_segment_header();
+        }
+
+        /// Number of postings in all segments.
+        [[nodiscard]] auto size() const noexcept -> uint64_t { return m_size; }
+        [[nodiscard]] auto num_segments() const noexcept -> uint64_t { return m_num_segments; }
+
+        /// Whether all segments have been consumed.
+        [[nodiscard]] auto empty() const noexcept -> bool { return m_segment == m_num_segments; }
+
+        /// Impact of the current segment.
+        [[nodiscard]] auto impact() const noexcept -> uint32_t { return m_impact; }
+
+        /// Number of documents in the current segment.
+        [[nodiscard]] auto segment_size() const noexcept -> uint32_t { return m_segment_size; }
+
+        /// Calls `fn` with each document of the current segment and moves to the next one.
+        template <typename Fn>
+        void PISA_ALWAYSINLINE consume_segment(Fn&& fn)
+        {
+            assert(not empty());
+            uint32_t docid = uint32_t(-1);
+            for (uint32_t remaining = m_segment_size; remaining > 0;) {
+                auto block_size = std::min<uint32_t>(BlockCodec::block_size, remaining);
+                m_data = BlockCodec::decode(m_data, m_docs_buf.data(), uint32_t(-1), block_size);
+                for (uint32_t i = 0; i < block_size; ++i) {
+                    docid += m_docs_buf[i] + 1;
+                    fn(docid);
+                }
+                remaining -= block_size;
+            }
+            ++m_segment;
+            read_segment_header();
+        }
+
+      private:
+        void read_segment_header()
+        {
+            if (empty()) {
+                m_impact = 0;
+                m_segment_size = 0;
+                return;
+            }
+            uint32_t header[2];
+            m_data = TightVariableByte::decode(m_data, header, 2);
+            m_impact = header[0];
+            m_segment_size = header[1];
+        }
+
+        uint8_t const* m_data;
+        uint64_t m_size{0};
+        uint64_t m_num_segments{0};
+        uint64_t m_segment{0};
+        uint32_t m_impact{0};
+        uint32_t m_segment_size{0};
+        alignas(64) std::array<uint32_t, BlockCodec::block_size> m_docs_buf;
+    };
+
+    size_t size() const { return m_size; }
+
+    uint64_t num_docs() const { return m_num_docs; }
+
+    segment_enumerator operator[](size_t i) const
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+        return segment_enumerator(m_lists.data() + endpoints.move(i).second);
+    }
+
+    void warmup(size_t i) const
+    {
+        assert(i < size());
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(), m_size, m_params);
+
+        auto begin = endpoints.move(i).second;
+        auto end = m_lists.size();
+        if (i + 1 != size()) {
+            end = endpoints.move(i + 1).second;
+        }
+
+        volatile uint32_t tmp;
+        for (size_t i = begin; i != end; ++i) {
+            tmp = m_lists[i];
+        }
+        (void)tmp;
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_params, "m_params")(m_size, "m_size")(m_num_docs, "m_num_docs")(
+            m_endpoints, "m_endpoints")(m_lists, "m_lists");
+    }
+
+  private:
+    global_parameters m_params;
+    size_t m_size{0};
+    size_t m_num_docs{0};
+    bit_vector m_endpoints;
+    mapper::mappable_vector<uint8_t> m_lists;
+    MemorySource m_source;
+};
+
+}  // namespace pisa
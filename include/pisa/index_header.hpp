@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <fmt/format.h>
+#include <gsl/span>
+
+#include "global_parameters.hpp"
+#include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "util/xxhash.hpp"
+
+namespace pisa {
+
+/// A region of an index file, whose integrity is checked with its checksum.
+struct IndexSection {
+    std::array<char, 24> name;
+    /// Byte offset from the beginning of the file.
+    uint64_t offset;
+    uint64_t bytes;
+    /// XXH64 of the bytes of the section.
+    uint64_t checksum;
+
+    [[nodiscard]] auto verify(char const* file_data) const -> bool
+    {
+        return xxhash64_of(file_data + offset, bytes) == checksum;
+    }
+};
+
+/// Header written at the beginning of index files, describing their encoding and parameters, and
+/// locating their largest sections along with their checksums.
+///
+/// The header is the first member mapped by the indexes that have one, so that it can be read
+/// without knowing the type of the index, e.g., to detect its encoding.
+class IndexHeader {
+  public:
+    /// "PISAIDX" followed by a zero byte, in little endian.
+    static constexpr uint64_t magic_number = 0x0058444941534950;
+    static constexpr uint64_t current_version = 1;
+    static constexpr std::size_t max_sections = 4;
+
+    IndexHeader() = default;
+    IndexHeader(
+        std::string const& encoding,
+        global_parameters const& params,
+        uint64_t num_docs,
+        uint64_t num_terms)
+        : m_magic(magic_number),
+          m_version(current_version),
+          m_params(params),
+          m_num_docs(num_docs),
+          m_num_terms(num_terms)
+    {
+        if (encoding.size() >= m_encoding.size()) {
+            throw std::invalid_argument(fmt::format("Encoding name too long: {}", encoding));
+        }
+        std::copy(encoding.begin(), encoding.end(), m_encoding.begin());
+    }
+
+    void add_section(std::string const& name, uint64_t offset, uint64_t bytes, uint64_t checksum)
+    {
+        if (m_num_sections == max_sections) {
+            throw std::logic_error("Too many index sections");
+        }
+        auto& section = m_sections[m_num_sections++];
+        auto len = std::min(name.size(), section.name.size() - 1);
+        std::copy(name.begin(), name.begin() + len, section.name.begin());
+        section.offset = offset;
+        section.bytes = bytes;
+        section.checksum = checksum;
+    }
+
+    /// Adds the data of `vec` as a section, found at `offset` of the index file.
+    template <typename T>
+    void add_section(std::string const& name, uint64_t offset, mapper::mappable_vector<T> const& vec)
+    {
+        auto bytes = vec.size() * sizeof(T);
+        add_section(name, offset, bytes, xxhash64_of(vec.data(), bytes));
+    }
+
+    [[nodiscard]] auto valid() const -> bool { return m_magic == magic_number; }
+    [[nodiscard]] auto version() const -> uint64_t { return m_version; }
+    [[nodiscard]] auto encoding() const -> std::string { return std::string(m_encoding.data()); }
+    [[nodiscard]] auto params() const -> global_parameters const& { return m_params; }
+    [[nodiscard]] auto num_docs() const -> uint64_t { return m_num_docs; }
+    [[nodiscard]] auto num_terms() const -> uint64_t { return m_num_terms; }
+    [[nodiscard]] auto sections() const -> gsl::span<IndexSection const>
+    {
+        return gsl::make_span(m_sections.data(), m_num_sections);
+    }
+
+    /// Checks that all sections are within the index file in `source`, without reading them.
+    ///
+    /// \throws std::runtime_error  if a section is out of bounds
+    void check_bounds(MemorySource const& source) const
+    {
+        for (auto const& section: sections()) {
+            check_bounds(source, section);
+        }
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_magic, "m_magic")(m_version, "m_version")(m_encoding, "m_encoding")(
+            m_params, "m_params")(m_num_docs, "m_num_docs")(m_num_terms, "m_num_terms")(
+            m_num_sections, "m_num_sections")(m_sections, "m_sections");
+    }
+
+  private:
+    static void check_bounds(MemorySource const& source, IndexSection const& section)
+    {
+        if (section.offset + section.bytes > source.size()) {
+            throw std::runtime_error(
+                fmt::format("Index section {} is out of bounds", section.name.data()));
+        }
+    }
+
+    uint64_t m_magic = 0;
+    uint64_t m_version = 0;
+    std::array<char, 32> m_encoding{};
+    global_parameters m_params;
+    uint64_t m_num_docs = 0;
+    uint64_t m_num_terms = 0;
+    uint64_t m_num_sections = 0;
+    std::array<IndexSection, max_sections> m_sections{};
+};
+
+/// Reads the header of the index file mapped at `data`, of `size` bytes, or returns `nullopt` if
+/// it does not start with one, e.g., if it was built before indexes had headers.
+[[nodiscard]] inline auto read_index_header(char const* data, std::size_t size)
+    -> std::optional<IndexHeader>
+{
+    IndexHeader header;
+    if (size < mapper::size_of(header) + sizeof(uint64_t)) {
+        return std::nullopt;
+    }
+    mapper::map(header, data);
+    if (not header.valid()) {
+        return std::nullopt;
+    }
+    return header;
+}
+
+[[nodiscard]] inline auto read_index_header(std::string const& filename)
+    -> std::optional<IndexHeader>
+{
+    IndexHeader header;
+    std::vector<char> buffer(mapper::size_of(header) + sizeof(uint64_t));
+    std::ifstream is(filename, std::ios::binary);
+    is.read(buffer.data(), buffer.size());
+    return read_index_header(buffer.data(), is.gcount());
+}
+
+/// Path of the file recording which sections of the index file `index_file` have been verified.
+[[nodiscard]] inline auto verified_sections_path(boost::filesystem::path const& index_file)
+    -> boost::filesystem::path
+{
+    return index_file.string() + ".verified";
+}
+
+/// Checksums of the sections of the index file `index_file` recorded as verified, if the record
+/// was made for the same file: same device, inode, size, and modification time to the
+/// nanosecond. Returns none where files cannot be identified this way.
+[[nodiscard]] auto read_verified_checksums(boost::filesystem::path const& index_file)
+    -> std::vector<uint64_t>;
+
+/// Records `checksums` as verified for the index file `index_file`, through a unique temporary
+/// file renamed over the record, so that concurrent loads do not clash. Does nothing if the
+/// record cannot be written, e.g., if the directory of the index is read-only.
+void record_verified_checksums(
+    boost::filesystem::path const& index_file, gsl::span<uint64_t const> checksums);
+
+/// Verifies the checksums of the sections of `header` in `source`, in parallel, except those
+/// recorded as verified for the file `source` maps. Hashing a section reads it, so this is
+/// what warms up an index; sections known to be good are only advised to be read ahead.
+///
+/// \throws std::runtime_error  if the checksum of a section differs
+void verify_sections(IndexHeader const& header, MemorySource const& source);
+
+namespace detail {
+
+    /// Maps an index built before indexes had headers, skipping its `m_header`.
+    class legacy_map_visitor: public mapper::detail::map_visitor {
+      public:
+        using map_visitor::map_visitor;
+
+        template <typename T>
+        legacy_map_visitor& operator()(T& val, char const* friendly_name)
+        {
+            if constexpr (not std::is_same_v<T, IndexHeader>) {
+                map_visitor::operator()(val, friendly_name);
+            }
+            return *this;
+        }
+    };
+
+}  // namespace detail
+
+/// Maps `index` from `source` after checking its header. If `flags` has `map_flags::warmup`,
+/// the checksums of the sections are verified instead of reading the whole index to warm it up
+/// (see `verify_sections`). Without it, only the bounds of the sections are checked, and the
+/// index is paged in on demand. Indexes built before headers were introduced are mapped with
+/// the warmup of `flags` and without a header, leaving that of `index` invalid.
+///
+/// \throws std::runtime_error  if the index was built by another version, or is corrupted
+template <typename Index>
+void map_index(Index& index, MemorySource const& source, uint64_t flags = mapper::map_flags::warmup)
+{
+    auto header = read_index_header(source.data(), source.size());
+    if (not header) {
+        detail::legacy_map_visitor visitor(source.data(), flags);
+        index.map(visitor);
+        return;
+    }
+    if (header->version() != IndexHeader::current_version) {
+        throw std::runtime_error(fmt::format(
+            "Index version {} is not supported (expected {})",
+            header->version(),
+            IndexHeader::current_version));
+    }
+    header->check_bounds(source);
+    if (flags & mapper::map_flags::warmup) {
+        verify_sections(*header, source);
+        flags &= ~static_cast<uint64_t>(mapper::map_flags::warmup);
+    }
+    mapper::map(index, source.data(), flags);
+}
+
+}  // namespace pisa
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace pisa {
+
+/// Functions of type `Fn` instantiated for particular index types, looked up by name at runtime.
+///
+/// Instead of expanding a function template for every index type in the translation unit that
+/// dispatches on the encoding, each instantiation is compiled in its own translation unit, which
+/// adds it to the registry with a static `IndexRegistration`. The encodings compiled in are
+/// selected with the `PISA_INDEX_ENCODINGS` build option.
+template <typename Fn>
+class IndexRegistry {
+  public:
+    static auto instance() -> IndexRegistry&
+    {
+        static IndexRegistry registry;
+        return registry;
+    }
+
+    void add(std::string const& key, Fn* fn)
+    {
+        if (not m_functions.emplace(key, fn).second) {
+            throw std::logic_error(fmt::format("Duplicate index registry key: {}", key));
+        }
+    }
+
+    /// Returns the function registered under `key`, or null if none is.
+    [[nodiscard]] auto find(std::string const& key) const -> Fn*
+    {
+        if (auto pos = m_functions.find(key); pos != m_functions.end()) {
+            return pos->second;
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] auto keys() const -> std::vector<std::string>
+    {
+        std::vector<std::string> keys;
+        for (auto const& entry: m_functions) {
+            keys.push_back(entry.first);
+        }
+        return keys;
+    }
+
+  private:
+    IndexRegistry() = default;
+
+    std::map<std::string, Fn*> m_functions;
+};
+
+/// Registers a function when constructed, typically as a static object.
+template <typename Fn>
+struct IndexRegistration {
+    IndexRegistration(std::string const& key, Fn* fn) { IndexRegistry<Fn>::instance().add(key, fn); }
+};
+
+/// Key of a function instantiated for an index encoding and a type of WAND data.
+inline auto index_registry_key(std::string const& encoding, std::string const& wand_type)
+    -> std::string
+{
+    return fmt::format("{}/{}", encoding, wand_type);
+}
+
+}  // namespace pisa
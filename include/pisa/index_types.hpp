@@ -12,11 +12,14 @@
 #include "codec/simple8b.hpp"
 #include "codec/streamvbyte.hpp"
 #include "codec/varintgb.hpp"
+#include "codec/widebp.hpp"
 
 #include "binary_freq_collection.hpp"
 #include "block_freq_index.hpp"
 
 #include "freq_index.hpp"
+#include "hybrid_freq_index.hpp"
+#include "impact_ordered_index.hpp"
 #include "sequence/partitioned_sequence.hpp"
 #include "sequence/positive_sequence.hpp"
 #include "sequence/uniform_partitioned_sequence.hpp"
@@ -42,13 +45,39 @@ using block_qmx_index = block_freq_index<pisa::qmx_block>;
 using block_simple8b_index = block_freq_index<pisa::simple8b_block>;
 using block_simple16_index = block_freq_index<pisa::simple16_block>;
 using block_simdbp_index = block_freq_index<pisa::simdbp_block>;
+using block_widebp256_index = block_freq_index<pisa::widebp256_block>;
+using block_widebp512_index = block_freq_index<pisa::widebp512_block>;
+
+using hybrid_optpfor_index = hybrid_freq_index<pisa::optpfor_block>;
+using hybrid_simdbp_index = hybrid_freq_index<pisa::simdbp_block>;
+
+using block_optpfor_impact_index = impact_ordered_index<pisa::optpfor_block>;
+using block_varintg8iu_impact_index = impact_ordered_index<pisa::varint_G8IU_block>;
+using block_streamvbyte_impact_index = impact_ordered_index<pisa::streamvbyte_block>;
+using block_maskedvbyte_impact_index = impact_ordered_index<pisa::maskedvbyte_block>;
+using block_varintgb_impact_index = impact_ordered_index<pisa::varintgb_block>;
+using block_interpolative_impact_index = impact_ordered_index<pisa::interpolative_block>;
+using block_qmx_impact_index = impact_ordered_index<pisa::qmx_block>;
+using block_simple8b_impact_index = impact_ordered_index<pisa::simple8b_block>;
+using block_simple16_impact_index = impact_ordered_index<pisa::simple16_block>;
+using block_simdbp_impact_index = impact_ordered_index<pisa::simdbp_block>;
+using block_widebp256_impact_index = impact_ordered_index<pisa::widebp256_block>;
+using block_widebp512_impact_index = impact_ordered_index<pisa::widebp512_block>;
 
 }  // namespace pisa
 
+// Index types the tools are compiled for, unless restricted by the `PISA_INDEX_ENCODINGS` build
+// option, which defines these macros itself.
+#ifndef PISA_INDEX_TYPES
 #define PISA_INDEX_TYPES                                                                    \
     (ef)(single)(pefuniform)(pefopt)(block_optpfor)(block_varintg8iu)(block_streamvbyte)(   \
         block_maskedvbyte)(block_interpolative)(block_qmx)(block_varintgb)(block_simple8b)( \
-        block_simple16)(block_simdbp)
+        block_simple16)(block_simdbp)(block_widebp256)(block_widebp512)(hybrid_optpfor)(    \
+        hybrid_simdbp)
+#endif
+#ifndef PISA_BLOCK_INDEX_TYPES
 #define PISA_BLOCK_INDEX_TYPES                                                                    \
     (block_optpfor)(block_varintg8iu)(block_streamvbyte)(block_maskedvbyte)(block_interpolative)( \
-        block_qmx)(block_varintgb)(block_simple8b)(block_simple16)(block_simdbp)
+        block_qmx)(block_varintgb)(block_simple8b)(block_simple16)(block_simdbp)(                 \
+        block_widebp256)(block_widebp512)
+#endif
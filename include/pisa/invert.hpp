@@ -5,11 +5,12 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <numeric>
 #include <optional>
 #include <sstream>
 #include <thread>
-#include <unordered_map>
+#include <utility>
 
 #include "boost/filesystem.hpp"
 #include "gsl/span"
@@ -20,30 +21,16 @@
 #include "range/v3/view/iota.hpp"
 #include "spdlog/spdlog.h"
 #include "tbb/concurrent_queue.h"
+#include "tbb/parallel_for.h"
 #include "tbb/task_group.h"
 #include "type_safe.hpp"
 
 #include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
 #include "util/util.hpp"
 
 namespace pisa {
 
-template <typename T>
-std::vector<T> concatenate(std::vector<std::vector<T>> const& containers)
-{
-    auto full_size = std::accumulate(
-        containers.begin(), containers.end(), 0, [](auto const& acc, auto const& container) {
-            return acc + container.size();
-        });
-    std::vector<T> vec(full_size);
-    auto next_begin = std::begin(vec);
-    for (auto const& container: containers) {
-        std::copy(container.begin(), container.end(), next_begin);
-        next_begin = std::next(next_begin, container.size());
-    }
-    return vec;
-}
-
 template <typename T>
 std::ostream& write_sequence(std::ostream& os, gsl::span<T> sequence)
 {
@@ -66,302 +53,506 @@ std::istream& read_sequence(std::istream& is, std::vector<T>& out)
 
 namespace invert {
 
-    struct Batch {
-        gsl::span<gsl::span<Term_Id const>> documents;
-        ranges::iota_view<Document_Id, Document_Id> document_ids;
-    };
-
-    std::vector<std::pair<Term_Id, Document_Id>> map_to_postings(Batch batch)
-    {
-        auto docid = batch.document_ids.begin();
-        std::vector<std::pair<Term_Id, Document_Id>> postings;
-        for (auto const& document: batch.documents) {
-            for (auto const& term: document) {
-                postings.emplace_back(term, *docid);
-            }
-            ++docid;
-        }
-        return postings;
-    }
-
-    void join_term(
-        std::vector<Document_Id>& lower_doc,
-        std::vector<Frequency>& lower_freq,
-        std::vector<Document_Id>& higher_doc,
-        std::vector<Frequency>& higher_freq)
-    {
-        if (lower_doc.back() == higher_doc.front()) {
-            lower_freq.back() += higher_freq.front();
-            lower_doc.insert(lower_doc.end(), std::next(higher_doc.begin()), higher_doc.end());
-            lower_freq.insert(lower_freq.end(), std::next(higher_freq.begin()), higher_freq.end());
-        } else {
-            lower_doc.insert(lower_doc.end(), higher_doc.begin(), higher_doc.end());
-            lower_freq.insert(lower_freq.end(), higher_freq.begin(), higher_freq.end());
-        }
-    }
-
-    template <typename Iterator>
-    struct Inverted_Index {
-        using iterator_type = Iterator;
-        std::unordered_map<Term_Id, std::vector<Document_Id>> documents{};
-        std::unordered_map<Term_Id, std::vector<Frequency>> frequencies{};
+    /// Posting lists of a range of documents, stored next to each other in term order.
+    struct Posting_Lists {
+        /// Position of the posting list of each term in `documents` and `frequencies`, followed
+        /// by the number of postings.
+        std::vector<std::size_t> offsets{0};
+        std::vector<Document_Id> documents{};
+        std::vector<Frequency> frequencies{};
         std::vector<std::uint32_t> document_sizes{};
 
-        Inverted_Index() = default;
-        Inverted_Index(Inverted_Index&, tbb::split) {}
-        Inverted_Index(
-            std::unordered_map<Term_Id, std::vector<Document_Id>> documents,
-            std::unordered_map<Term_Id, std::vector<Frequency>> frequencies,
-            std::vector<std::uint32_t> document_sizes = {})
-            : documents(std::move(documents)),
-              frequencies(std::move(frequencies)),
-              document_sizes(std::move(document_sizes))
-        {}
-
-        void operator()(tbb::blocked_range<iterator_type> const& r)
+        [[nodiscard]] auto term_count() const -> std::size_t { return offsets.size() - 1; }
+
+        [[nodiscard]] auto documents_of(Term_Id term) const -> gsl::span<Document_Id const>
         {
-            if (auto first = r.begin(); first != r.end()) {
-                if (auto current_term = first->first; not documents[current_term].empty()) {
-                    auto current_doc = documents[current_term].back();
-                    auto& freq = frequencies[current_term].back();
-                    auto last = std::find_if(first, r.end(), [&](auto const& posting) {
-                        return posting.first != current_term || posting.second != current_doc;
-                    });
-                    freq += Frequency(std::distance(first, last));
-                    first = last;
-                }
-                while (first != r.end()) {
-                    auto [current_term, current_doc] = *first;
-                    auto last = std::find_if(
-                        first,
-                        r.end(),
-                        [&, current_term = current_term, current_doc = current_doc](
-                            auto const& posting) {
-                            return posting.first != current_term || posting.second != current_doc;
-                        });
-                    auto freq = Frequency(std::distance(first, last));
-                    documents[current_term].push_back(current_doc);
-                    frequencies[current_term].push_back(freq);
-                    first = last;
-                }
-            }
+            auto t = static_cast<std::size_t>(term);
+            return gsl::make_span(documents).subspan(offsets[t], offsets[t + 1] - offsets[t]);
         }
 
-        void join(Inverted_Index& rhs)
+        [[nodiscard]] auto frequencies_of(Term_Id term) const -> gsl::span<Frequency const>
         {
-            document_sizes.insert(
-                document_sizes.end(), rhs.document_sizes.begin(), rhs.document_sizes.end());
-            for (auto&& [term_id, document_ids]: rhs.documents) {
-                if (auto pos = documents.find(term_id); pos == documents.end()) {
-                    std::swap(documents[term_id], document_ids);
-                    std::swap(frequencies[term_id], rhs.frequencies[term_id]);
-                } else if (pos->second.back() <= document_ids.front()) {
-                    join_term(
-                        pos->second, frequencies[term_id], document_ids, rhs.frequencies[term_id]);
-                } else {
-                    join_term(
-                        document_ids, rhs.frequencies[term_id], pos->second, frequencies[term_id]);
-                    std::swap(documents[term_id], document_ids);
-                    std::swap(frequencies[term_id], rhs.frequencies[term_id]);
-                }
-            }
+            auto t = static_cast<std::size_t>(term);
+            return gsl::make_span(frequencies).subspan(offsets[t], offsets[t + 1] - offsets[t]);
         }
     };
 
-    template <typename Iterator>
-    void write(
-        std::string const& basename,
-        invert::Inverted_Index<Iterator> const& index,
-        std::uint32_t term_count)
+    /// Calls `fn(term, frequency)` for each distinct term of `document` in increasing order,
+    /// sorting its terms in `buffer`.
+    template <typename Fn>
+    void for_each_term(gsl::span<Term_Id const> document, std::vector<Term_Id>& buffer, Fn fn)
+    {
+        buffer.assign(document.begin(), document.end());
+        std::sort(buffer.begin(), buffer.end());
+        for (auto first = buffer.begin(); first != buffer.end();) {
+            auto last = std::find_if(
+                std::next(first), buffer.end(), [&](auto term) { return term != *first; });
+            fn(*first, Frequency(std::distance(first, last)));
+            first = last;
+        }
+    }
+
+    void write(std::string const& basename, Posting_Lists const& lists)
     {
         std::ofstream dstream(basename + ".docs");
         std::ofstream fstream(basename + ".freqs");
         std::ofstream sstream(basename + ".sizes");
-        std::uint32_t count = index.document_sizes.size();
+        std::uint32_t count = lists.document_sizes.size();
         write_sequence(dstream, gsl::make_span<uint32_t const>(&count, 1));
-        for (auto term: ranges::views::iota(Term_Id(0), Term_Id(term_count))) {
-            if (auto pos = index.documents.find(term); pos != index.documents.end()) {
-                auto const& documents = pos->second;
-                auto const& frequencies = index.frequencies.at(term);
-                write_sequence(dstream, gsl::span<Document_Id const>(documents));
-                write_sequence(fstream, gsl::span<Frequency const>(frequencies));
-            } else {
-                write_sequence(dstream, gsl::span<Document_Id const>());
-                write_sequence(fstream, gsl::span<Frequency const>());
-            }
+        for (auto term: ranges::views::iota(Term_Id(0), Term_Id(lists.term_count()))) {
+            write_sequence(dstream, lists.documents_of(term));
+            write_sequence(fstream, lists.frequencies_of(term));
         }
-        write_sequence(sstream, gsl::span<uint32_t const>(index.document_sizes));
+        write_sequence(sstream, gsl::span<uint32_t const>(lists.document_sizes));
     }
 
+    /// Inverts `documents`, numbered from `first_document_id`, into the posting lists of terms
+    /// `[0, term_count)`.
+    ///
+    /// The documents are split into at most `threads` chunks of consecutive documents. The
+    /// postings of each term in each chunk are first counted, which gives where each chunk starts
+    /// in each posting list, and then written there in document order. Postings are thus neither
+    /// sorted nor stored in hash maps: besides the posting lists themselves, inverting takes 4
+    /// bytes per term and chunk. Chunks are added only while their counts are fewer than the term
+    /// occurrences of the documents, so that with many terms and few documents, the counts take
+    /// at most 4 bytes per occurrence besides those of the first chunk.
     auto invert_range(
-        gsl::span<gsl::span<Term_Id const>> documents, Document_Id first_document_id, size_t threads)
+        gsl::span<gsl::span<Term_Id const>> documents,
+        Document_Id first_document_id,
+        std::size_t term_count,
+        size_t threads) -> Posting_Lists
     {
-        std::vector<uint32_t> document_sizes(documents.size());
+        Posting_Lists lists;
+        lists.document_sizes.resize(documents.size());
         std::transform(
             pstl::execution::par_unseq,
             documents.begin(),
             documents.end(),
-            document_sizes.begin(),
+            lists.document_sizes.begin(),
             [](auto const& terms) { return terms.size(); });
-        gsl::index batch_size = (documents.size() + threads - 1) / threads;
-        std::vector<Batch> batches;
-        for (gsl::index first_idx_in_batch = 0; first_idx_in_batch < documents.size();
-             first_idx_in_batch += batch_size) {
-            auto last_idx_in_batch = std::min(first_idx_in_batch + batch_size, documents.size());
-            auto first_document_in_batch = first_document_id + first_idx_in_batch;
-            auto last_document_in_batch = first_document_id + last_idx_in_batch;
-            auto current_batch_size = last_idx_in_batch - first_idx_in_batch;
-            batches.push_back(Batch{
-                documents.subspan(first_idx_in_batch, current_batch_size),
-                ranges::views::iota(first_document_in_batch, last_document_in_batch)});
+
+        auto occurrences = std::accumulate(
+            lists.document_sizes.begin(), lists.document_sizes.end(), std::size_t(0));
+        auto max_chunks = occurrences / std::max<std::size_t>(term_count, 1);
+        threads = std::clamp<std::size_t>(threads, 1, std::max<std::size_t>(max_chunks, 1));
+        std::size_t chunk_size = (documents.size() + threads - 1) / threads;
+        std::size_t chunk_count =
+            chunk_size > 0 ? (documents.size() + chunk_size - 1) / chunk_size : 0;
+        auto chunk = [&](std::size_t c) {
+            auto first = c * chunk_size;
+            return documents.subspan(first, std::min(chunk_size, documents.size() - first));
+        };
+
+        // Postings of each term in each chunk, then position of each chunk in each posting list.
+        std::vector<std::vector<std::uint32_t>> positions(chunk_count);
+        tbb::parallel_for(std::size_t(0), chunk_count, [&](auto c) {
+            auto& counts = positions[c];
+            counts.resize(term_count, 0);
+            std::vector<Term_Id> buffer;
+            for (auto document: chunk(c)) {
+                for_each_term(document, buffer, [&](auto term, auto) {
+                    if (static_cast<std::size_t>(term) >= term_count) {
+                        throw std::invalid_argument(fmt::format(
+                            "Term {} out of range, there are {} terms", term.as_int(), term_count));
+                    }
+                    counts[static_cast<std::size_t>(term)] += 1;
+                });
+            }
+        });
+
+        lists.offsets.resize(term_count + 1);
+        tbb::parallel_for(tbb::blocked_range<std::size_t>(0, term_count), [&](auto const& terms) {
+            for (auto term = terms.begin(); term != terms.end(); ++term) {
+                std::uint32_t position = 0;
+                for (auto& counts: positions) {
+                    position += std::exchange(counts[term], position);
+                }
+                lists.offsets[term + 1] = position;
+            }
+        });
+        std::partial_sum(lists.offsets.begin(), lists.offsets.end(), lists.offsets.begin());
+
+        lists.documents.resize(lists.offsets.back());
+        lists.frequencies.resize(lists.offsets.back());
+        tbb::parallel_for(std::size_t(0), chunk_count, [&](auto c) {
+            auto& next = positions[c];
+            auto docid = first_document_id + Document_Id(c * chunk_size);
+            std::vector<Term_Id> buffer;
+            for (auto document: chunk(c)) {
+                for_each_term(document, buffer, [&](auto term, auto freq) {
+                    auto t = static_cast<std::size_t>(term);
+                    auto pos = lists.offsets[t] + next[t]++;
+                    lists.documents[pos] = docid;
+                    lists.frequencies[pos] = freq;
+                });
+                ++docid;
+            }
+        });
+        return lists;
+    }
+
+    /// Number of terms by which the locations of posting lists in batch files are recorded.
+    constexpr std::size_t batch_block_terms = 1024;
+
+    /// Postings merged at a time per thread, when no memory budget is given.
+    constexpr std::size_t default_merge_range_postings = std::size_t(1) << 22U;
+
+    /// Posting lists of a batch of documents written to disk by `write`.
+    struct Batch_File {
+        std::string basename;
+        /// Number of postings preceding every `block_terms`-th term, followed by the number of
+        /// postings.
+        std::vector<std::size_t> block_offsets;
+    };
+
+    [[nodiscard]] auto batch_file(
+        std::string basename,
+        Posting_Lists const& lists,
+        std::size_t block_terms = batch_block_terms) -> Batch_File
+    {
+        auto block_count = (lists.term_count() + block_terms - 1) / block_terms;
+        std::vector<std::size_t> block_offsets(block_count + 1);
+        for (std::size_t block = 0; block < block_count; ++block) {
+            block_offsets[block] = lists.offsets[block * block_terms];
         }
-        std::vector<std::vector<std::pair<Term_Id, Document_Id>>> posting_vectors(batches.size());
-        std::transform(
-            pstl::execution::par_unseq,
-            batches.begin(),
-            batches.end(),
-            std::begin(posting_vectors),
-            map_to_postings);
-        auto postings = concatenate(posting_vectors);
-        posting_vectors.clear();
-        posting_vectors.shrink_to_fit();
-
-        std::sort(pstl::execution::par_unseq, postings.begin(), postings.end());
-
-        using iterator_type = decltype(postings.begin());
-        invert::Inverted_Index<iterator_type> index;
-        tbb::parallel_reduce(tbb::blocked_range(postings.begin(), postings.end()), index);
-        index.document_sizes = std::move(document_sizes);
-        return index;
+        block_offsets.back() = lists.offsets.back();
+        return Batch_File{std::move(basename), std::move(block_offsets)};
     }
 
+    /// Memory taken by the offsets of `invert_range` and the counts of its first chunk, besides
+    /// the posting lists and the counts of other chunks, which take at most 4 bytes per occurrence.
+    [[nodiscard]] auto inversion_overhead(std::size_t term_count) -> std::size_t
+    {
+        return term_count * (sizeof(std::uint32_t) + sizeof(std::size_t));
+    }
+
+    /// Inverts the documents of `input_basename` in batches of at most `batch_size` documents
+    /// and `batch_occurrences` term occurrences, writing each batch to disk while the next one
+    /// is inverted.
     [[nodiscard]] auto build_batches(
         std::string const& input_basename,
         std::string const& output_basename,
         uint32_t term_count,
         size_t batch_size,
-        size_t threads) -> uint32_t
+        size_t threads,
+        size_t batch_occurrences = std::numeric_limits<size_t>::max()) -> std::vector<Batch_File>
     {
-        uint32_t batch = 0;
+        std::vector<Batch_File> batches;
         binary_collection coll(input_basename.c_str());
         auto doc_iter = ++coll.begin();
         uint32_t documents_processed = 0;
+        Posting_Lists written;
+        tbb::task_group writer;
         while (doc_iter != coll.end()) {
             std::vector<gsl::span<Term_Id const>> documents;
+            std::size_t occurrences = 0;
             for (; doc_iter != coll.end() && documents.size() < batch_size; ++doc_iter) {
                 auto document_sequence = *doc_iter;
+                if (not documents.empty()
+                    && occurrences + document_sequence.size() > batch_occurrences) {
+                    break;
+                }
                 documents.emplace_back(
                     reinterpret_cast<Term_Id const*>(document_sequence.begin()),
                     document_sequence.size());
+                occurrences += document_sequence.size();
             }
             spdlog::info(
                 "Inverting [{}, {})", documents_processed, documents_processed + documents.size());
-            auto index = invert_range(documents, Document_Id(documents_processed), threads);
-            write(fmt::format("{}.batch.{}", output_basename, batch), index, term_count);
+            auto lists = invert_range(
+                documents, Document_Id(documents_processed), term_count, threads);
+            writer.wait();
+            batches.push_back(
+                batch_file(fmt::format("{}.batch.{}", output_basename, batches.size()), lists));
+            written = std::move(lists);
+            writer.run([&, basename = batches.back().basename] { write(basename, written); });
             documents_processed += documents.size();
-            batch += 1;
         }
-        return batch;
+        writer.wait();
+        return batches;
     }
 
-    void merge_batches(std::string const& output_basename, uint32_t batch_count, uint32_t term_count)
+    /// Concatenated posting lists of a range of terms from all batches, each preceded by its
+    /// length as in the output files.
+    struct Merged_Range {
+        std::vector<uint32_t> documents;
+        std::vector<uint32_t> frequencies;
+        std::size_t postings = 0;
+
+        /// The posting lists of the range, in term order.
+        [[nodiscard]] auto sequences() const -> std::vector<binary_freq_collection::sequence>
+        {
+            std::vector<binary_freq_collection::sequence> sequences;
+            for (std::size_t pos = 0; pos < documents.size(); pos += documents[pos] + 1) {
+                auto const* docs = documents.data() + pos + 1;
+                auto const* freqs = frequencies.data() + pos + 1;
+                sequences.push_back(binary_freq_collection::sequence{
+                    {docs, docs + documents[pos]}, {freqs, freqs + documents[pos]}});
+            }
+            return sequences;
+        }
+    };
+
+    /// Reads the sizes of the documents of `batches`, in order.
+    [[nodiscard]] auto read_document_sizes(std::vector<Batch_File> const& batches)
+        -> std::vector<uint32_t>
     {
-        std::vector<binary_collection> doc_collections;
-        std::vector<binary_collection> freq_collections;
         std::vector<uint32_t> document_sizes;
-        for (auto batch: ranges::views::iota(uint32_t(0), batch_count)) {
-            std::ostringstream batch_name_stream;
-            batch_name_stream << output_basename << ".batch." << batch;
-            doc_collections.emplace_back((batch_name_stream.str() + ".docs").c_str());
-            freq_collections.emplace_back((batch_name_stream.str() + ".freqs").c_str());
-            std::ifstream sizes_is(batch_name_stream.str() + ".sizes");
+        for (auto const& batch: batches) {
+            std::ifstream sizes_is(batch.basename + ".sizes");
             read_sequence(sizes_is, document_sizes);
         }
+        return document_sizes;
+    }
+
+    /// Merges the posting lists of `batches`, of consecutive documents, and passes them to
+    /// `consume(Merged_Range const&)` in term order.
+    ///
+    /// Terms are split into ranges of blocks of `block_terms` terms, holding about
+    /// `range_postings` postings unless a single block holds more. `threads` ranges are merged
+    /// concurrently, each into its own buffer, while the previous ones are consumed.
+    ///
+    /// \throws std::runtime_error  if a posting list is empty
+    template <typename Consume>
+    void merge_posting_lists(
+        std::vector<Batch_File> const& batches,
+        uint32_t term_count,
+        std::size_t range_postings,
+        std::size_t threads,
+        Consume consume,
+        std::size_t block_terms = batch_block_terms)
+    {
+        struct Batch_Source {
+            MemorySource documents;
+            MemorySource frequencies;
+            std::vector<std::size_t> const* block_offsets;
+        };
+        std::vector<Batch_Source> sources;
+        for (auto const& batch: batches) {
+            if (batch.block_offsets.back() > 0) {
+                MapOptions options;
+                options.advice = MapAdvice::Sequential;
+                sources.push_back(Batch_Source{
+                    MemorySource::mapped_file(batch.basename + ".docs", options),
+                    MemorySource::mapped_file(batch.basename + ".freqs", options),
+                    &batch.block_offsets});
+            }
+        }
 
+        auto block_count = (term_count + block_terms - 1) / block_terms;
+        std::vector<std::size_t> block_ranges{0};
+        std::size_t postings_in_range = 0;
+        for (std::size_t block = 0; block < block_count; ++block) {
+            std::size_t block_postings = 0;
+            for (auto const& source: sources) {
+                auto const& offsets = *source.block_offsets;
+                block_postings += offsets[block + 1] - offsets[block];
+            }
+            if (block > block_ranges.back()
+                && postings_in_range + block_postings > range_postings) {
+                block_ranges.push_back(block);
+                postings_in_range = 0;
+            }
+            postings_in_range += block_postings;
+        }
+        block_ranges.push_back(block_count);
+        auto range_count = block_ranges.size() - 1;
+        spdlog::info("Merging {} batches in {} term ranges", batches.size(), range_count);
+
+        auto merge_range = [&](std::size_t range) {
+            auto first_block = block_ranges[range];
+            auto first_term = first_block * block_terms;
+            auto last_term =
+                std::min<std::size_t>(block_ranges[range + 1] * block_terms, term_count);
+            std::vector<uint32_t const*> documents;
+            std::vector<uint32_t const*> frequencies;
+            Merged_Range merged;
+            for (auto const& source: sources) {
+                auto const& offsets = *source.block_offsets;
+                auto preceding = first_term + offsets[first_block];
+                documents.push_back(
+                    reinterpret_cast<uint32_t const*>(source.documents.data()) + 2 + preceding);
+                frequencies.push_back(
+                    reinterpret_cast<uint32_t const*>(source.frequencies.data()) + preceding);
+                merged.postings += offsets[block_ranges[range + 1]] - offsets[first_block];
+            }
+            merged.documents.reserve(merged.postings + last_term - first_term);
+            merged.frequencies.reserve(merged.postings + last_term - first_term);
+            for (auto term_id = first_term; term_id < last_term; ++term_id) {
+                auto dlength = merged.documents.size();
+                auto flength = merged.frequencies.size();
+                merged.documents.push_back(0);
+                merged.frequencies.push_back(0);
+                for (std::size_t batch = 0; batch < sources.size(); ++batch) {
+                    auto dsize = *documents[batch]++;
+                    auto fsize = *frequencies[batch]++;
+                    merged.documents.insert(
+                        merged.documents.end(), documents[batch], documents[batch] + dsize);
+                    merged.frequencies.insert(
+                        merged.frequencies.end(), frequencies[batch], frequencies[batch] + fsize);
+                    documents[batch] += dsize;
+                    frequencies[batch] += fsize;
+                }
+                merged.documents[dlength] = merged.documents.size() - dlength - 1;
+                merged.frequencies[flength] = merged.frequencies.size() - flength - 1;
+                if (merged.documents[dlength] != merged.frequencies[flength]) {
+                    auto msg = fmt::format(
+                        "Document and frequency lists must be equal length"
+                        "but are {} and {} (term {})",
+                        merged.documents[dlength],
+                        merged.frequencies[flength],
+                        term_id);
+                    spdlog::error(msg);
+                    throw std::runtime_error(msg);
+                }
+                if (merged.documents[dlength] == 0) {
+                    auto msg = fmt::format("Posting list must be non-empty (term {})", term_id);
+                    spdlog::error(msg);
+                    throw std::runtime_error(msg);
+                }
+            }
+            return merged;
+        };
+
+        auto consume_ranges = [&](std::vector<Merged_Range> const& ranges) {
+            for (auto const& merged: ranges) {
+                consume(merged);
+            }
+        };
+        threads = std::max<std::size_t>(threads, 1);
+        std::vector<Merged_Range> consumed;
+        for (std::size_t first_range = 0; first_range < range_count; first_range += threads) {
+            std::vector<Merged_Range> merged(std::min(threads, range_count - first_range));
+            tbb::task_group group;
+            group.run([&] { consume_ranges(consumed); });
+            tbb::parallel_for(std::size_t(0), merged.size(), [&](std::size_t idx) {
+                merged[idx] = merge_range(first_range + idx);
+            });
+            group.wait();
+            consumed = std::move(merged);
+        }
+        consume_ranges(consumed);
+    }
+
+    /// Merges the posting lists of `batches` into `output_basename`, as `merge_posting_lists`
+    /// does, writing each range of terms with one write per file.
+    void merge_batches(
+        std::string const& output_basename,
+        std::vector<Batch_File> const& batches,
+        uint32_t term_count,
+        std::size_t range_postings,
+        std::size_t threads,
+        std::size_t block_terms = batch_block_terms)
+    {
+        auto document_sizes = read_document_sizes(batches);
         std::ofstream sos(output_basename + ".sizes");
         write_sequence(sos, gsl::span<uint32_t const>(document_sizes));
 
-        std::vector<binary_collection::const_iterator> doc_iterators;
-        std::vector<binary_collection::const_iterator> freq_iterators;
-        std::transform(
-            doc_collections.begin(),
-            doc_collections.end(),
-            std::back_inserter(doc_iterators),
-            [](auto const& coll) { return ++coll.begin(); });
-        std::transform(
-            freq_collections.begin(),
-            freq_collections.end(),
-            std::back_inserter(freq_iterators),
-            [](auto const& coll) { return coll.begin(); });
-
         std::ofstream dos(output_basename + ".docs");
         std::ofstream fos(output_basename + ".freqs");
         auto document_count = static_cast<uint32_t>(document_sizes.size());
         write_sequence(dos, gsl::make_span<uint32_t const>(&document_count, 1));
         size_t postings_count = 0;
-        for (auto term_id: ranges::views::iota(uint32_t(0), term_count)) {
-            std::vector<uint32_t> dlist;
-            for (auto& iter: doc_iterators) {
-                auto seq = *iter;
-                dlist.insert(dlist.end(), seq.begin(), seq.end());
-                ++iter;
-            }
-            std::vector<uint32_t> flist;
-            for (auto& iter: freq_iterators) {
-                auto seq = *iter;
-                flist.insert(flist.end(), seq.begin(), seq.end());
-                ++iter;
-            }
-            if (dlist.size() != flist.size()) {
-                auto msg = fmt::format(
-                    "Document and frequency lists must be equal length"
-                    "but are {} and {} (term {})",
-                    dlist.size(),
-                    flist.size(),
-                    term_id);
-                spdlog::error(msg);
-                throw std::runtime_error(msg);
-            }
-            if (dlist.empty()) {
-                auto msg = fmt::format("Posting list must be non-empty (term {})", term_id);
-                spdlog::error(msg);
-                throw std::runtime_error(msg);
-            }
-            postings_count += dlist.size();
-            write_sequence(dos, gsl::span<uint32_t const>(dlist));
-            write_sequence(fos, gsl::span<uint32_t const>(flist));
-        }
+        merge_posting_lists(
+            batches,
+            term_count,
+            range_postings,
+            threads,
+            [&](Merged_Range const& merged) {
+                dos.write(
+                    reinterpret_cast<char const*>(merged.documents.data()),
+                    merged.documents.size() * sizeof(uint32_t));
+                fos.write(
+                    reinterpret_cast<char const*>(merged.frequencies.data()),
+                    merged.frequencies.size() * sizeof(uint32_t));
+                postings_count += merged.postings;
+            },
+            block_terms);
 
         spdlog::info("Number of terms: {}", term_count);
         spdlog::info("Number of documents: {}", document_count);
         spdlog::info("Number of postings: {}", postings_count);
     }
 
+    /// Sizes of batches and merged ranges of terms fitting in a memory budget.
+    struct Memory_Limits {
+        std::size_t batch_occurrences = std::numeric_limits<std::size_t>::max();
+        std::size_t range_postings = default_merge_range_postings;
+    };
+
+    /// With a `memory_budget` in bytes, batches are made small enough that the one being
+    /// written and the one being inverted each fit in half of it, and posting lists are merged
+    /// in ranges small enough that those being merged and consumed fit in it.
+    ///
+    /// \throws std::invalid_argument  if `memory_budget` cannot hold the counts of a batch
+    [[nodiscard]] auto memory_limits(
+        std::uint32_t term_count, std::size_t threads, std::optional<std::size_t> memory_budget)
+        -> Memory_Limits
+    {
+        Memory_Limits limits;
+        if (memory_budget) {
+            auto overhead = inversion_overhead(term_count);
+            if (*memory_budget / 2 <= overhead) {
+                throw std::invalid_argument(fmt::format(
+                    "Memory budget of {} bytes too small to invert {} terms, "
+                    "which takes more than {} bytes",
+                    *memory_budget,
+                    term_count,
+                    2 * overhead));
+            }
+            // Postings take 8 bytes and the counts of chunks but the first at most 4, and there
+            // are at most as many postings as term occurrences.
+            limits.batch_occurrences = (*memory_budget / 2 - overhead) / 12;
+            limits.range_postings = std::max<std::size_t>(*memory_budget / (16 * threads), 1);
+        }
+        return limits;
+    }
+
+    /// Number of terms of the forward index `input_basename`, read from its lexicon unless given.
+    [[nodiscard]] auto forward_index_term_count(
+        std::string const& input_basename, std::optional<std::uint32_t> term_count)
+        -> std::uint32_t
+    {
+        if (term_count) {
+            return *term_count;
+        }
+        auto source = MemorySource::mapped_file(fmt::format("{}.termlex", input_basename));
+        return static_cast<std::uint32_t>(Payload_Vector<>::from(source).size());
+    }
+
+    void remove_batches(std::vector<Batch_File> const& batches)
+    {
+        for (auto const& batch: batches) {
+            boost::filesystem::remove(boost::filesystem::path{batch.basename + ".docs"});
+            boost::filesystem::remove(boost::filesystem::path{batch.basename + ".freqs"});
+            boost::filesystem::remove(boost::filesystem::path{batch.basename + ".sizes"});
+        }
+    }
+
+    /// Inverts the forward index `input_basename` into `output_basename`, within
+    /// `memory_budget` bytes if given (see `memory_limits`).
+    ///
+    /// \throws std::invalid_argument  if `memory_budget` cannot hold the counts of a batch
     void invert_forward_index(
         std::string const& input_basename,
         std::string const& output_basename,
         size_t batch_size,
         size_t threads,
-        std::optional<std::uint32_t> term_count = std::nullopt)
+        std::optional<std::uint32_t> term_count = std::nullopt,
+        std::optional<std::size_t> memory_budget = std::nullopt)
     {
-        if (not term_count) {
-            auto source = MemorySource::mapped_file(fmt::format("{}.termlex", input_basename));
-            auto terms = Payload_Vector<>::from(source);
-            term_count = static_cast<std::uint32_t>(terms.size());
-        }
-
-        uint32_t batch_count =
-            invert::build_batches(input_basename, output_basename, *term_count, batch_size, threads);
-        invert::merge_batches(output_basename, batch_count, *term_count);
-
-        for (auto batch: ranges::views::iota(uint32_t(0), batch_count)) {
-            std::ostringstream batch_name_stream;
-            batch_name_stream << output_basename << ".batch." << batch;
-            auto batch_basename = batch_name_stream.str();
-            boost::filesystem::remove(boost::filesystem::path{batch_basename + ".docs"});
-            boost::filesystem::remove(boost::filesystem::path{batch_basename + ".freqs"});
-            boost::filesystem::remove(boost::filesystem::path{batch_basename + ".sizes"});
-        }
+        term_count = forward_index_term_count(input_basename, term_count);
+        auto limits = memory_limits(*term_count, threads, memory_budget);
+        auto batches = invert::build_batches(
+            input_basename,
+            output_basename,
+            *term_count,
+            batch_size,
+            threads,
+            limits.batch_occurrences);
+        invert::merge_batches(
+            output_basename, batches, *term_count, limits.range_postings, threads);
+        remove_batches(batches);
     }
 
 }  // namespace invert
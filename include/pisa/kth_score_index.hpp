@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include "mappable/mappable_vector.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+/// Stores the k-th highest scores of every single-term query and of a selected set of
+/// term pairs, for a few values of k, used to estimate a safe initial top-k threshold
+/// of a query at query time.
+///
+/// With non-negative term scores, the k-th score of any subset of the query terms
+/// is a lower bound of the k-th score of the query, and so is the k-th score for
+/// a larger k. Thus, the threshold of a query can be estimated with any of these scores
+/// as long as they were computed with at least the same `k`.
+///
+/// Pairs are stored in an open-addressing hash table with linear probing, so that
+/// a lookup touches a single cache line in most cases.
+class KthScoreIndex {
+  public:
+    using term_pair = std::pair<term_id_type, term_id_type>;
+
+    KthScoreIndex() = default;
+    explicit KthScoreIndex(MemorySource source) : m_source(std::move(source))
+    {
+        mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
+    }
+
+    /// Builds the index for the values in `ks`, given in increasing order.
+    ///
+    /// `term_scores[term * ks.size() + i]` is the `ks[i]`-th score of `term`, and each
+    /// pair is given with its scores in the same order. Scores of queries with fewer
+    /// results than the respective k must be 0.
+    KthScoreIndex(
+        std::vector<std::uint64_t> ks,
+        std::vector<float> term_scores,
+        std::vector<std::pair<term_pair, std::vector<float>>> const& pair_scores)
+    {
+        if (ks.empty() || not std::is_sorted(ks.begin(), ks.end())) {
+            throw std::invalid_argument("Values of k must be non-empty and sorted");
+        }
+        if (term_scores.size() % ks.size() != 0) {
+            throw std::invalid_argument("Number of term scores is not a multiple of the ks");
+        }
+        std::uint64_t bits = 0;
+        while ((std::uint64_t(1) << bits) < pair_scores.size() + pair_scores.size() / 2 + 1) {
+            ++bits;
+        }
+        std::size_t num_slots = std::size_t(1) << bits;
+        std::vector<std::uint64_t> keys(num_slots, empty_key);
+        std::vector<float> scores(num_slots * ks.size(), 0.0F);
+        for (auto const& [terms, pair_ks]: pair_scores) {
+            if (pair_ks.size() != ks.size()) {
+                throw std::invalid_argument("Number of pair scores is different from the ks");
+            }
+            auto key = pair_key(terms.first, terms.second);
+            if (key == empty_key) {
+                continue;
+            }
+            auto slot = hash(key, bits);
+            while (keys[slot] != empty_key && keys[slot] != key) {
+                slot = (slot + 1) & (num_slots - 1);
+            }
+            keys[slot] = key;
+            std::copy(pair_ks.begin(), pair_ks.end(), std::next(scores.begin(), slot * ks.size()));
+        }
+        m_bits = bits;
+        m_num_pairs =
+            std::count_if(keys.begin(), keys.end(), [](auto key) { return key != empty_key; });
+        m_ks.steal(ks);
+        m_term_scores.steal(term_scores);
+        m_pair_keys.steal(keys);
+        m_pair_scores.steal(scores);
+    }
+
+    /// Number of values of k for which the scores are stored.
+    [[nodiscard]] auto num_levels() const noexcept -> std::size_t { return m_ks.size(); }
+
+    /// The value of k of the given level.
+    [[nodiscard]] auto k(std::size_t level) const -> std::uint64_t { return m_ks[level]; }
+
+    /// The largest k for which thresholds can be estimated.
+    [[nodiscard]] auto max_k() const -> std::uint64_t
+    {
+        return m_ks.size() > 0 ? m_ks[m_ks.size() - 1] : 0;
+    }
+
+    /// The smallest level with k at least `k`, if any.
+    [[nodiscard]] auto level(std::uint64_t k) const -> std::optional<std::size_t>
+    {
+        auto pos = std::lower_bound(m_ks.begin(), m_ks.end(), k);
+        if (pos == m_ks.end()) {
+            return std::nullopt;
+        }
+        return std::distance(m_ks.begin(), pos);
+    }
+
+    [[nodiscard]] auto num_terms() const noexcept -> std::size_t
+    {
+        return m_ks.size() > 0 ? m_term_scores.size() / m_ks.size() : 0;
+    }
+
+    [[nodiscard]] auto num_pairs() const noexcept -> std::size_t { return m_num_pairs; }
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto term_score(term_id_type term, std::size_t level) const
+        -> float
+    {
+        return term < num_terms() ? m_term_scores[term * m_ks.size() + level] : 0.0F;
+    }
+
+    [[nodiscard]] PISA_ALWAYSINLINE auto
+    pair_score(term_id_type left, term_id_type right, std::size_t level) const
+        -> std::optional<float>
+    {
+        auto key = pair_key(left, right);
+        if (key == empty_key || m_num_pairs == 0) {
+            return std::nullopt;
+        }
+        auto mask = m_pair_keys.size() - 1;
+        for (auto slot = hash(key, m_bits); m_pair_keys[slot] != empty_key;
+             slot = (slot + 1) & mask) {
+            if (m_pair_keys[slot] == key) {
+                return m_pair_scores[slot * m_ks.size() + level];
+            }
+        }
+        return std::nullopt;
+    }
+
+    /// Returns the highest stored k-th score among the terms and pairs of `query`,
+    /// using the smallest stored k that is at least `k`, or 0 if there is none.
+    [[nodiscard]] auto estimate_threshold(Query const& query, std::uint64_t k) const -> Threshold
+    {
+        auto lvl = level(k);
+        if (not lvl) {
+            return 0.0F;
+        }
+        auto terms = query.terms;
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+        float threshold = 0.0F;
+        for (auto term: terms) {
+            threshold = std::max(threshold, term_score(term, *lvl));
+        }
+        if (m_num_pairs > 0) {
+            for (std::size_t left = 0; left < terms.size(); ++left) {
+                for (std::size_t right = left + 1; right < terms.size(); ++right) {
+                    auto score = pair_score(terms[left], terms[right], *lvl);
+                    threshold = std::max(threshold, score.value_or(0.0F));
+                }
+            }
+        }
+        return threshold;
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit)
+    {
+        visit(m_ks, "m_ks")(m_term_scores, "m_term_scores")(m_bits, "m_bits")(
+            m_num_pairs, "m_num_pairs")(m_pair_keys, "m_pair_keys")(m_pair_scores, "m_pair_scores");
+    }
+
+  private:
+    /// Pairs of equal terms are never stored, so (0, 0) marks an empty slot.
+    constexpr static std::uint64_t empty_key = 0;
+
+    [[nodiscard]] PISA_ALWAYSINLINE static auto pair_key(term_id_type left, term_id_type right)
+        -> std::uint64_t
+    {
+        if (left == right) {
+            return empty_key;
+        }
+        if (left > right) {
+            std::swap(left, right);
+        }
+        return (static_cast<std::uint64_t>(left) << 32U) | right;
+    }
+
+    [[nodiscard]] PISA_ALWAYSINLINE static auto hash(std::uint64_t key, std::uint64_t bits)
+        -> std::uint64_t
+    {
+        return bits == 0 ? 0 : (key * 0x9E3779B97F4A7C15ULL) >> (64U - bits);
+    }
+
+    mapper::mappable_vector<std::uint64_t> m_ks;
+    mapper::mappable_vector<float> m_term_scores;
+    std::uint64_t m_bits = 0;
+    std::uint64_t m_num_pairs = 0;
+    mapper::mappable_vector<std::uint64_t> m_pair_keys;
+    mapper::mappable_vector<float> m_pair_scores;
+    MemorySource m_source;
+};
+
+}  // namespace pisa
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+
+namespace pisa {
+
+/// How an index and its WAND data are loaded before being queried.
+struct LoadPolicy {
+    enum class Paging {
+        /// Reads the whole files when loading them, verifying the checksums of the index.
+        Eager,
+        /// Pages the files in on demand, with readahead disabled since posting lists are accessed
+        /// at random, and warms up the posting lists of `warmup_terms` only.
+        Lazy,
+    };
+
+    Paging paging = Paging::Eager;
+    /// Reads the whole files into memory when mapping them.
+    bool populate = false;
+    /// Backs the mappings with transparent huge pages.
+    bool huge_pages = false;
+    /// Terms whose posting lists are warmed up after loading the index, by decreasing priority.
+    std::vector<std::uint32_t> warmup_terms{};
+    /// Bytes of the posting lists of `warmup_terms` to pin in memory (see `pinned_index`).
+    std::size_t pin_budget = 0;
+
+    [[nodiscard]] auto map_options() const -> MapOptions
+    {
+        MapOptions options;
+        options.advice = paging == Paging::Lazy ? MapAdvice::Random : MapAdvice::Normal;
+        options.populate = populate;
+        options.huge_pages = huge_pages;
+        return options;
+    }
+
+    /// Flags to construct indexes and WAND data with.
+    [[nodiscard]] auto map_flags() const -> uint64_t
+    {
+        return paging == Paging::Eager ? mapper::map_flags::warmup : 0;
+    }
+};
+
+/// Returns the `n` terms occurring the most often in `is`, a query log or a list of terms made of
+/// term IDs separated by white space, in decreasing number of occurrences.
+///
+/// Ties are broken by first occurrence, so the first `n` terms of a list of terms sorted by
+/// decreasing frequency are returned as they are. A query ID, followed by a colon, may start
+/// each line, as in query files.
+inline auto most_frequent_terms(std::istream& is, std::size_t n) -> std::vector<std::uint32_t>
+{
+    struct TermCount {
+        std::uint32_t term;
+        std::size_t count;
+    };
+    std::vector<TermCount> counts;
+    std::unordered_map<std::uint32_t, std::size_t> positions;
+    std::string line;
+    while (std::getline(is, line)) {
+        if (auto colon = line.find(':'); colon != std::string::npos) {
+            line.erase(0, colon + 1);
+        }
+        std::size_t pos = 0;
+        while ((pos = line.find_first_of("0123456789", pos)) != std::string::npos) {
+            std::size_t end = 0;
+            auto term = static_cast<std::uint32_t>(std::stoul(line.substr(pos), &end));
+            pos += end;
+            auto [entry, inserted] = positions.emplace(term, counts.size());
+            if (inserted) {
+                counts.push_back({term, 0});
+            }
+            counts[entry->second].count += 1;
+        }
+    }
+    std::stable_sort(counts.begin(), counts.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.count > rhs.count;
+    });
+    counts.resize(std::min(n, counts.size()));
+    std::vector<std::uint32_t> terms(counts.size());
+    std::transform(counts.begin(), counts.end(), terms.begin(), [](auto const& c) { return c.term; });
+    return terms;
+}
+
+}  // namespace pisa
@@ -17,6 +17,7 @@ namespace pisa { namespace mapper {
         class freeze_visitor;
         class map_visitor;
         class sizeof_visitor;
+        class offset_visitor;
     }  // namespace detail
 
     using deleter_t = boost::function<void()>;
@@ -101,6 +102,7 @@ namespace pisa { namespace mapper {
         friend class detail::freeze_visitor;
         friend class detail::map_visitor;
         friend class detail::sizeof_visitor;
+        friend class detail::offset_visitor;
 
       protected:
         const T* m_data;
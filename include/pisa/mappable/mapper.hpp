@@ -227,6 +227,59 @@ namespace pisa { namespace mapper {
             size_node_ptr m_cur_size_node;
         };
 
+        /// Finds the offset, in the frozen representation of a structure, of the data of one of
+        /// its vectors.
+        class offset_visitor {
+          public:
+            explicit offset_visitor(void const* target)
+                : m_target(target), m_size(sizeof(uint64_t))  // freezing flags
+            {}
+
+            offset_visitor(offset_visitor const&) = delete;
+            offset_visitor(offset_visitor&&) = delete;
+            offset_visitor& operator=(offset_visitor const&) = delete;
+            offset_visitor& operator=(offset_visitor&&) = delete;
+            ~offset_visitor() = default;
+
+            template <typename T>
+            typename std::enable_if<!std::is_pod<T>::value, offset_visitor&>::type
+            operator()(T& val, const char* /* friendly_name */)
+            {
+                val.map(*this);
+                return *this;
+            }
+
+            template <typename T>
+            typename std::enable_if<std::is_pod<T>::value, offset_visitor&>::type
+            operator()(T& /* val */, const char* /* friendly_name */)
+            {
+                m_size += sizeof(T);
+                return *this;
+            }
+
+            template <typename T>
+            offset_visitor& operator()(mappable_vector<T>& vec, const char* /* friendly_name */)
+            {
+                (*this)(vec.m_size, "size");
+                if (&vec == m_target) {
+                    m_offset = m_size;
+                }
+                m_size += static_cast<size_t>(vec.m_size * sizeof(T));
+                return *this;
+            }
+
+            size_t offset() const
+            {
+                assert(m_offset != size_t(-1));
+                return m_offset;
+            }
+
+          protected:
+            void const* m_target;
+            size_t m_size;
+            size_t m_offset = size_t(-1);
+        };
+
     }  // namespace detail
 
     template <typename T>
@@ -270,6 +323,16 @@ namespace pisa { namespace mapper {
         return sizer.size();
     }
 
+    /// Byte offset of the data of `vec`, which must be reachable from `val`, in the file
+    /// `val` is frozen to.
+    template <typename T, typename U>
+    size_t offset_of(T& val, mappable_vector<U> const& vec)
+    {
+        detail::offset_visitor visitor(&vec);
+        visitor(val, "");
+        return visitor.offset();
+    }
+
     template <typename T>
     size_node_ptr size_tree_of(T& val, const char* friendly_name = "<TOP>")
     {
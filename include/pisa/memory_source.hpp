@@ -8,6 +8,18 @@
 
 namespace pisa {
 
+/// Access pattern of a memory mapped file, advised to the kernel.
+enum class MapAdvice { Normal, Random, Sequential };
+
+/// Options of memory mapped files. They are hints, ignored where they are not supported.
+struct MapOptions {
+    MapAdvice advice = MapAdvice::Normal;
+    /// Reads the whole file into memory when mapping it, like `MAP_POPULATE`.
+    bool populate = false;
+    /// Backs the mapping with transparent huge pages (`MADV_HUGEPAGE`).
+    bool huge_pages = false;
+};
+
 /// This is an owning memory source for any byte-based structures.
 class MemorySource {
   public:
@@ -34,13 +46,15 @@ class MemorySource {
     ///
     /// \throws NoSuchFile          if the file doesn't exist
     /// \throws std::system_error   if fails to map the file.
-    [[nodiscard]] static auto mapped_file(std::string const& file) -> MemorySource;
+    [[nodiscard]] static auto mapped_file(std::string const& file, MapOptions const& options = {})
+        -> MemorySource;
 
     /// Constructs a memory source using a memory mapped file.
     ///
     /// \throws NoSuchFile          if the file doesn't exist
     /// \throws std::system_error   if fails to map the file.
-    [[nodiscard]] static auto mapped_file(boost::filesystem::path file) -> MemorySource;
+    [[nodiscard]] static auto
+    mapped_file(boost::filesystem::path file, MapOptions const& options = {}) -> MemorySource;
 
     /// Checks if memory is mapped.
     [[nodiscard]] auto is_mapped() noexcept -> bool;
@@ -72,6 +86,15 @@ class MemorySource {
     [[nodiscard]] auto subspan(size_type offset, size_type size = gsl::dynamic_extent) const
         -> gsl::span<value_type const>;
 
+    /// Advises the kernel that the `size` bytes at `offset` will be read soon, so that it reads
+    /// them ahead (`MADV_WILLNEED`). Does nothing where it is not supported.
+    ///
+    /// \throws std::out_of_range   if offset + size is out of bounds
+    void will_need(size_type offset, size_type size) const;
+
+    /// Path of the mapped file, or an empty path if the memory is not a mapped file.
+    [[nodiscard]] auto file() const noexcept -> boost::filesystem::path const&;
+
     /// Type erasure interface. Any type implementing it are supported as memory source.
     struct Interface {
         Interface() = default;
@@ -109,6 +132,7 @@ class MemorySource {
     {}
 
     std::unique_ptr<Interface> m_source;
+    boost::filesystem::path m_file;
 };
 
 }  // namespace pisa
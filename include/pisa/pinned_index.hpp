@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <gsl/span>
+#include <spdlog/spdlog.h>
+#include <tbb/cache_aligned_allocator.h>
+#include <tbb/enumerable_thread_specific.h>
+
+#include "block_freq_index.hpp"
+#include "freq_index.hpp"
+#include "pinned_memory.hpp"
+
+namespace pisa {
+
+/// Index wrapping another one, typically memory mapped from a file larger than RAM, whose hot
+/// posting lists are pinned in memory so that they are not evicted from the page cache.
+///
+/// The posting lists of block indexes are copied next to each other into memory locked in RAM
+/// and backed by huge pages, and enumerated from there. Those of bit vector indexes, which are
+/// not byte-aligned, have their pages locked where they are mapped. Lists are enumerated with the
+/// `document_enumerator` of the wrapped index either way, and the lookups of pinned and other
+/// lists are counted by each thread.
+template <typename Index>
+class pinned_index {
+  public:
+    using document_enumerator = typename Index::document_enumerator;
+
+    /// Pins the posting lists of `terms`, typically the most frequent ones in a query log, in
+    /// order, skipping those that would exceed `budget` bytes in total.
+    pinned_index(Index const& index, gsl::span<std::uint32_t const> terms, std::size_t budget)
+        : m_index(index)
+    {
+        if constexpr (std::is_same_v<typename Index::index_layout_tag, BlockIndexTag>) {
+            copy_posting_lists(terms, budget);
+        } else if constexpr (std::is_same_v<typename Index::index_layout_tag, BitVectorIndexTag>) {
+            lock_posting_lists(terms, budget);
+        } else if (budget > 0 && not terms.empty()) {
+            spdlog::warn("Posting lists of this index type cannot be pinned");
+        }
+    }
+
+    pinned_index(pinned_index const&) = delete;
+    pinned_index(pinned_index&&) = delete;
+    pinned_index& operator=(pinned_index const&) = delete;
+    pinned_index& operator=(pinned_index&&) = delete;
+
+    ~pinned_index()
+    {
+        for (auto memory: m_locked_memory) {
+            unlock_memory(memory);
+        }
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_index.size(); }
+    [[nodiscard]] auto num_docs() const -> std::uint64_t { return m_index.num_docs(); }
+
+    [[nodiscard]] auto operator[](std::size_t i) const -> document_enumerator
+    {
+        auto& lookups = m_lookups.local();
+        if (auto pos = m_pinned.find(i); pos != m_pinned.end()) {
+            lookups.hits += 1;
+            if constexpr (std::is_same_v<typename Index::index_layout_tag, BlockIndexTag>) {
+                auto const* data = reinterpret_cast<std::uint8_t const*>(m_memory.data());
+                return document_enumerator(data + pos->second, m_index.num_docs(), i);
+            }
+        } else {
+            lookups.misses += 1;
+        }
+        return m_index[i];
+    }
+
+    void warmup(std::size_t i) const
+    {
+        if (m_pinned.find(i) == m_pinned.end()) {
+            m_index.warmup(i);
+        }
+    }
+
+    [[nodiscard]] auto pinned_lists() const -> std::size_t { return m_pinned.size(); }
+    [[nodiscard]] auto pinned_bytes() const -> std::size_t { return m_pinned_bytes; }
+
+    /// Whether all pinned lists are locked in RAM, which `RLIMIT_MEMLOCK` may prevent.
+    [[nodiscard]] auto locked() const -> bool { return m_locked; }
+
+    /// Number of lookups of pinned posting lists, summed over threads once they are done.
+    [[nodiscard]] auto hits() const -> std::size_t { return total_lookups().hits; }
+
+    /// Number of lookups of other posting lists, summed over threads once they are done.
+    [[nodiscard]] auto misses() const -> std::size_t { return total_lookups().misses; }
+
+    [[nodiscard]] auto hit_rate() const -> double
+    {
+        auto total = total_lookups();
+        auto lookups = total.hits + total.misses;
+        return lookups > 0 ? static_cast<double>(total.hits) / lookups : 0.0;
+    }
+
+  private:
+    struct Lookups {
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+    };
+
+    [[nodiscard]] auto total_lookups() const -> Lookups
+    {
+        Lookups total;
+        for (auto const& lookups: m_lookups) {
+            total.hits += lookups.hits;
+            total.misses += lookups.misses;
+        }
+        return total;
+    }
+
+    /// Selects the lists of `terms` fitting in `budget`, given their sizes.
+    template <typename ListBytes>
+    void select(gsl::span<std::uint32_t const> terms, std::size_t budget, ListBytes list_bytes)
+    {
+        for (auto term: terms) {
+            if (term >= m_index.size() || m_pinned.count(term) > 0) {
+                continue;
+            }
+            auto bytes = list_bytes(term);
+            if (m_pinned_bytes + bytes <= budget) {
+                m_pinned.emplace(term, m_pinned_bytes);
+                m_pinned_bytes += bytes;
+            }
+        }
+    }
+
+    void copy_posting_lists(gsl::span<std::uint32_t const> terms, std::size_t budget)
+    {
+        select(terms, budget, [&](auto term) { return m_index.posting_list_data(term).size(); });
+        m_memory = PinnedMemory(m_pinned_bytes);
+        m_locked = m_memory.locked() || m_pinned_bytes == 0;
+        for (auto [term, offset]: m_pinned) {
+            auto data = m_index.posting_list_data(term);
+            std::memcpy(m_memory.data() + offset, data.data(), data.size());
+        }
+    }
+
+    void lock_posting_lists(gsl::span<std::uint32_t const> terms, std::size_t budget)
+    {
+        select(terms, budget, [&](auto term) {
+            auto memory = m_index.posting_list_memory(term);
+            return memory[0].size() + memory[1].size();
+        });
+        m_locked = true;
+        for (auto const& entry: m_pinned) {
+            for (auto memory: m_index.posting_list_memory(entry.first)) {
+                m_locked &= lock_memory(memory);
+                m_locked_memory.push_back(memory);
+            }
+        }
+    }
+
+    Index const& m_index;
+    /// Offsets of pinned lists in `m_memory`, if they are copied there.
+    std::unordered_map<std::size_t, std::size_t> m_pinned;
+    std::size_t m_pinned_bytes = 0;
+    PinnedMemory m_memory;
+    std::vector<gsl::span<char const>> m_locked_memory;
+    bool m_locked = false;
+    /// Lookups of each thread, in cache-aligned storage so that threads do not share lines.
+    mutable tbb::enumerable_thread_specific<
+        Lookups,
+        tbb::cache_aligned_allocator<Lookups>,
+        tbb::ets_key_per_instance>
+        m_lookups;
+};
+
+}  // namespace pisa
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+#include <gsl/span>
+
+namespace pisa {
+
+/// Anonymous memory locked in RAM, so that it is never paged out, and backed by transparent huge
+/// pages where supported.
+///
+/// Locking is limited by `RLIMIT_MEMLOCK`; if it fails, the memory is still allocated, but not
+/// locked, which is reported by `locked()`.
+class PinnedMemory {
+  public:
+    PinnedMemory() = default;
+    explicit PinnedMemory(std::size_t size);
+    PinnedMemory(PinnedMemory const&) = delete;
+    PinnedMemory(PinnedMemory&& other) noexcept;
+    PinnedMemory& operator=(PinnedMemory const&) = delete;
+    PinnedMemory& operator=(PinnedMemory&& other) noexcept;
+    ~PinnedMemory();
+
+    [[nodiscard]] auto data() noexcept -> char* { return m_data; }
+    [[nodiscard]] auto data() const noexcept -> char const* { return m_data; }
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
+    [[nodiscard]] auto locked() const noexcept -> bool { return m_locked; }
+
+  private:
+    void release() noexcept;
+
+    char* m_data = nullptr;
+    std::size_t m_size = 0;
+    bool m_locked = false;
+};
+
+/// Locks the pages of `memory`, e.g., of a memory mapped file, in RAM.
+///
+/// \returns whether they could be locked
+auto lock_memory(gsl::span<char const> memory) -> bool;
+
+/// Unlocks the pages of `memory`, locked with `lock_memory`.
+void unlock_memory(gsl::span<char const> memory);
+
+}  // namespace pisa
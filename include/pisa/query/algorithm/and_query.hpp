@@ -2,13 +2,26 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <type_traits>
 #include <vector>
 
 #include "query/queries.hpp"
+#include "util/broadword.hpp"
 #include "util/do_not_optimize_away.hpp"
 
 namespace pisa {
 
+namespace detail {
+
+    template <typename Cursor, typename = void>
+    struct has_docs_bitmap: std::false_type {};
+
+    template <typename Cursor>
+    struct has_docs_bitmap<Cursor, std::void_t<decltype(std::declval<Cursor const&>().docs_word(0))>>
+        : std::true_type {};
+
+}  // namespace detail
+
 struct and_query {
     template <typename CursorRange>
     auto operator()(CursorRange&& cursors, uint32_t max_docid) const
@@ -22,6 +35,13 @@ struct and_query {
             return results;
         }
 
+        if constexpr (detail::has_docs_bitmap<Cursor>::value) {
+            if (std::all_of(cursors.begin(), cursors.end(), [](auto const& c) { return c.dense(); })) {
+                intersect_bitmaps(cursors, max_docid, results);
+                return results;
+            }
+        }
+
         std::vector<Cursor*> ordered_cursors;
         ordered_cursors.reserve(cursors.size());
         for (auto& en: cursors) {
@@ -56,6 +76,27 @@ struct and_query {
         }
         return results;
     }
+
+  private:
+    /// Intersects posting lists stored as bitmaps with a word-level AND.
+    template <typename CursorRange>
+    static void
+    intersect_bitmaps(CursorRange&& cursors, uint32_t max_docid, std::vector<uint32_t>& results)
+    {
+        for (uint32_t base = 0; base < max_docid; base += 64) {
+            uint64_t word = uint64_t(-1);
+            for (auto const& cursor: cursors) {
+                word &= cursor.docs_word(base);
+            }
+            if (max_docid - base < 64) {
+                word &= (uint64_t(1) << (max_docid - base)) - 1;
+            }
+            while (word != 0U) {
+                results.push_back(base + broadword::lsb(word));
+                word &= word - 1;
+            }
+        }
+    }
 };
 
 struct scored_and_query {
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+namespace detail {
+
+    /// Number of floats processed at once by the pivot search.
+    constexpr std::size_t BMW_SIMD_LANES = 8;
+
+    /// Returns the first position `p < limit` such that the sum of `scores[0..=p]`
+    /// is at least `threshold`, or `limit` if no such position exists.
+    ///
+    /// `scores` must be padded with zeros to a multiple of `BMW_SIMD_LANES`.
+    [[nodiscard]] PISA_ALWAYSINLINE auto
+    find_pivot(float const* scores, std::size_t limit, float threshold) -> std::size_t
+    {
+#if defined(__AVX2__)
+        __m256 const threshold_vec = _mm256_set1_ps(threshold);
+        __m256 const zero = _mm256_setzero_ps();
+        __m256i const rotate_1 = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+        __m256i const rotate_2 = _mm256_setr_epi32(6, 7, 0, 1, 2, 3, 4, 5);
+        __m256i const rotate_4 = _mm256_setr_epi32(4, 5, 6, 7, 0, 1, 2, 3);
+        __m256i const broadcast_last = _mm256_set1_epi32(7);
+        __m256 carry = zero;
+        for (std::size_t pos = 0; pos < limit; pos += BMW_SIMD_LANES) {
+            __m256 prefix = _mm256_loadu_ps(scores + pos);
+            // In-register inclusive scan: shift by 1, 2, and 4 lanes and accumulate.
+            prefix = _mm256_add_ps(
+                prefix,
+                _mm256_blend_ps(_mm256_permutevar8x32_ps(prefix, rotate_1), zero, 0b00000001));
+            prefix = _mm256_add_ps(
+                prefix,
+                _mm256_blend_ps(_mm256_permutevar8x32_ps(prefix, rotate_2), zero, 0b00000011));
+            prefix = _mm256_add_ps(
+                prefix,
+                _mm256_blend_ps(_mm256_permutevar8x32_ps(prefix, rotate_4), zero, 0b00001111));
+            prefix = _mm256_add_ps(prefix, carry);
+            auto mask = static_cast<std::uint32_t>(
+                _mm256_movemask_ps(_mm256_cmp_ps(prefix, threshold_vec, _CMP_GE_OQ)));
+            if (mask != 0U) {
+                return std::min(pos + __builtin_ctz(mask), limit);
+            }
+            carry = _mm256_permutevar8x32_ps(prefix, broadcast_last);
+        }
+        return limit;
+#else
+        float upper_bound = 0.0F;
+        for (std::size_t pos = 0; pos < limit; ++pos) {
+            upper_bound += scores[pos];
+            if (upper_bound >= threshold) {
+                return pos;
+            }
+        }
+        return limit;
+#endif
+    }
+
+}  // namespace detail
+
+/// BlockMax WAND with a structure-of-arrays cursor layout.
+///
+/// Cursor docids and score upper bounds are kept in flat arrays ordered by docid,
+/// so that the pivot can be found with a vectorized prefix sum, and cursors are
+/// reordered with insertions rather than by sorting after each scored document.
+/// The arrays are members, so they are reused by all the queries run with the same object.
+/// Returns the same top-k as `block_max_wand_query`.
+struct block_max_wand_simd_query {
+    explicit block_max_wand_simd_query(topk_queue& topk) : m_topk(topk) {}
+
+    template <typename CursorRange>
+    void operator()(CursorRange&& cursors, uint64_t max_docid)
+    {
+        if (cursors.empty()) {
+            return;
+        }
+
+        std::size_t const size = cursors.size();
+        std::size_t const padded_size =
+            (size + detail::BMW_SIMD_LANES - 1) / detail::BMW_SIMD_LANES * detail::BMW_SIMD_LANES;
+
+        // Structure of arrays, ordered by docid: `m_order` holds the positions of the cursors
+        // in `cursors`, and the other arrays their current docids and score bounds.
+        auto& order = m_order;
+        order.resize(size);
+        std::iota(order.begin(), order.end(), 0U);
+        std::sort(order.begin(), order.end(), [&](std::uint32_t lhs, std::uint32_t rhs) {
+            return cursors[lhs].docid() < cursors[rhs].docid();
+        });
+        auto cursor = [&](std::size_t pos) -> decltype(auto) { return cursors[order[pos]]; };
+
+        auto& docids = m_docids;
+        auto& max_scores = m_max_scores;
+        auto& block_max_scores = m_block_max_scores;
+        auto& query_weights = m_query_weights;
+        docids.assign(padded_size, std::numeric_limits<std::uint32_t>::max());
+        max_scores.assign(padded_size, 0.0F);
+        block_max_scores.assign(padded_size, 0.0F);
+        query_weights.assign(padded_size, 0.0F);
+        for (std::size_t i = 0; i < size; ++i) {
+            docids[i] = cursor(i).docid();
+            max_scores[i] = cursor(i).max_score();
+            query_weights[i] = cursor(i).query_weight();
+        }
+
+        auto swap_positions = [&](std::size_t lhs, std::size_t rhs) {
+            std::swap(order[lhs], order[rhs]);
+            std::swap(docids[lhs], docids[rhs]);
+            std::swap(max_scores[lhs], max_scores[rhs]);
+            std::swap(query_weights[lhs], query_weights[rhs]);
+        };
+
+        // Moves the cursor at `pos` towards the end until the docids are sorted again,
+        // assuming everything after `pos` is already sorted.
+        auto sink = [&](std::size_t pos) {
+            for (; pos + 1 < size && docids[pos] > docids[pos + 1]; ++pos) {
+                swap_positions(pos, pos + 1);
+            }
+        };
+
+        while (true) {
+            // Cursors are sorted by docid, so exhausted ones are at the end.
+            auto limit = static_cast<std::size_t>(
+                std::lower_bound(docids.begin(), docids.begin() + size, max_docid)
+                - docids.begin());
+
+            std::size_t pivot = detail::find_pivot(max_scores.data(), limit, m_topk.threshold());
+            if (pivot == limit) {
+                break;
+            }
+            std::uint32_t const pivot_id = docids[pivot];
+            for (; pivot + 1 < size && docids[pivot + 1] == pivot_id; ++pivot) {
+            }
+
+            // Summed in double and in order, exactly as `block_max_wand_query` does, so that
+            // documents at the threshold are treated the same.
+            double block_upper_bound = 0;
+            for (size_t i = 0; i < pivot + 1; ++i) {
+                if (cursor(i).block_max_docid() < pivot_id) {
+                    cursor(i).block_max_next_geq(pivot_id);
+                }
+                block_max_scores[i] = cursor(i).block_max_score();
+                block_upper_bound += block_max_scores[i] * query_weights[i];
+            }
+
+            if (m_topk.would_enter(block_upper_bound)) {
+                // check if pivot is a possible match
+                if (pivot_id == docids[0]) {
+                    float score = 0;
+                    for (std::size_t i = 0; i < size && docids[i] == pivot_id; ++i) {
+                        float part_score = cursor(i).score();
+                        score += part_score;
+                        block_upper_bound -= block_max_scores[i] * query_weights[i] - part_score;
+                        if (!m_topk.would_enter(block_upper_bound)) {
+                            break;
+                        }
+                    }
+                    std::size_t matched = 0;
+                    for (; matched < size && docids[matched] == pivot_id; ++matched) {
+                        cursor(matched).next();
+                        docids[matched] = cursor(matched).docid();
+                    }
+
+                    m_topk.insert(score, pivot_id);
+
+                    // Re-insert the advanced cursors, starting from the one closest to the
+                    // sorted suffix.
+                    for (std::size_t pos = matched; pos > 0; --pos) {
+                        sink(pos - 1);
+                    }
+                } else {
+                    std::size_t next_list = pivot;
+                    for (; docids[next_list] == pivot_id; --next_list) {
+                    }
+                    cursor(next_list).next_geq(pivot_id);
+                    docids[next_list] = cursor(next_list).docid();
+                    sink(next_list);
+                }
+            } else {
+                std::size_t next_list = pivot;
+                float max_weight = max_scores[next_list];
+                for (std::size_t i = 0; i < pivot; i++) {
+                    if (max_scores[i] > max_weight) {
+                        next_list = i;
+                        max_weight = max_scores[i];
+                    }
+                }
+
+                uint64_t next = max_docid;
+                for (size_t i = 0; i <= pivot; ++i) {
+                    if (cursor(i).block_max_docid() < next) {
+                        next = cursor(i).block_max_docid();
+                    }
+                }
+                next = next + 1;
+                if (pivot + 1 < size && docids[pivot + 1] < next) {
+                    next = docids[pivot + 1];
+                }
+                if (next <= pivot_id) {
+                    next = pivot_id + 1;
+                }
+
+                cursor(next_list).next_geq(next);
+                docids[next_list] = cursor(next_list).docid();
+                sink(next_list);
+            }
+        }
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+    void clear_topk() { m_topk.clear(); }
+
+    topk_queue const& get_topk() const { return m_topk; }
+
+  private:
+    topk_queue& m_topk;
+    std::vector<std::uint32_t> m_order;
+    std::vector<std::uint32_t> m_docids;
+    std::vector<float> m_max_scores;
+    std::vector<float> m_block_max_scores;
+    std::vector<float> m_query_weights;
+};
+
+}  // namespace pisa
@@ -58,7 +58,15 @@ struct maxscore_query {
     template <typename Cursors>
     PISA_ALWAYSINLINE void run_sorted(Cursors&& cursors, uint64_t max_docid)
     {
-        auto upper_bounds = calc_upper_bounds(cursors);
+        run_sorted(cursors, max_docid, calc_upper_bounds(cursors));
+    }
+
+    /// Runs MaxScore using the given suffix sums of score upper bounds, where
+    /// `upper_bounds[i]` bounds the total score of cursors `i..n`.
+    template <typename Cursors>
+    PISA_ALWAYSINLINE void
+    run_sorted(Cursors&& cursors, uint64_t max_docid, std::vector<float> const& upper_bounds)
+    {
         auto above_threshold = [&](auto score) { return m_topk.would_enter(score); };
 
         auto first_upper_bound = upper_bounds.end();
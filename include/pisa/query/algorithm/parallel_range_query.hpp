@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Runs `QueryAlg` in parallel over disjoint docid ranges of a single query.
+///
+/// The document space `[0, max_docid)` is split into `num_ranges` ranges of equal length,
+/// which are processed as TBB tasks, so the number of threads is controlled by the
+/// enclosing task arena or `tbb::global_control`. Each range is processed with its own
+/// cursors and a private top-k queue; the queues share their threshold (see
+/// `topk_queue::set_shared_threshold`), so every range prunes with the best bound found
+/// so far by any of them. Ranges are processed in slices of `slice_length` docids, and the
+/// shared threshold is pulled before each of them. The private results are merged into the
+/// queue passed to the constructor.
+template <typename QueryAlg>
+struct parallel_range_query {
+    static constexpr std::uint64_t slice_length = 1U << 16U;
+
+    parallel_range_query(topk_queue& topk, std::size_t num_ranges)
+        : m_topk(topk), m_num_ranges(std::max<std::size_t>(num_ranges, 1))
+    {}
+
+    /// `make_cursors` must return a new set of cursors for the query each time it is called,
+    /// and must be safe to call concurrently.
+    template <typename CursorFactory>
+    void operator()(CursorFactory&& make_cursors, uint64_t max_docid)
+    {
+        auto range_length = (max_docid + m_num_ranges - 1) / m_num_ranges;
+        std::vector<topk_queue> local_topks(m_num_ranges, topk_queue(m_topk.capacity()));
+        std::atomic<Threshold> threshold(m_topk.threshold());
+
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, m_num_ranges, 1),
+            [&](tbb::blocked_range<std::size_t> const& ranges) {
+                for (auto range = ranges.begin(); range != ranges.end(); ++range) {
+                    auto first = std::min(range * range_length, max_docid);
+                    auto last = std::min(first + range_length, max_docid);
+                    if (first == last) {
+                        continue;
+                    }
+                    auto& topk = local_topks[range];
+                    topk.set_shared_threshold(&threshold);
+                    auto cursors = make_cursors();
+                    for (auto& cursor: cursors) {
+                        cursor.next_geq(first);
+                    }
+                    QueryAlg query_alg(topk);
+                    for (auto slice = first; slice < last; slice += slice_length) {
+                        topk.refresh_threshold();
+                        query_alg(cursors, std::min(slice + slice_length, last));
+                    }
+                }
+            });
+
+        for (auto& topk: local_topks) {
+            for (auto const& [score, docid]: topk.topk()) {
+                m_topk.insert(score, docid);
+            }
+        }
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+  private:
+    topk_queue& m_topk;
+    std::size_t m_num_ranges;
+};
+
+}  // namespace pisa
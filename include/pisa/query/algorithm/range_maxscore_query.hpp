@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "query/algorithm/maxscore_query.hpp"
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// MaxScore over fixed-length docid ranges, using the range score upper bounds of
+/// `wand_data_range` (see `make_range_max_scored_cursors`).
+///
+/// Only the ranges containing the next posting of some list are visited, so the cost of a
+/// query does not grow with the number of documents when its lists are sparse. For each of
+/// them, the range maxima of the lists having postings in the range are summed first, and the
+/// range is skipped without scoring any posting if the sum cannot enter the top-k. Surviving
+/// ranges are processed with MaxScore, partitioning the lists based on the range maxima rather
+/// than the global list maxima.
+struct range_maxscore_query {
+    explicit range_maxscore_query(topk_queue& topk) : m_topk(topk) {}
+
+    template <typename Cursors>
+    void operator()(Cursors&& cursors_, uint64_t max_docid)
+    {
+        if (cursors_.empty()) {
+            return;
+        }
+        maxscore_query maxscore(m_topk);
+        auto cursors = maxscore.sorted(cursors_);
+        std::uint64_t const range_length = cursors.front().range_length();
+        std::vector<float> upper_bounds(cursors.size());
+
+        std::uint64_t first = 0;
+        while (true) {
+            // Cursors left behind in a skipped or processed range are moved to the current one,
+            // and the next range to visit is the one holding the smallest of their docids.
+            for (auto& cursor: cursors) {
+                if (cursor.docid() < first) {
+                    cursor.next_geq(first);
+                }
+            }
+            std::uint64_t next_docid = maxscore.min_docid(cursors);
+            if (next_docid >= max_docid) {
+                break;
+            }
+            auto range = static_cast<std::uint32_t>(next_docid / range_length);
+            first = range * range_length;
+            std::uint64_t const last = std::min(first + range_length, max_docid);
+
+            // Lists with no posting in the range contribute nothing to its bound.
+            float bound = 0.0F;
+            for (auto pos = cursors.size(); pos > 0; --pos) {
+                auto& cursor = cursors[pos - 1];
+                if (cursor.docid() < last) {
+                    bound += cursor.range_max_score(range) * cursor.query_weight();
+                }
+                upper_bounds[pos - 1] = bound;
+            }
+            if (m_topk.would_enter(bound)) {
+                maxscore.run_sorted(cursors, last, upper_bounds);
+            }
+            first = last;
+        }
+        std::swap(cursors, cursors_);
+    }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+  private:
+    topk_queue& m_topk;
+};
+
+}  // namespace pisa
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Score-at-a-time (JASS-style) processing of impact-ordered posting lists.
+///
+/// Segments of all query terms are processed in decreasing order of their contribution
+/// (impact times query weight), adding it to the accumulator of every document in the segment.
+/// Processing stops early, before the first segment that would start once `postings_budget`
+/// postings have been processed, which bounds the query latency at the cost of exactness;
+/// with an unlimited budget, the results are those of an exhaustive disjunction.
+class saat_query {
+  public:
+    explicit saat_query(
+        topk_queue& topk, std::size_t postings_budget = std::numeric_limits<std::size_t>::max())
+        : m_topk(topk), m_postings_budget(postings_budget)
+    {}
+
+    template <typename CursorRange, typename Acc>
+    void operator()(CursorRange&& cursors, Acc&& accumulator)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        m_postings = 0;
+        if (cursors.empty()) {
+            return;
+        }
+        accumulator.init();
+
+        auto by_score = [](Cursor const& lhs, Cursor const& rhs) {
+            if (lhs.empty() || rhs.empty()) {
+                return lhs.empty() && not rhs.empty();
+            }
+            return lhs.score() < rhs.score();
+        };
+        while (m_postings < m_postings_budget) {
+            auto& cursor = *std::max_element(cursors.begin(), cursors.end(), by_score);
+            if (cursor.empty()) {
+                break;
+            }
+            auto score = cursor.score();
+            m_postings += cursor.segment_size();
+            cursor.consume_segment([&](auto docid) { accumulator.accumulate(docid, score); });
+        }
+        accumulator.aggregate(m_topk);
+    }
+
+    /// Number of postings processed by the last query.
+    [[nodiscard]] auto postings() const noexcept -> std::size_t { return m_postings; }
+
+    std::vector<std::pair<float, uint64_t>> const& topk() const { return m_topk.topk(); }
+
+  private:
+    topk_queue& m_topk;
+    std::size_t m_postings_budget;
+    std::size_t m_postings = 0;
+};
+
+}  // namespace pisa
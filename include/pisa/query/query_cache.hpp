@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// LRU cache of top-k results, keyed by the multiset of query terms.
+///
+/// Besides answering repeated queries, cached results of a query are used to seed the
+/// threshold of any query containing all of its terms: with non-negative term scores,
+/// the k-th score of a sub-query is a lower bound of the k-th score of the full query.
+///
+/// The cache is bounded both by the number of queries and by the total number of stored
+/// results, evicting the least recently used queries first. It is not thread-safe.
+class QueryCache {
+  public:
+    using entry_type = topk_queue::entry_type;
+    using key_type = term_freq_vec;
+
+    /// Result of a lookup: either cached results of the same query, or the best
+    /// threshold found among the cached sub-queries, if any.
+    struct Lookup {
+        std::vector<entry_type> const* results = nullptr;
+        std::optional<Threshold> threshold{};
+    };
+
+    /// Sub-queries of queries with at most this many distinct terms are all checked,
+    /// while for longer queries only those missing a single term are.
+    constexpr static std::size_t max_exhaustive_terms = 8;
+
+    QueryCache(std::size_t k, std::size_t max_queries, std::size_t max_results)
+        : m_k(k), m_max_queries(max_queries), m_max_results(max_results)
+    {}
+
+    [[nodiscard]] static auto key(Query const& query) -> key_type { return query_freqs(query.terms); }
+
+    /// Looks up `key`, marking it as recently used if found.
+    [[nodiscard]] auto find(key_type const& key) -> Lookup
+    {
+        if (auto pos = m_index.find(key); pos != m_index.end()) {
+            m_entries.splice(m_entries.begin(), m_entries, pos->second);
+            m_hits += 1;
+            return Lookup{&pos->second->second, {}};
+        }
+        Lookup lookup;
+        auto seed = [&](key_type const& subquery) {
+            if (auto pos = m_index.find(subquery); pos != m_index.end()) {
+                auto const& results = pos->second->second;
+                if (results.size() == m_k) {
+                    lookup.threshold = std::max(lookup.threshold.value_or(0.0F), results.back().first);
+                }
+            }
+        };
+        key_type subquery;
+        subquery.reserve(key.size());
+        if (key.size() <= max_exhaustive_terms) {
+            std::uint32_t const full = (1U << key.size()) - 1;
+            for (std::uint32_t mask = 1; mask < full; ++mask) {
+                subquery.clear();
+                for (std::size_t term = 0; term < key.size(); ++term) {
+                    if ((mask & (1U << term)) != 0U) {
+                        subquery.push_back(key[term]);
+                    }
+                }
+                seed(subquery);
+            }
+        } else {
+            for (std::size_t skipped = 0; skipped < key.size(); ++skipped) {
+                subquery.clear();
+                for (std::size_t term = 0; term < key.size(); ++term) {
+                    if (term != skipped) {
+                        subquery.push_back(key[term]);
+                    }
+                }
+                seed(subquery);
+            }
+        }
+        if (lookup.threshold) {
+            m_partial_hits += 1;
+        } else {
+            m_misses += 1;
+        }
+        return lookup;
+    }
+
+    /// Stores the final (sorted) results of a query.
+    void insert(key_type key, std::vector<entry_type> results)
+    {
+        if (m_max_queries == 0 || results.size() > m_max_results) {
+            return;
+        }
+        if (auto pos = m_index.find(key); pos != m_index.end()) {
+            m_num_results -= pos->second->second.size();
+            m_entries.erase(pos->second);
+            m_index.erase(pos);
+        }
+        m_num_results += results.size();
+        m_entries.emplace_front(std::move(key), std::move(results));
+        m_index.emplace(m_entries.front().first, m_entries.begin());
+        while (m_entries.size() > m_max_queries || m_num_results > m_max_results) {
+            m_num_results -= m_entries.back().second.size();
+            m_index.erase(m_entries.back().first);
+            m_entries.pop_back();
+        }
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_entries.size(); }
+    [[nodiscard]] auto hits() const noexcept -> std::size_t { return m_hits; }
+    [[nodiscard]] auto partial_hits() const noexcept -> std::size_t { return m_partial_hits; }
+    [[nodiscard]] auto misses() const noexcept -> std::size_t { return m_misses; }
+    [[nodiscard]] auto hit_rate() const noexcept -> double
+    {
+        auto lookups = m_hits + m_partial_hits + m_misses;
+        return lookups > 0 ? static_cast<double>(m_hits) / lookups : 0.0;
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+        m_index.clear();
+        m_num_results = 0;
+        m_hits = 0;
+        m_partial_hits = 0;
+        m_misses = 0;
+    }
+
+  private:
+    using list_type = std::list<std::pair<key_type, std::vector<entry_type>>>;
+
+    std::size_t m_k;
+    std::size_t m_max_queries;
+    std::size_t m_max_results;
+    std::size_t m_num_results = 0;
+    list_type m_entries;
+    std::unordered_map<key_type, list_type::iterator, boost::hash<key_type>> m_index;
+    std::size_t m_hits = 0;
+    std::size_t m_partial_hits = 0;
+    std::size_t m_misses = 0;
+};
+
+}  // namespace pisa
@@ -6,6 +6,11 @@
 #include <thread>
 #include <vector>
 
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+#include "gsl/span"
 #include "pstl/algorithm"
 #include "pstl/execution"
 #include "tbb/enumerable_thread_specific.h"
@@ -27,22 +32,136 @@ namespace bp {
 
     using ThreadLocalGains = tbb::enumerable_thread_specific<single_init_vector<double>>;
     using ThreadLocalDegrees = tbb::enumerable_thread_specific<single_init_vector<size_t>>;
+    using ThreadLocalTerms = tbb::enumerable_thread_specific<std::vector<uint32_t>>;
+
+    /// Terms of a document whose gains are not cached yet, along with their degrees.
+    struct PendingTerms {
+        std::vector<uint32_t> terms;
+        std::vector<uint32_t> from_degrees;
+        std::vector<uint32_t> to_degrees;
+        std::vector<double> gains;
+
+        void reserve(std::size_t size)
+        {
+            if (terms.size() < size) {
+                terms.resize(size);
+                from_degrees.resize(size);
+                to_degrees.resize(size);
+                gains.resize(size);
+            }
+        }
+    };
+    using ThreadLocalPendingTerms = tbb::enumerable_thread_specific<PendingTerms>;
 
     struct ThreadLocal {
         ThreadLocalGains gains;
         ThreadLocalDegrees left_degrees;
         ThreadLocalDegrees right_degrees;
+        /// Buffers the terms of compressed documents are decoded into.
+        ThreadLocalTerms terms;
+        ThreadLocalPendingTerms pending_terms;
     };
 
-    PISA_ALWAYSINLINE double expb(double logn1, double logn2, size_t deg1, size_t deg2)
+    /// Logarithms looked up by the vectorized gain computation, in single precision.
+    const Log2<4096, float> log2_table;
+
+    /// Number of term gains computed at once by `compute_term_gains`.
+    constexpr std::size_t GAIN_LANES = 8;
+
+    /// Returns the cost of the degrees `deg1` and `deg2` of a term in partitions of `2^logn1` and
+    /// `2^logn2` documents, in single precision.
+    PISA_ALWAYSINLINE float expb(float logn1, float logn2, uint32_t deg1, uint32_t deg2)
     {
-        __m128 _deg = _mm_cvtepi32_ps(_mm_set_epi32(deg1, deg1, deg2, deg2));
-        __m128 _log = _mm_set_ps(logn1, log2(deg1 + 1), logn2, log2(deg2 + 1));
-        __m128 _result = _mm_mul_ps(_deg, _log);
-        float a[4];
-        _mm_store_ps(a, _result);
-        return a[3] - a[2] + a[1] - a[0];  // Can we do it with SIMD?
-    };
+        auto fdeg1 = static_cast<float>(static_cast<int32_t>(deg1));
+        auto fdeg2 = static_cast<float>(static_cast<int32_t>(deg2));
+        return fdeg1 * logn1 - fdeg1 * log2_table(deg1 + 1) + fdeg2 * logn2
+            - fdeg2 * log2_table(deg2 + 1);
+    }
+
+    /// Returns the gain in cost of moving a document containing a term of degrees `from_deg` and
+    /// `to_deg` from a partition of `2^logn1` documents to one of `2^logn2`.
+    PISA_ALWAYSINLINE double term_gain(float logn1, float logn2, uint32_t from_deg, uint32_t to_deg)
+    {
+        return static_cast<double>(expb(logn1, logn2, from_deg, to_deg))
+            - static_cast<double>(expb(logn1, logn2, from_deg - 1, to_deg + 1));
+    }
+
+#if defined(__AVX2__)
+    /// Looks up the logarithms of `values` in `log2_table`, computing those out of its range.
+    PISA_ALWAYSINLINE __m256 log2_lookup(__m256i values)
+    {
+        __m256i const last = _mm256_set1_epi32(log2_table.size() - 1);
+        __m256 logs = _mm256_i32gather_ps(log2_table.data(), _mm256_min_epu32(values, last), 4);
+        __m256i in_range = _mm256_cmpeq_epi32(_mm256_max_epu32(values, last), last);
+        if (PISA_UNLIKELY(_mm256_movemask_epi8(in_range) != -1)) {
+            alignas(32) uint32_t lanes[GAIN_LANES];
+            alignas(32) float lane_logs[GAIN_LANES];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), values);
+            for (std::size_t lane = 0; lane < GAIN_LANES; ++lane) {
+                lane_logs[lane] = log2_table(lanes[lane]);
+            }
+            logs = _mm256_load_ps(lane_logs);
+        }
+        return logs;
+    }
+
+    /// Vectorized `expb` of `GAIN_LANES` terms.
+    PISA_ALWAYSINLINE __m256 expb(__m256 logn1, __m256 logn2, __m256i deg1, __m256i deg2)
+    {
+        __m256i const one = _mm256_set1_epi32(1);
+        __m256 fdeg1 = _mm256_cvtepi32_ps(deg1);
+        __m256 fdeg2 = _mm256_cvtepi32_ps(deg2);
+        __m256 cost = _mm256_sub_ps(
+            _mm256_mul_ps(fdeg1, logn1),
+            _mm256_mul_ps(fdeg1, log2_lookup(_mm256_add_epi32(deg1, one))));
+        cost = _mm256_add_ps(cost, _mm256_mul_ps(fdeg2, logn2));
+        return _mm256_sub_ps(
+            cost, _mm256_mul_ps(fdeg2, log2_lookup(_mm256_add_epi32(deg2, one))));
+    }
+#endif
+
+    /// Computes `gains[i] = term_gain(logn1, logn2, from_degrees[i], to_degrees[i])` for each
+    /// `i < count`, `GAIN_LANES` terms at a time with AVX2.
+    PISA_ALWAYSINLINE void compute_term_gains(
+        float logn1,
+        float logn2,
+        uint32_t const* from_degrees,
+        uint32_t const* to_degrees,
+        double* gains,
+        std::size_t count)
+    {
+        std::size_t pos = 0;
+#if defined(__AVX2__)
+        __m256 const logn1_vec = _mm256_set1_ps(logn1);
+        __m256 const logn2_vec = _mm256_set1_ps(logn2);
+        __m256i const one = _mm256_set1_epi32(1);
+        for (; pos + GAIN_LANES <= count; pos += GAIN_LANES) {
+            auto* from = reinterpret_cast<__m256i const*>(from_degrees + pos);
+            auto* to = reinterpret_cast<__m256i const*>(to_degrees + pos);
+            __m256i from_deg = _mm256_loadu_si256(from);
+            __m256i to_deg = _mm256_loadu_si256(to);
+            __m256 before = expb(logn1_vec, logn2_vec, from_deg, to_deg);
+            __m256 after = expb(
+                logn1_vec,
+                logn2_vec,
+                _mm256_sub_epi32(from_deg, one),
+                _mm256_add_epi32(to_deg, one));
+            _mm256_storeu_pd(
+                gains + pos,
+                _mm256_sub_pd(
+                    _mm256_cvtps_pd(_mm256_castps256_ps128(before)),
+                    _mm256_cvtps_pd(_mm256_castps256_ps128(after))));
+            _mm256_storeu_pd(
+                gains + pos + GAIN_LANES / 2,
+                _mm256_sub_pd(
+                    _mm256_cvtps_pd(_mm256_extractf128_ps(before, 1)),
+                    _mm256_cvtps_pd(_mm256_extractf128_ps(after, 1))));
+        }
+#endif
+        for (; pos < count; ++pos) {
+            gains[pos] = term_gain(logn1, logn2, from_degrees[pos], to_degrees[pos]);
+        }
+    }
 
     template <typename ThreadLocalContainer>
     [[nodiscard]] PISA_ALWAYSINLINE auto&
@@ -71,7 +190,7 @@ class document_range {
     document_range(
         Iterator first,
         Iterator last,
-        std::reference_wrapper<const forward_index> fwdidx,
+        std::reference_wrapper<const flat_forward_index> fwdidx,
         std::reference_wrapper<std::vector<double>> gains)
         : m_first(first), m_last(last), m_fwdidx(fwdidx), m_gains(gains)
     {}
@@ -97,9 +216,10 @@ class document_range {
     }
 
     std::size_t term_count() const { return m_fwdidx.get().term_count(); }
-    std::vector<uint32_t> terms(value_type document) const
+    /// Returns the terms of `document`, decoded into `buffer` if the index is compressed.
+    gsl::span<const uint32_t> terms(value_type document, std::vector<uint32_t>& buffer) const
     {
-        return m_fwdidx.get().terms(document);
+        return m_fwdidx.get().terms(document, buffer);
     }
     double gain(value_type document) const { return m_gains.get()[document]; }
     double& gain(value_type document) { return m_gains.get()[document]; }
@@ -114,7 +234,7 @@ class document_range {
   private:
     Iterator m_first;
     Iterator m_last;
-    std::reference_wrapper<const forward_index> m_fwdidx;
+    std::reference_wrapper<const flat_forward_index> m_fwdidx;
     std::reference_wrapper<std::vector<double>> m_gains;
 };
 
@@ -161,10 +281,13 @@ auto get_mapping = [](const auto& collection) {
 };
 
 template <class Iterator>
-void compute_degrees(document_range<Iterator>& range, single_init_vector<size_t>& deg_map)
+void compute_degrees(
+    document_range<Iterator>& range,
+    single_init_vector<size_t>& deg_map,
+    std::vector<uint32_t>& buffer)
 {
     for (const auto& document: range) {
-        auto terms = range.terms(document);
+        auto terms = range.terms(document, buffer);
         auto deg_map_inc = [&](const auto& t) { deg_map.set(t, deg_map[t] + 1); };
         std::for_each(pstl::execution::unseq, terms.begin(), terms.end(), deg_map_inc);
     }
@@ -179,31 +302,47 @@ void compute_move_gains_caching(
     const single_init_vector<size_t>& to_lex,
     bp::ThreadLocal& thread_local_data)
 {
-    const auto logn1 = log2(from_n);
-    const auto logn2 = log2(to_n);
+    const auto logn1 = static_cast<float>(log2(from_n));
+    const auto logn2 = static_cast<float>(log2(to_n));
 
     auto& gain_cache = bp::clear_or_init(thread_local_data.gains, from_lex.size());
+    auto& buffer = thread_local_data.terms.local();
+    auto& pending = thread_local_data.pending_terms.local();
+    auto add_pending = [&](auto t, std::size_t& count) {
+        pending.terms[count] = t;
+        pending.from_degrees[count] = from_lex[t];
+        pending.to_degrees[count] = to_lex[t];
+        ++count;
+    };
     auto compute_document_gain = [&](auto& d) {
-        double gain = 0.0;
-        auto terms = range.terms(d);
-        for (const auto& t: terms) {
+        auto terms = range.terms(d, buffer);
+        pending.reserve(terms.size());
+        // Gains of the terms not cached yet are computed together, then the document gain is
+        // summed in term order.
+        std::size_t count = 0;
+        for (auto t: terms) {
             if constexpr (isLikelyCached) {  // NOLINT(readability-braces-around-statements)
                 if (PISA_UNLIKELY(not gain_cache.has_value(t))) {
-                    const auto& from_deg = from_lex[t];
-                    const auto& to_deg = to_lex[t];
-                    const auto term_gain = bp::expb(logn1, logn2, from_deg, to_deg)
-                        - bp::expb(logn1, logn2, from_deg - 1, to_deg + 1);
-                    gain_cache.set(t, term_gain);
+                    add_pending(t, count);
                 }
             } else {
                 if (PISA_LIKELY(not gain_cache.has_value(t))) {
-                    const auto& from_deg = from_lex[t];
-                    const auto& to_deg = to_lex[t];
-                    const auto term_gain = bp::expb(logn1, logn2, from_deg, to_deg)
-                        - bp::expb(logn1, logn2, from_deg - 1, to_deg + 1);
-                    gain_cache.set(t, term_gain);
+                    add_pending(t, count);
                 }
             }
+        }
+        bp::compute_term_gains(
+            logn1,
+            logn2,
+            pending.from_degrees.data(),
+            pending.to_degrees.data(),
+            pending.gains.data(),
+            count);
+        for (std::size_t pos = 0; pos < count; ++pos) {
+            gain_cache.set(pending.terms[pos], pending.gains[pos]);
+        }
+        double gain = 0.0;
+        for (auto t: terms) {
             gain += gain_cache[t];
         }
         range.gain(d) = gain;
@@ -225,7 +364,10 @@ void compute_gains(
 }
 
 template <class Iterator>
-void swap(document_partition<Iterator>& partition, degree_map_pair& degrees)
+void swap(
+    document_partition<Iterator>& partition,
+    degree_map_pair& degrees,
+    std::vector<uint32_t>& buffer)
 {
     auto left = partition.left;
     auto right = partition.right;
@@ -236,15 +378,15 @@ void swap(document_partition<Iterator>& partition, degree_map_pair& degrees)
             break;
         }
         {
-            auto terms = left.terms(*lit);
-            for (auto& term: terms) {
+            auto terms = left.terms(*lit, buffer);
+            for (auto term: terms) {
                 degrees.left.set(term, degrees.left[term] - 1);
                 degrees.right.set(term, degrees.right[term] + 1);
             }
         }
         {
-            auto terms = right.terms(*rit);
-            for (auto& term: terms) {
+            auto terms = right.terms(*rit, buffer);
+            for (auto term: terms) {
                 degrees.left.set(term, degrees.left[term] + 1);
                 degrees.right.set(term, degrees.right[term] - 1);
             }
@@ -265,8 +407,9 @@ void process_partition(
         bp::clear_or_init(thread_local_data.left_degrees, partition.left.term_count());
     auto& right_degree =
         bp::clear_or_init(thread_local_data.right_degrees, partition.right.term_count());
-    compute_degrees(partition.left, left_degree);
-    compute_degrees(partition.right, right_degree);
+    auto& buffer = thread_local_data.terms.local();
+    compute_degrees(partition.left, left_degree, buffer);
+    compute_degrees(partition.right, right_degree, buffer);
     degree_map_pair degrees{left_degree, right_degree};
 
     for (int iteration = 0; iteration < iterations; ++iteration) {
@@ -286,7 +429,7 @@ void process_partition(
                     partition.right.end(),
                     partition.right.by_gain());
             });
-        swap(partition, degrees);
+        swap(partition, degrees, thread_local_data.terms.local());
     }
 }
 
@@ -79,26 +79,31 @@ namespace detail {
         return 1;
     }
 
-    forward_index fwd = options.input_fwd
-        ? forward_index::read(*options.input_fwd)
-        : forward_index::from_inverted_index(
-            options.input_basename, options.min_length, options.compress_fwd);
-
     if (options.output_fwd) {
+        auto fwd = options.input_fwd
+            ? forward_index::read(*options.input_fwd)
+            : forward_index::from_inverted_index(
+                options.input_basename, options.min_length, options.compress_fwd);
         forward_index::write(fwd, *options.output_fwd);
     }
 
     if (options.output_basename) {
-        std::vector<uint32_t> documents(fwd.size());
+        // Built straight from its source rather than copied, so that only one forward index is
+        // ever in memory.
+        auto flat_fwd = options.input_fwd
+            ? flat_forward_index::read(*options.input_fwd)
+            : flat_forward_index::from_inverted_index(
+                options.input_basename, options.min_length, options.compress_fwd);
+        std::vector<uint32_t> documents(flat_fwd.size());
         std::iota(documents.begin(), documents.end(), 0U);
-        std::vector<double> gains(fwd.size(), 0.0);
-        detail::range_type initial_range(documents.begin(), documents.end(), fwd, gains);
+        std::vector<double> gains(flat_fwd.size(), 0.0);
+        detail::range_type initial_range(documents.begin(), documents.end(), flat_fwd, gains);
 
         if (options.node_config) {
             detail::run_with_config(*options.node_config, initial_range);
         } else {
             detail::run_default_tree(
-                options.depth.value_or(static_cast<size_t>(std::log2(fwd.size()) - 5)),
+                options.depth.value_or(static_cast<size_t>(std::log2(flat_fwd.size()) - 5)),
                 initial_range);
         }
 
@@ -108,7 +113,7 @@ namespace detail {
             }
         }
         auto mapping = get_mapping(documents);
-        fwd.clear();
+        flat_fwd = flat_forward_index();
         documents.clear();
         reorder_inverted_index(options.input_basename, *options.output_basename, mapping);
 
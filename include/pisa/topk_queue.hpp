@@ -3,6 +3,7 @@
 #include "util/likely.hpp"
 #include "util/util.hpp"
 #include <algorithm>
+#include <atomic>
 
 namespace pisa {
 
@@ -35,11 +36,13 @@ struct topk_queue {
             std::push_heap(m_q.begin(), m_q.end(), min_heap_order);
             if (PISA_UNLIKELY(m_q.size() == m_k)) {
                 m_threshold = m_q.front().first;
+                publish_threshold();
             }
         } else {
             std::pop_heap(m_q.begin(), m_q.end(), min_heap_order);
             m_q.pop_back();
             m_threshold = m_q.front().first;
+            publish_threshold();
         }
         return true;
     }
@@ -62,6 +65,31 @@ struct topk_queue {
 
     void set_threshold(Threshold t) noexcept { m_threshold = t; }
 
+    /// Shares the threshold with other queues through `shared`, or stops sharing if `nullptr`.
+    ///
+    /// Once this queue is full, every raise of its threshold is published to `shared`
+    /// (as a monotonic maximum), and the threshold of this queue is raised to the value
+    /// of `shared` when it is tighter. Callers should also pull it periodically with
+    /// `refresh_threshold`, since `would_enter` only checks the local threshold. This is only
+    /// correct if all sharing queues collect results for the same query, e.g., over disjoint
+    /// document ranges or shards, and their results are merged afterwards.
+    ///
+    /// `shared` must outlive its use by this queue. Clearing the queue does not stop sharing.
+    void set_shared_threshold(std::atomic<Threshold>* shared) noexcept
+    {
+        m_shared_threshold = shared;
+        refresh_threshold();
+    }
+
+    /// Raises the threshold to the shared one if it is tighter. Does nothing if not sharing.
+    void refresh_threshold() noexcept
+    {
+        if (m_shared_threshold != nullptr) {
+            auto shared = m_shared_threshold->load(std::memory_order_relaxed);
+            m_threshold = std::max(m_threshold, shared);
+        }
+    }
+
     Threshold threshold() const noexcept { return m_threshold; }
 
     void clear() noexcept
@@ -75,9 +103,23 @@ struct topk_queue {
     [[nodiscard]] size_t size() const noexcept { return m_q.size(); }
 
   private:
+    void publish_threshold() noexcept
+    {
+        if (m_shared_threshold == nullptr) {
+            return;
+        }
+        auto shared = m_shared_threshold->load(std::memory_order_relaxed);
+        while (shared < m_threshold
+               && !m_shared_threshold->compare_exchange_weak(
+                   shared, m_threshold, std::memory_order_relaxed)) {
+        }
+        m_threshold = std::max(m_threshold, shared);
+    }
+
     float m_threshold;
     uint64_t m_k;
     std::vector<entry_type> m_q;
+    std::atomic<Threshold>* m_shared_threshold = nullptr;
 };
 
 }  // namespace pisa
@@ -5,7 +5,8 @@
 
 namespace pisa {
 
-template <size_t N>
+/// Base-2 logarithm of integers, precomputed for those below `N` and stored as `T`.
+template <size_t N, typename T = double>
 class Log2 {
     static_assert(N >= 0, "number of precomputed values must be non-negative");
 
@@ -16,7 +17,7 @@ class Log2 {
             m_values[n] = std::log2(n);
         }
     }
-    constexpr double operator()(size_t n) const
+    constexpr T operator()(size_t n) const
     {
         if (n >= m_values.size()) {
             return std::log2(n);
@@ -24,8 +25,12 @@ class Log2 {
         return m_values[n];
     }
 
+    /// The precomputed values, for vectorized lookups of integers below `size()`.
+    constexpr T const* data() const { return m_values.data(); }
+    constexpr std::size_t size() const { return N; }
+
   private:
-    std::array<double, N> m_values{};
+    std::array<T, N> m_values{};
 };
 
 }  // namespace pisa
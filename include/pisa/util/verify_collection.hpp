@@ -2,7 +2,6 @@
 
 #include "spdlog/spdlog.h"
 
-#include "mappable/mapper.hpp"
 #include "memory_source.hpp"
 #include "util/util.hpp"
 
@@ -11,9 +10,7 @@ namespace pisa {
 template <typename InputCollection, typename Collection>
 void verify_collection(InputCollection const& input, const char* filename)
 {
-    Collection coll;
-    auto source = MemorySource::mapped_file(boost::filesystem::path(filename));
-    pisa::mapper::map(coll, source.data());
+    Collection coll(MemorySource::mapped_file(boost::filesystem::path(filename)));
     size_t size = 0;
     spdlog::info("Checking the written data, just to be extra safe...");
     size_t s = 0;
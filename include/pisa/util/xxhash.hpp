@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace pisa {
+
+/// Streaming 64-bit xxHash (XXH64) of a sequence of bytes.
+class xxhash64 {
+  public:
+    explicit xxhash64(uint64_t seed = 0)
+        : m_acc{seed + prime1 + prime2, seed + prime2, seed, seed - prime1}, m_seed(seed)
+    {}
+
+    void update(void const* data, std::size_t len)
+    {
+        auto const* p = static_cast<uint8_t const*>(data);
+        auto const* end = p + len;
+        m_total_len += len;
+
+        if (m_buffered + len < m_buffer.size()) {
+            std::memcpy(m_buffer.data() + m_buffered, p, len);
+            m_buffered += len;
+            return;
+        }
+        if (m_buffered > 0) {
+            auto fill = m_buffer.size() - m_buffered;
+            std::memcpy(m_buffer.data() + m_buffered, p, fill);
+            consume_stripe(m_buffer.data());
+            p += fill;
+            m_buffered = 0;
+        }
+        for (; p + m_buffer.size() <= end; p += m_buffer.size()) {
+            consume_stripe(p);
+        }
+        m_buffered = end - p;
+        std::memcpy(m_buffer.data(), p, m_buffered);
+    }
+
+    [[nodiscard]] auto digest() const -> uint64_t
+    {
+        uint64_t h;
+        if (m_total_len >= m_buffer.size()) {
+            h = rotl(m_acc[0], 1) + rotl(m_acc[1], 7) + rotl(m_acc[2], 12) + rotl(m_acc[3], 18);
+            for (auto acc: m_acc) {
+                h = (h ^ round(0, acc)) * prime1 + prime4;
+            }
+        } else {
+            h = m_seed + prime5;
+        }
+        h += m_total_len;
+
+        auto const* p = m_buffer.data();
+        auto const* end = p + m_buffered;
+        for (; p + 8 <= end; p += 8) {
+            h = rotl(h ^ round(0, read<uint64_t>(p)), 27) * prime1 + prime4;
+        }
+        if (p + 4 <= end) {
+            h = rotl(h ^ (read<uint32_t>(p) * prime1), 23) * prime2 + prime3;
+            p += 4;
+        }
+        for (; p < end; ++p) {
+            h = rotl(h ^ (*p * prime5), 11) * prime1;
+        }
+
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+  private:
+    static constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+    static constexpr auto rotl(uint64_t x, int r) -> uint64_t { return (x << r) | (x >> (64 - r)); }
+
+    static constexpr auto round(uint64_t acc, uint64_t input) -> uint64_t
+    {
+        return rotl(acc + input * prime2, 31) * prime1;
+    }
+
+    template <typename T>
+    static auto read(uint8_t const* p) -> T
+    {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        return value;
+    }
+
+    void consume_stripe(uint8_t const* p)
+    {
+        for (auto& acc: m_acc) {
+            acc = round(acc, read<uint64_t>(p));
+            p += 8;
+        }
+    }
+
+    std::array<uint64_t, 4> m_acc;
+    uint64_t m_seed;
+    uint64_t m_total_len = 0;
+    std::array<uint8_t, 32> m_buffer{};
+    std::size_t m_buffered = 0;
+};
+
+/// XXH64 of `len` bytes at `data`.
+inline auto xxhash64_of(void const* data, std::size_t len, uint64_t seed = 0) -> uint64_t
+{
+    xxhash64 hash(seed);
+    hash.update(data, len);
+    return hash.digest();
+}
+
+}  // namespace pisa
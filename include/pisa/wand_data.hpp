@@ -30,90 +30,127 @@ class wand_data {
     using wand_data_enumerator = typename block_wand_type::enumerator;
 
     wand_data() = default;
-    explicit wand_data(MemorySource source) : m_source(std::move(source))
+    explicit wand_data(MemorySource source, uint64_t flags = mapper::map_flags::warmup)
+        : m_source(std::move(source))
     {
-        mapper::map(*this, m_source.data(), mapper::map_flags::warmup);
+        mapper::map(*this, m_source.data(), flags);
     }
 
-    template <typename LengthsIterator>
-    wand_data(
-        LengthsIterator len_it,
-        uint64_t num_docs,
-        binary_freq_collection const& coll,
-        const ScorerParams& scorer_params,
-        BlockSize block_size,
-        bool is_quantized,
-        std::unordered_set<size_t> const& terms_to_drop)
-        : m_num_docs(num_docs)
-    {
-        std::vector<uint32_t> doc_lens(num_docs);
-        std::vector<float> max_term_weight;
-        std::vector<uint32_t> term_occurrence_counts;
-        std::vector<uint32_t> term_posting_counts;
-        global_parameters params;
-        spdlog::info("Reading sizes...");
-
-        for (size_t i = 0; i < num_docs; ++i) {
-            uint32_t len = *len_it++;
-            doc_lens[i] = len;
-            m_collection_len += len;
+    /// Builds WAND data from the posting lists of a collection given one at a time in term order,
+    /// so that they can be streamed as they are produced, and the document lengths beforehand.
+    class builder {
+      public:
+        builder(
+            std::vector<uint32_t> doc_lens,
+            ScorerParams const& scorer_params,
+            BlockSize block_size,
+            bool is_quantized)
+            : m_num_docs(doc_lens.size()),
+              m_doc_lens(std::move(doc_lens)),
+              m_block_size(std::move(block_size)),
+              m_is_quantized(is_quantized),
+              m_block_wand_builder(m_num_docs, m_params)
+        {
+            m_collection_len =
+                std::accumulate(m_doc_lens.begin(), m_doc_lens.end(), std::uint64_t(0));
+            m_avg_len = float(m_collection_len / double(m_num_docs));
+            m_scorer = scorer::from_params(scorer_params, *this);
         }
 
-        m_avg_len = float(m_collection_len / double(num_docs));
-
-        typename block_wand_type::builder builder(coll, params);
+        builder(builder const&) = delete;
+        builder(builder&&) = delete;
+        builder& operator=(builder const&) = delete;
+        builder& operator=(builder&&) = delete;
+        ~builder() = default;
 
+        /// Adds the posting list of the next term.
+        void add_posting_list(binary_freq_collection::sequence const& seq)
         {
-            pisa::progress progress("Storing terms statistics", coll.size());
-            size_t term_id = 0;
-            for (auto const& seq: coll) {
-                if (terms_to_drop.find(term_id) != terms_to_drop.end()) {
-                    progress.update(1);
-                    term_id += 1;
-                    continue;
-                }
-
-                size_t term_occurrence_count = std::accumulate(seq.freqs.begin(), seq.freqs.end(), 0);
-                term_occurrence_counts.push_back(term_occurrence_count);
-                term_posting_counts.push_back(seq.docs.size());
-                term_id += 1;
-                progress.update(1);
-            }
+            auto term_id = m_term_posting_counts.size();
+            m_term_occurrence_counts.push_back(
+                std::accumulate(seq.freqs.begin(), seq.freqs.end(), std::uint64_t(0)));
+            m_term_posting_counts.push_back(seq.docs.size());
+            auto v = m_block_wand_builder.add_sequence(
+                seq, m_doc_lens, m_avg_len, m_scorer->term_scorer(term_id), m_block_size);
+            m_max_term_weight.push_back(v);
+            m_index_max_term_weight = std::max(m_index_max_term_weight, v);
         }
-        m_doc_lens.steal(doc_lens);
-        m_term_occurrence_counts.steal(term_occurrence_counts);
-        m_term_posting_counts.steal(term_posting_counts);
 
-        auto scorer = scorer::from_params(scorer_params, *this);
+        void build(wand_data& wdata)
         {
-            pisa::progress progress("Storing score upper bounds", coll.size());
-            size_t term_id = 0;
-            size_t new_term_id = 0;
-            for (auto const& seq: coll) {
-                if (terms_to_drop.find(term_id) != terms_to_drop.end()) {
-                    progress.update(1);
-                    term_id += 1;
-                    continue;
-                }
-                auto v = builder.add_sequence(
-                    seq, coll, doc_lens, m_avg_len, scorer->term_scorer(new_term_id), block_size);
-                max_term_weight.push_back(v);
-                m_index_max_term_weight = std::max(m_index_max_term_weight, v);
-                term_id += 1;
-                new_term_id += 1;
-                progress.update(1);
-            }
-            if (is_quantized) {
+            if (m_is_quantized) {
                 LinearQuantizer quantizer(
                     m_index_max_term_weight, configuration::get().quantization_bits);
-                for (auto&& w: max_term_weight) {
+                for (auto&& w: m_max_term_weight) {
                     w = quantizer(w);
                 }
-                builder.quantize_block_max_term_weights(m_index_max_term_weight);
+                m_block_wand_builder.quantize_block_max_term_weights(m_index_max_term_weight);
+            }
+            m_block_wand_builder.build(wdata.m_block_wand);
+            wdata.m_num_docs = m_num_docs;
+            wdata.m_avg_len = m_avg_len;
+            wdata.m_collection_len = m_collection_len;
+            wdata.m_index_max_term_weight = m_index_max_term_weight;
+            wdata.m_doc_lens.steal(m_doc_lens);
+            wdata.m_term_occurrence_counts.steal(m_term_occurrence_counts);
+            wdata.m_term_posting_counts.steal(m_term_posting_counts);
+            wdata.m_max_term_weight.steal(m_max_term_weight);
+        }
+
+        // Statistics of the terms added so far, read by scorers.
+        float norm_len(uint64_t doc_id) const { return m_doc_lens[doc_id] / m_avg_len; }
+        size_t doc_len(uint64_t doc_id) const { return m_doc_lens[doc_id]; }
+        size_t term_occurrence_count(uint64_t term_id) const
+        {
+            return m_term_occurrence_counts[term_id];
+        }
+        size_t term_posting_count(uint64_t term_id) const
+        {
+            return m_term_posting_counts[term_id];
+        }
+        size_t num_docs() const { return m_num_docs; }
+        float avg_len() const { return m_avg_len; }
+        uint64_t collection_len() const { return m_collection_len; }
+
+      private:
+        uint64_t m_num_docs;
+        float m_avg_len = 0;
+        uint64_t m_collection_len = 0;
+        float m_index_max_term_weight = 0;
+        std::vector<uint32_t> m_doc_lens;
+        std::vector<uint32_t> m_term_occurrence_counts;
+        std::vector<uint32_t> m_term_posting_counts;
+        std::vector<float> m_max_term_weight;
+        BlockSize m_block_size;
+        bool m_is_quantized;
+        global_parameters m_params;
+        typename block_wand_type::builder m_block_wand_builder;
+        std::unique_ptr<index_scorer<builder>> m_scorer;
+    };
+
+    template <typename LengthsIterator>
+    wand_data(
+        LengthsIterator len_it,
+        uint64_t num_docs,
+        binary_freq_collection const& coll,
+        const ScorerParams& scorer_params,
+        BlockSize block_size,
+        bool is_quantized,
+        std::unordered_set<size_t> const& terms_to_drop)
+    {
+        spdlog::info("Reading sizes...");
+        std::vector<uint32_t> doc_lens(len_it, std::next(len_it, num_docs));
+        builder builder(std::move(doc_lens), scorer_params, std::move(block_size), is_quantized);
+        pisa::progress progress("Storing score upper bounds", coll.size());
+        size_t term_id = 0;
+        for (auto const& seq: coll) {
+            if (terms_to_drop.find(term_id) == terms_to_drop.end()) {
+                builder.add_posting_list(seq);
             }
+            term_id += 1;
+            progress.update(1);
         }
-        builder.build(m_block_wand);
-        m_max_term_weight.steal(max_term_weight);
+        builder.build(*this);
     }
 
     float norm_len(uint64_t doc_id) const { return m_doc_lens[doc_id] / m_avg_len; }
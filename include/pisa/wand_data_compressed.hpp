@@ -96,11 +96,11 @@ class wand_data_compressed {
   public:
     class builder {
       public:
-        builder(binary_freq_collection const& coll, global_parameters const& params)
+        builder(uint64_t num_docs, global_parameters const& params)
             : total_elements(0),
               total_blocks(0),
               params(params),
-              compressor_builder(coll.num_docs(), params)
+              compressor_builder(num_docs, params)
         {
             spdlog::info("Storing max weight for each list and for each block...");
         }
@@ -108,16 +108,12 @@ class wand_data_compressed {
         template <typename Scorer>
         float add_sequence(
             binary_freq_collection::sequence const& seq,
-            binary_freq_collection const& coll,
             std::vector<uint32_t> const& doc_lens,
             float avg_len,
             Scorer scorer,
             BlockSize block_size)
         {
-            auto t = block_size.type() == typeid(FixedBlock)
-                ? static_block_partition(seq, scorer, boost::get<FixedBlock>(block_size).size)
-                : variable_block_partition(
-                    coll, seq, scorer, boost::get<VariableBlock>(block_size).lambda);
+            auto t = block_partition(seq, scorer, block_size);
 
             float max_score = *(std::max_element(t.second.begin(), t.second.end()));
             max_term_weight.push_back(max_score);
@@ -15,6 +15,9 @@ namespace pisa {
 template <size_t range_size = 128, size_t min_list_lenght = 1024>
 class wand_data_range {
   public:
+    /// Number of consecutive docids covered by a single range.
+    [[nodiscard]] constexpr static auto range_length() -> std::size_t { return range_size; }
+
     template <typename List, typename Fn>
     void for_each_posting(List& list, Fn func) const
     {
@@ -35,29 +38,50 @@ class wand_data_range {
         return block_max_scores;
     };
 
+    /// Computes the block-max scores of `list` only for the ranges that contain at least one
+    /// posting, as pairs of range number and score, in increasing order of ranges.
+    template <typename List, typename Fn>
+    auto compute_sparse_block_max_scores(List& list, Fn scorer) const
+    {
+        std::vector<std::pair<uint32_t, float>> block_max_scores;
+        for_each_posting(list, [&](auto docid, auto freq) {
+            auto range = static_cast<uint32_t>(docid / range_size);
+            float score = scorer(docid, freq);
+            if (block_max_scores.empty() || block_max_scores.back().first != range) {
+                block_max_scores.emplace_back(range, score);
+            } else {
+                block_max_scores.back().second = std::max(block_max_scores.back().second, score);
+            }
+        });
+        return block_max_scores;
+    }
+
+    /// Returns `true` if the block-max scores of term `i` were precomputed at build time,
+    /// which is the case only for lists of at least `min_list_lenght` postings.
+    [[nodiscard]] auto has_block_max_scores(uint32_t i) const -> bool
+    {
+        return m_blocks_start[i + 1] > m_blocks_start[i];
+    }
+
     class builder {
       public:
-        builder(binary_freq_collection const& coll, [[maybe_unused]] global_parameters const& params)
-            : blocks_num(ceil_div(coll.num_docs(), range_size)),
+        builder(uint64_t num_docs, [[maybe_unused]] global_parameters const& params)
+            : blocks_num(ceil_div(num_docs, range_size)),
               total_elements(0),
               blocks_start{0},
               block_max_term_weight{}
         {
-            auto posting_lists = std::distance(coll.begin(), coll.end());
             spdlog::info("Storing max weight for each list and for each block...");
             spdlog::info(
-                "Range size: {}. Number of docs: {}."
-                "Blocks per posting list: {}. Posting lists: {}.",
+                "Range size: {}. Number of docs: {}. Blocks per posting list: {}.",
                 range_size,
-                coll.num_docs(),
-                blocks_num,
-                posting_lists);
+                num_docs,
+                blocks_num);
         }
 
         template <typename Scorer>
         float add_sequence(
             binary_freq_collection::sequence const& term_seq,
-            binary_freq_collection const& coll,
             std::vector<uint32_t> const& doc_lens,
             float avg_len,
             Scorer scorer,
@@ -19,9 +19,9 @@ class wand_data_raw {
 
     class builder {
       public:
-        builder(binary_freq_collection const& coll, global_parameters const& params)
+        builder(uint64_t num_docs, global_parameters const& params)
         {
-            (void)coll;
+            (void)num_docs;
             (void)params;
             spdlog::info("Storing max weight for each list and for each block...");
             total_elements = 0;
@@ -33,16 +33,12 @@ class wand_data_raw {
         template <typename Scorer>
         float add_sequence(
             binary_freq_collection::sequence const& seq,
-            binary_freq_collection const& coll,
             std::vector<uint32_t> const& doc_lens,
             float avg_len,
             Scorer scorer,
             BlockSize block_size)
         {
-            auto t = block_size.type() == typeid(FixedBlock)
-                ? static_block_partition(seq, scorer, boost::get<FixedBlock>(block_size).size)
-                : variable_block_partition(
-                    coll, seq, scorer, boost::get<VariableBlock>(block_size).lambda);
+            auto t = block_partition(seq, scorer, block_size);
 
             block_max_term_weight.insert(
                 block_max_term_weight.end(), t.second.begin(), t.second.end());
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cmath>
+#include <optional>
+
 #include "boost/variant.hpp"
 
 #include "binary_freq_collection.hpp"
@@ -18,7 +21,15 @@ struct VariableBlock {
     explicit VariableBlock(const float in_lambda) : lambda(in_lambda) {}
 };
 
-using BlockSize = boost::variant<FixedBlock, VariableBlock>;
+/// Variable blocks computed by the score-optimal partitioning, with the cost of a block
+/// chosen per list such that the list has at most as many blocks as it would have with
+/// fixed blocks of `size` postings.
+struct OptimalBlock {
+    uint64_t size;
+    explicit OptimalBlock(const uint64_t in_size) : size(in_size) {}
+};
+
+using BlockSize = boost::variant<FixedBlock, VariableBlock, OptimalBlock>;
 
 template <typename Scorer>
 std::pair<std::vector<uint32_t>, std::vector<float>> static_block_partition(
@@ -55,7 +66,6 @@ std::pair<std::vector<uint32_t>, std::vector<float>> static_block_partition(
 
 template <typename Scorer>
 std::pair<std::vector<uint32_t>, std::vector<float>> variable_block_partition(
-    binary_freq_collection const& coll,
     binary_freq_collection::sequence const& seq,
     Scorer scorer,
     const float lambda,
@@ -82,4 +92,87 @@ std::pair<std::vector<uint32_t>, std::vector<float>> variable_block_partition(
     return std::make_pair(p.docids, p.max_values);
 }
 
+/// Partitions a posting list with `score_opt_partition` into at most
+/// `ceil(size / block_size)` blocks.
+///
+/// Unlike `variable_block_partition`, the fixed cost of a block (lambda) is not given
+/// but searched for each list, such that the score-optimal blocks fill up the same block
+/// budget as fixed-size blocks. This way, the blocks follow the score distribution
+/// (long blocks over low-scoring regions, short ones around high scores) without
+/// increasing the size of the block-max data.
+template <typename Scorer>
+std::pair<std::vector<uint32_t>, std::vector<float>> optimal_block_partition(
+    binary_freq_collection::sequence const& seq,
+    Scorer scorer,
+    const uint64_t block_size,
+    std::size_t max_iterations = 16,
+    double eps1 = 0.01,
+    double eps2 = 0.4)
+{
+    using doc_score_t = std::pair<uint64_t, float>;
+    std::vector<doc_score_t> doc_score;
+    doc_score.reserve(seq.docs.size());
+    std::transform(
+        seq.docs.begin(),
+        seq.docs.end(),
+        seq.freqs.begin(),
+        std::back_inserter(doc_score),
+        [&](const uint64_t& doc, const uint64_t& freq) -> doc_score_t {
+            return {doc, scorer(doc, freq)};
+        });
+
+    auto const max_blocks = ceil_div(doc_score.size(), block_size);
+    if (max_blocks <= 1) {
+        return static_block_partition(seq, scorer, block_size);
+    }
+
+    // A single block costs at most `size * max_score`, so any lambda above it yields
+    // one block; the lower end must stay positive for the partitioning to be defined.
+    float max_score = 0;
+    for (auto&& entry: doc_score) {
+        max_score = std::max(max_score, entry.second);
+    }
+    if (max_score <= 0) {
+        return static_block_partition(seq, scorer, block_size);
+    }
+    double low = max_score * 1e-4;
+    double high = max_score * doc_score.size();
+
+    std::optional<score_opt_partition> best;
+    for (std::size_t iteration = 0; iteration < max_iterations; ++iteration) {
+        auto lambda = std::sqrt(low * high);
+        auto p = score_opt_partition(doc_score.begin(), 0, doc_score.size(), eps1, eps2, lambda);
+        if (p.docids.size() > max_blocks) {
+            low = lambda;
+        } else {
+            high = lambda;
+            bool const close_enough = 10 * p.docids.size() >= 9 * max_blocks;
+            best = std::move(p);
+            if (close_enough) {
+                break;
+            }
+        }
+    }
+    if (not best) {
+        return static_block_partition(seq, scorer, block_size);
+    }
+    return std::make_pair(std::move(best->docids), std::move(best->max_values));
+}
+
+/// Partitions a posting list into blocks according to `block_size`.
+template <typename Scorer>
+std::pair<std::vector<uint32_t>, std::vector<float>> block_partition(
+    binary_freq_collection::sequence const& seq,
+    Scorer scorer,
+    BlockSize const& block_size)
+{
+    if (auto const* fixed = boost::get<FixedBlock>(&block_size); fixed != nullptr) {
+        return static_block_partition(seq, scorer, fixed->size);
+    }
+    if (auto const* optimal = boost::get<OptimalBlock>(&block_size); optimal != nullptr) {
+        return optimal_block_partition(seq, scorer, optimal->size);
+    }
+    return variable_block_partition(seq, scorer, boost::get<VariableBlock>(block_size).lambda);
+}
+
 }  // namespace pisa
@@ -0,0 +1,122 @@
+#include "index_header.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include <boost/filesystem.hpp>
+#include <tbb/parallel_for.h>
+
+namespace pisa {
+
+namespace {
+
+    /// Device, inode, size, and modification time in nanoseconds of `file`, written as the first
+    /// line of its record of verified sections, or `nullopt` if they cannot be read.
+    [[nodiscard]] auto file_identity(boost::filesystem::path const& file)
+        -> std::optional<std::string>
+    {
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+        struct stat status {};
+        if (file.empty() || stat(file.c_str(), &status) != 0) {
+            return std::nullopt;
+        }
+    #if defined(__APPLE__)
+        auto const& mtime = status.st_mtimespec;
+    #else
+        auto const& mtime = status.st_mtim;
+    #endif
+        return fmt::format(
+            "{} {} {} {}.{:09}",
+            static_cast<uint64_t>(status.st_dev),
+            static_cast<uint64_t>(status.st_ino),
+            static_cast<uint64_t>(status.st_size),
+            static_cast<int64_t>(mtime.tv_sec),
+            static_cast<int64_t>(mtime.tv_nsec));
+#else
+        static_cast<void>(file);
+        return std::nullopt;
+#endif
+    }
+
+}  // namespace
+
+auto read_verified_checksums(boost::filesystem::path const& index_file) -> std::vector<uint64_t>
+{
+    auto identity = file_identity(index_file);
+    if (not identity) {
+        return {};
+    }
+    std::ifstream is(verified_sections_path(index_file).string());
+    std::string recorded;
+    if (not std::getline(is, recorded) || recorded != *identity) {
+        return {};
+    }
+    std::vector<uint64_t> checksums;
+    uint64_t checksum = 0;
+    while (is >> std::hex >> checksum) {
+        checksums.push_back(checksum);
+    }
+    return checksums;
+}
+
+void record_verified_checksums(
+    boost::filesystem::path const& index_file, gsl::span<uint64_t const> checksums)
+{
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+    auto identity = file_identity(index_file);
+    if (not identity) {
+        return;
+    }
+    auto path = verified_sections_path(index_file).string();
+    std::string tmp = path + ".XXXXXX";
+    int fd = mkstemp(tmp.data());
+    if (fd < 0) {
+        return;
+    }
+    std::string contents = *identity + '\n';
+    for (auto checksum: checksums) {
+        contents += fmt::format("{:x}\n", checksum);
+    }
+    bool written = write(fd, contents.data(), contents.size())
+        == static_cast<ssize_t>(contents.size());
+    written &= close(fd) == 0;
+    if (not written || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+    }
+#else
+    static_cast<void>(index_file);
+    static_cast<void>(checksums);
+#endif
+}
+
+void verify_sections(IndexHeader const& header, MemorySource const& source)
+{
+    auto sections = header.sections();
+    auto recorded = read_verified_checksums(source.file());
+    auto known_good = [&](auto const& section) {
+        return std::find(recorded.begin(), recorded.end(), section.checksum) != recorded.end();
+    };
+    tbb::parallel_for(std::size_t(0), sections.size(), [&](auto pos) {
+        auto const& section = sections[pos];
+        if (known_good(section)) {
+            source.will_need(section.offset, section.bytes);
+        } else if (not section.verify(source.data())) {
+            throw std::runtime_error(
+                fmt::format("Checksum mismatch in index section {}", section.name.data()));
+        }
+    });
+    if (not std::all_of(sections.begin(), sections.end(), known_good)) {
+        std::vector<uint64_t> checksums(sections.size());
+        std::transform(sections.begin(), sections.end(), checksums.begin(), [](auto const& s) {
+            return s.checksum;
+        });
+        record_verified_checksums(source.file(), checksums);
+    }
+}
+
+}  // namespace pisa
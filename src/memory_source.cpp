@@ -1,13 +1,69 @@
 #include "memory_source.hpp"
 
+#include <cstdint>
 #include <exception>
 
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
 #include "io.hpp"
 
 namespace pisa {
 
 constexpr std::string_view EMPTY_MEMORY = "Empty memory source";
 
+namespace {
+
+    /// Reads a byte of every page, so that they are in memory.
+    void touch_pages(char const* data, std::size_t size)
+    {
+        std::size_t page_size = 4096;
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+        page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+        volatile char byte;
+        for (std::size_t pos = 0; pos < size; pos += page_size) {
+            byte = data[pos];
+        }
+        (void)byte;
+    }
+
+    /// Applies `options` to the mapping of `size` bytes at `data`.
+    ///
+    /// Advice the kernel does not support is ignored, as it only affects performance. Populating
+    /// is done with `MADV_POPULATE_READ` where available, and by reading the pages otherwise.
+    void apply_map_options(char const* data, std::size_t size, MapOptions const& options)
+    {
+        if (size == 0) {
+            return;
+        }
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+        auto* addr = const_cast<char*>(data);
+        switch (options.advice) {
+        case MapAdvice::Normal: break;
+        case MapAdvice::Random: posix_madvise(addr, size, POSIX_MADV_RANDOM); break;
+        case MapAdvice::Sequential: posix_madvise(addr, size, POSIX_MADV_SEQUENTIAL); break;
+        }
+    #if defined(MADV_HUGEPAGE)
+        if (options.huge_pages) {
+            madvise(addr, size, MADV_HUGEPAGE);
+        }
+    #endif
+    #if defined(MADV_POPULATE_READ)
+        if (options.populate && madvise(addr, size, MADV_POPULATE_READ) == 0) {
+            return;
+        }
+    #endif
+#endif
+        if (options.populate) {
+            touch_pages(data, size);
+        }
+    }
+
+}  // namespace
+
 auto MemorySource::from_vector(std::vector<char> vec) -> MemorySource
 {
     return MemorySource(std::move(vec));
@@ -18,17 +74,22 @@ auto MemorySource::from_span(gsl::span<char> span) -> MemorySource
     return MemorySource(span);
 }
 
-auto MemorySource::mapped_file(std::string const& file) -> MemorySource
+auto MemorySource::mapped_file(std::string const& file, MapOptions const& options) -> MemorySource
 {
-    return MemorySource::mapped_file(io::resolve_path(file));
+    return MemorySource::mapped_file(io::resolve_path(file), options);
 }
 
-auto MemorySource::mapped_file(boost::filesystem::path file) -> MemorySource
+auto MemorySource::mapped_file(boost::filesystem::path file, MapOptions const& options)
+    -> MemorySource
 {
     if (not boost::filesystem::exists(file)) {
         throw io::NoSuchFile(file.string());
     }
-    return MemorySource(mio::mmap_source(file.string().c_str()));
+    mio::mmap_source mapping(file.string().c_str());
+    apply_map_options(mapping.data(), mapping.size(), options);
+    MemorySource source(std::move(mapping));
+    source.m_file = std::move(file);
+    return source;
 }
 
 auto MemorySource::is_mapped() noexcept -> bool
@@ -90,4 +151,23 @@ auto MemorySource::subspan(size_type offset, size_type size) const -> gsl::span<
     return span().subspan(offset, size);
 }
 
+void MemorySource::will_need(size_type offset, size_type size) const
+{
+    auto memory = subspan(offset, size);
+    if (memory.empty()) {
+        return;
+    }
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+    auto page_size = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+    auto begin = reinterpret_cast<std::uintptr_t>(memory.data()) / page_size * page_size;
+    auto end = reinterpret_cast<std::uintptr_t>(memory.data() + memory.size());
+    posix_madvise(reinterpret_cast<void*>(begin), end - begin, POSIX_MADV_WILLNEED);
+#endif
+}
+
+auto MemorySource::file() const noexcept -> boost::filesystem::path const&
+{
+    return m_file;
+}
+
 }  // namespace pisa
@@ -0,0 +1,89 @@
+#include "pinned_memory.hpp"
+
+#include <new>
+#include <utility>
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+    #include <sys/mman.h>
+    #define PISA_HAS_MMAN
+#endif
+
+namespace pisa {
+
+PinnedMemory::PinnedMemory(std::size_t size) : m_size(size)
+{
+    if (size == 0) {
+        return;
+    }
+#if defined(PISA_HAS_MMAN)
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    m_data = static_cast<char*>(addr);
+    #if defined(MADV_HUGEPAGE)
+    // Must precede locking, which faults the pages in.
+    madvise(addr, size, MADV_HUGEPAGE);
+    #endif
+    m_locked = mlock(addr, size) == 0;
+#else
+    m_data = new char[size];
+#endif
+}
+
+PinnedMemory::PinnedMemory(PinnedMemory&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_locked(std::exchange(other.m_locked, false))
+{}
+
+PinnedMemory& PinnedMemory::operator=(PinnedMemory&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_locked = std::exchange(other.m_locked, false);
+    }
+    return *this;
+}
+
+PinnedMemory::~PinnedMemory()
+{
+    release();
+}
+
+void PinnedMemory::release() noexcept
+{
+    if (m_data == nullptr) {
+        return;
+    }
+#if defined(PISA_HAS_MMAN)
+    munmap(m_data, m_size);
+#else
+    delete[] m_data;
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_locked = false;
+}
+
+auto lock_memory(gsl::span<char const> memory) -> bool
+{
+#if defined(PISA_HAS_MMAN)
+    return memory.empty() || mlock(memory.data(), memory.size()) == 0;
+#else
+    return false;
+#endif
+}
+
+void unlock_memory(gsl::span<char const> memory)
+{
+#if defined(PISA_HAS_MMAN)
+    if (not memory.empty()) {
+        munlock(memory.data(), memory.size());
+    }
+#endif
+}
+
+}  // namespace pisa
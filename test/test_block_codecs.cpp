@@ -12,6 +12,7 @@
 #include "codec/simple8b.hpp"
 #include "codec/streamvbyte.hpp"
 #include "codec/varintgb.hpp"
+#include "codec/widebp.hpp"
 
 #include "test_common.hpp"
 
@@ -54,4 +55,40 @@ TEST_CASE("block_codecs")
     test_block_codec<pisa::simple8b_block>();
     test_block_codec<pisa::simdbp_block>();
     test_block_codec<pisa::simple16_block>();
+    test_block_codec<pisa::widebp256_block>();
+    test_block_codec<pisa::widebp512_block>();
+}
+
+template <std::size_t Lanes>
+void test_widebp_unpackers()
+{
+    using namespace pisa::detail::widebp;
+    auto scalar = unpackers<Lanes>(isa::scalar);
+    for (auto target: {isa::avx2, isa::avx512}) {
+        if (target > supported_isa()) {
+            continue;
+        }
+        auto kernels = unpackers<Lanes>(target);
+        for (uint32_t b = 0; b <= 32; ++b) {
+            std::vector<uint32_t> values(32 * Lanes);
+            std::generate(values.begin(), values.end(), [b]() {
+                return static_cast<uint32_t>(((uint64_t)rand() << 16 ^ rand()) & mask(b));
+            });
+            std::vector<uint32_t> packed(b * Lanes);
+            pack<Lanes>(values.data(), packed.data(), b);
+
+            std::vector<uint32_t> expected(values.size());
+            std::vector<uint32_t> decoded(values.size());
+            scalar[b](packed.data(), expected.data());
+            kernels[b](packed.data(), decoded.data());
+            REQUIRE(expected == values);
+            REQUIRE(decoded == values);
+        }
+    }
+}
+
+TEST_CASE("widebp_unpackers")
+{
+    test_widebp_unpackers<8>();
+    test_widebp_unpackers<16>();
 }
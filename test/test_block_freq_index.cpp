@@ -11,6 +11,7 @@
 #include "codec/simple8b.hpp"
 #include "codec/streamvbyte.hpp"
 #include "codec/varintgb.hpp"
+#include "codec/widebp.hpp"
 #include "temporary_directory.hpp"
 
 #include "block_freq_index.hpp"
@@ -76,4 +77,6 @@ TEST_CASE("block_freq_index")
     test_block_freq_index<pisa::simple8b_block>();
     test_block_freq_index<pisa::simple16_block>();
     test_block_freq_index<pisa::simdbp_block>();
+    test_block_freq_index<pisa::widebp256_block>();
+    test_block_freq_index<pisa::widebp512_block>();
 }
@@ -11,6 +11,7 @@
 #include "codec/simple8b.hpp"
 #include "codec/streamvbyte.hpp"
 #include "codec/varintgb.hpp"
+#include "codec/widebp.hpp"
 
 #include "block_posting_list.hpp"
 
@@ -40,6 +41,18 @@ void test_block_posting_list_ops(
         MY_REQUIRE_EQUAL(docs[i], e.docid(), "i = " << i << " size = " << n);
         MY_REQUIRE_EQUAL(freqs[i], e.freq(), "i = " << i << " size = " << n);
     }
+    for (size_t skip: {7, 301, 4099}) {
+        e.reset();
+        for (size_t i = 0; i < n; i += skip) {
+            e.next_geq(docs[i] - (i > 0 && docs[i - 1] + 1 < docs[i] ? 1 : 0));
+            MY_REQUIRE_EQUAL(docs[i], e.docid(), "i = " << i << " size = " << n);
+        }
+    }
+    e.reset();
+    for (size_t i = 0; i < n; i += 5) {
+        e.move(i);
+        MY_REQUIRE_EQUAL(docs[i], e.docid(), "i = " << i << " size = " << n);
+    }
     e.reset();
     e.next_geq(docs.back() + 1);
     REQUIRE(universe == e.docid());
@@ -71,6 +84,8 @@ void test_block_posting_list()
         posting_list_type::write(data, n, docs.begin(), freqs.begin());
 
         test_block_posting_list_ops<posting_list_type>(data.data(), n, universe, docs, freqs);
+        test_block_posting_list_ops<pisa::block_posting_list<BlockCodec, false, true>>(
+            data.data(), n, universe, docs, freqs);
     }
 }
 
@@ -116,6 +131,8 @@ TEST_CASE("block_posting_list")
     test_block_posting_list<pisa::simple8b_block>();
     test_block_posting_list<pisa::simple16_block>();
     test_block_posting_list<pisa::simdbp_block>();
+    test_block_posting_list<pisa::widebp256_block>();
+    test_block_posting_list<pisa::widebp512_block>();
 }
 TEST_CASE("block_posting_list_reordering")
 {
@@ -0,0 +1,113 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "binary_freq_collection.hpp"
+#include "build_index.hpp"
+#include "compress.hpp"
+#include "index_types.hpp"
+#include "invert.hpp"
+#include "io.hpp"
+#include "pisa_config.hpp"
+#include "temporary_directory.hpp"
+#include "wand_data.hpp"
+
+using namespace pisa;
+
+/// Writes the forward index of `collection` to `basename`, each term repeated by its frequency.
+void write_forward_index(binary_freq_collection const& collection, std::string const& basename)
+{
+    std::vector<std::vector<uint32_t>> documents(collection.num_docs());
+    uint32_t term_id = 0;
+    for (auto const& sequence: collection) {
+        auto freq = sequence.freqs.begin();
+        for (auto docid: sequence.docs) {
+            documents[docid].insert(documents[docid].end(), *freq++, term_id);
+        }
+        ++term_id;
+    }
+    std::ofstream os(basename);
+    auto write_sequence = [&](std::vector<uint32_t> const& sequence) {
+        auto size = static_cast<uint32_t>(sequence.size());
+        os.write(reinterpret_cast<char const*>(&size), sizeof(size));
+        os.write(reinterpret_cast<char const*>(sequence.data()), size * sizeof(uint32_t));
+    };
+    write_sequence({static_cast<uint32_t>(documents.size())});
+    for (auto const& document: documents) {
+        write_sequence(document);
+    }
+}
+
+template <typename Wand>
+void test_build_index(std::string const& scorer_name, BlockSize block_size, bool quantize)
+{
+    Temporary_Directory tmpdir;
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    auto forward_basename = (tmpdir.path() / "fwd").string();
+    write_forward_index(collection, forward_basename);
+    auto term_count = static_cast<uint32_t>(collection.size());
+    auto scorer_params = ScorerParams(scorer_name);
+
+    auto inverted_basename = (tmpdir.path() / "inv").string();
+    auto expected_index = (tmpdir.path() / "expected.index").string();
+    auto expected_wand = (tmpdir.path() / "expected.wand").string();
+    invert::invert_forward_index(forward_basename, inverted_basename, 1000, 2, term_count);
+    {
+        binary_freq_collection const inverted(inverted_basename.c_str());
+        binary_collection const sizes((inverted_basename + ".sizes").c_str());
+        Wand wdata(
+            sizes.begin()->begin(),
+            inverted.num_docs(),
+            inverted,
+            scorer_params,
+            block_size,
+            quantize,
+            {});
+        mapper::freeze(wdata, expected_wand.c_str());
+        compress_index_streaming<block_optpfor_index, Wand>(
+            inverted, global_parameters{}, expected_index, std::nullopt, false, "block_optpfor");
+    }
+
+    std::vector<std::optional<std::size_t>> memory_budgets{std::nullopt, std::size_t(1) << 24U};
+    for (std::size_t threads: {1, 3}) {
+        for (auto memory_budget: memory_budgets) {
+            CAPTURE(threads, memory_budget.has_value());
+            auto actual_index = (tmpdir.path() / "actual.index").string();
+            auto actual_wand = (tmpdir.path() / "actual.wand").string();
+            build_index<block_optpfor_index, Wand>(
+                forward_basename,
+                actual_index,
+                actual_wand,
+                "block_optpfor",
+                scorer_params,
+                block_size,
+                quantize,
+                1000,
+                threads,
+                term_count,
+                memory_budget);
+            REQUIRE(io::load_data(actual_index) == io::load_data(expected_index));
+            REQUIRE(io::load_data(actual_wand) == io::load_data(expected_wand));
+        }
+    }
+}
+
+TEST_CASE("Build index and WAND data in one pass", "[build_index]")
+{
+    SECTION("Raw") { test_build_index<wand_data<wand_data_raw>>("bm25", FixedBlock(64), false); }
+    SECTION("Quantized variable blocks")
+    {
+        test_build_index<wand_data<wand_data_raw>>("qld", VariableBlock(12.0), true);
+    }
+    SECTION("Compressed")
+    {
+        test_build_index<wand_data<wand_data_compressed<>>>("bm25", FixedBlock(64), false);
+    }
+    SECTION("Range")
+    {
+        test_build_index<wand_data<wand_data_range<128, 1024>>>("dph", FixedBlock(64), true);
+    }
+}
@@ -0,0 +1,126 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include "test_generic_sequence.hpp"
+
+#include "compress.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "temporary_directory.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace pisa;
+
+void write_sequence(std::ofstream& os, std::vector<uint32_t> const& seq)
+{
+    auto size = static_cast<uint32_t>(seq.size());
+    os.write(reinterpret_cast<char const*>(&size), sizeof(size));
+    os.write(reinterpret_cast<char const*>(seq.data()), seq.size() * sizeof(uint32_t));
+}
+
+/// Writes a collection of `num_terms` random posting lists, some of which are dense.
+void write_collection(std::string const& basename, uint32_t num_docs, std::size_t num_terms)
+{
+    std::ofstream docs(basename + ".docs", std::ios::binary);
+    std::ofstream freqs(basename + ".freqs", std::ios::binary);
+    write_sequence(docs, {num_docs});
+    for (std::size_t term = 0; term < num_terms; ++term) {
+        auto n = uint64_t(num_docs / (1.1 + double(rand()) / RAND_MAX * 100));
+        auto seq = random_sequence(num_docs, n, true);
+        write_sequence(docs, std::vector<uint32_t>(seq.begin(), seq.end()));
+        std::vector<uint32_t> term_freqs(n);
+        std::generate(term_freqs.begin(), term_freqs.end(), []() { return rand() % 10 + 1; });
+        write_sequence(freqs, term_freqs);
+    }
+}
+
+template <typename Index>
+void freeze_index(typename Index::builder& builder, std::string const& filename)
+{
+    Index index;
+    builder.build(index, "test");
+    mapper::freeze(index, filename.c_str());
+}
+
+template <typename Index>
+void test_add_posting_lists(binary_freq_collection const& input, Temporary_Directory& tmpdir)
+{
+    auto expected_path = (tmpdir.path() / "expected").string();
+    auto actual_path = (tmpdir.path() / "actual").string();
+    global_parameters params;
+    {
+        typename Index::builder builder(input.num_docs(), params);
+        for (auto const& plist: input) {
+            uint64_t freqs_sum =
+                std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+            builder.add_posting_list(
+                plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+        }
+        freeze_index<Index>(builder, expected_path);
+    }
+    // Small batches, so that lists are encoded while others are added.
+    for (std::size_t batch_postings: {1, 5000, 1000000}) {
+        typename Index::builder builder(input.num_docs(), params);
+        auto postings = add_posting_lists(
+            builder,
+            input,
+            posting_list_encoder<typename Index::builder, wand_data<wand_data_raw>>(
+                builder, nullptr),
+            batch_postings);
+        freeze_index<Index>(builder, actual_path);
+        CAPTURE(batch_postings);
+        REQUIRE(io::load_data(actual_path) == io::load_data(expected_path));
+
+        std::size_t expected_postings = 0;
+        for (auto const& plist: input) {
+            expected_postings += plist.docs.size();
+        }
+        REQUIRE(postings == expected_postings);
+    }
+}
+
+TEST_CASE("add_posting_lists")
+{
+    Temporary_Directory tmpdir;
+    auto basename = (tmpdir.path() / "collection").string();
+    write_collection(basename, 10000, 200);
+    binary_freq_collection input(basename.c_str());
+
+    test_add_posting_lists<block_optpfor_index>(input, tmpdir);
+    test_add_posting_lists<ef_index>(input, tmpdir);
+    test_add_posting_lists<pefopt_index>(input, tmpdir);
+    test_add_posting_lists<hybrid_optpfor_index>(input, tmpdir);
+}
+
+TEST_CASE("add_posting_lists_stream_builder")
+{
+    Temporary_Directory tmpdir;
+    auto basename = (tmpdir.path() / "collection").string();
+    write_collection(basename, 10000, 200);
+    binary_freq_collection input(basename.c_str());
+    auto expected_path = (tmpdir.path() / "expected").string();
+    auto actual_path = (tmpdir.path() / "actual").string();
+
+    block_simdbp_index::builder builder(input.num_docs(), global_parameters{});
+    for (auto const& plist: input) {
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+        builder.add_posting_list(
+            plist.docs.size(), plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+    }
+    freeze_index<block_simdbp_index>(builder, expected_path);
+
+    block_simdbp_index::stream_builder sbuilder(input.num_docs(), global_parameters{});
+    add_posting_lists(
+        sbuilder,
+        input,
+        posting_list_encoder<block_simdbp_index::stream_builder, wand_data<wand_data_raw>>(
+            sbuilder, nullptr),
+        1000);
+    sbuilder.build(actual_path, "test");
+    REQUIRE(io::load_data(actual_path) == io::load_data(expected_path));
+}
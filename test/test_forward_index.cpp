@@ -27,3 +27,64 @@ TEST_CASE("write_and_read")
         REQUIRE(std::equal(fwd[doc].begin(), fwd[doc].end(), fwd_read[doc].begin()));
     }
 }
+
+TEST_CASE("flat_forward_index")
+{
+    using namespace pisa;
+    std::string invind_input("test_data/test_collection");
+    auto fwd = forward_index::from_inverted_index(invind_input, 0, true);
+    auto uncompressed_fwd = forward_index::from_inverted_index(invind_input, 0, false);
+    bool compressed = GENERATE(false, true);
+    CAPTURE(compressed);
+    flat_forward_index flat(uncompressed_fwd, compressed);
+
+    REQUIRE(flat.size() == fwd.size());
+    REQUIRE(flat.term_count() == fwd.term_count());
+    REQUIRE(flat.compressed() == compressed);
+    std::vector<uint32_t> buffer;
+    for (uint32_t doc = 0; doc < fwd.size(); ++doc) {
+        auto expected = fwd.terms(doc);
+        REQUIRE(uncompressed_fwd.terms(doc) == expected);
+        REQUIRE(flat.term_count(doc) == expected.size());
+        auto terms = flat.terms(doc, buffer);
+        REQUIRE(std::vector<uint32_t>(terms.begin(), terms.end()) == expected);
+        std::vector<uint32_t> visited;
+        flat.for_each_term(doc, buffer, [&](auto term) { visited.push_back(term); });
+        REQUIRE(visited == expected);
+    }
+}
+
+TEST_CASE("flat_forward_index construction")
+{
+    using namespace pisa;
+    std::string invind_input("test_data/test_collection");
+    std::string fwdind_file("temp_collection");
+    bool compressed = GENERATE(false, true);
+    std::size_t min_len = GENERATE(0, 50);
+    CAPTURE(compressed, min_len);
+    auto fwd = forward_index::from_inverted_index(invind_input, min_len, compressed);
+    forward_index::write(fwd, fwdind_file);
+    flat_forward_index expected(fwd, compressed);
+
+    // Small batches exercise documents that straddle them.
+    auto direct = GENERATE(true, false);
+    auto batch_postings = GENERATE(std::size_t(1), std::size_t(1000), std::size_t(1) << 24U);
+    CAPTURE(direct, batch_postings);
+    auto flat = direct
+        ? flat_forward_index::from_inverted_index(invind_input, min_len, compressed, batch_postings)
+        : flat_forward_index::read(fwdind_file);
+
+    REQUIRE(flat.size() == expected.size());
+    REQUIRE(flat.term_count() == expected.term_count());
+    REQUIRE(flat.compressed() == compressed);
+    std::vector<uint32_t> expected_buffer;
+    std::vector<uint32_t> buffer;
+    for (uint32_t doc = 0; doc < flat.size(); ++doc) {
+        REQUIRE(flat.term_count(doc) == expected.term_count(doc));
+        auto expected_terms = expected.terms(doc, expected_buffer);
+        auto terms = flat.terms(doc, buffer);
+        REQUIRE(
+            std::vector<uint32_t>(terms.begin(), terms.end())
+            == std::vector<uint32_t>(expected_terms.begin(), expected_terms.end()));
+    }
+}
@@ -0,0 +1,98 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include "test_generic_sequence.hpp"
+
+#include "codec/block_codecs.hpp"
+#include "codec/simdbp.hpp"
+#include "codec/varintgb.hpp"
+
+#include "hybrid_freq_index.hpp"
+#include "mappable/mapper.hpp"
+#include "query/algorithm/and_query.hpp"
+#include "temporary_directory.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <vector>
+
+using vec_type = std::vector<uint64_t>;
+
+template <typename BlockCodec>
+void test_hybrid_freq_index()
+{
+    pisa::global_parameters params;
+    uint64_t universe = 20000;
+    using collection_type = pisa::hybrid_freq_index<BlockCodec>;
+    typename collection_type::builder b(universe, params, 0.1);
+
+    // Average gaps from 1 to 41, so that about half of the lists are dense.
+    std::vector<std::pair<vec_type, vec_type>> posting_lists(30);
+    for (auto& plist: posting_lists) {
+        double avg_gap = 1.0 + double(rand()) / RAND_MAX * 40;
+        auto n = uint64_t(universe / avg_gap);
+        plist.first = random_sequence(universe, n, true);
+        plist.second.resize(n);
+        std::generate(plist.second.begin(), plist.second.end(), []() { return (rand() % 256) + 1; });
+
+        b.add_posting_list(n, plist.first.begin(), plist.second.begin(), 0);
+    }
+
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "temp.bin").string();
+    {
+        collection_type coll;
+        b.build(coll);
+        pisa::mapper::freeze(coll, filename.c_str());
+    }
+
+    collection_type coll(pisa::MemorySource::mapped_file(filename));
+    for (size_t i = 0; i < posting_lists.size(); ++i) {
+        auto const& plist = posting_lists[i];
+        auto doc_enum = coll[i];
+        REQUIRE(plist.first.size() == doc_enum.size());
+        REQUIRE(doc_enum.dense() == (plist.first.size() > universe / 10));
+        for (size_t p = 0; p < plist.first.size(); ++p, doc_enum.next()) {
+            MY_REQUIRE_EQUAL(plist.first[p], doc_enum.docid(), "i = " << i << " p = " << p);
+            MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(), "i = " << i << " p = " << p);
+        }
+        REQUIRE(coll.num_docs() == doc_enum.docid());
+
+        doc_enum.reset();
+        for (uint64_t lower_bound = 0; lower_bound < universe; lower_bound += 1 + rand() % 300) {
+            lower_bound = std::max<uint64_t>(lower_bound, doc_enum.docid());
+            doc_enum.next_geq(lower_bound);
+            auto it = std::lower_bound(plist.first.begin(), plist.first.end(), lower_bound);
+            if (it == plist.first.end()) {
+                REQUIRE(coll.num_docs() == doc_enum.docid());
+                break;
+            }
+            auto pos = std::distance(plist.first.begin(), it);
+            MY_REQUIRE_EQUAL(*it, doc_enum.docid(), "i = " << i << " lb = " << lower_bound);
+            MY_REQUIRE_EQUAL(pos, doc_enum.position(), "i = " << i << " lb = " << lower_bound);
+            MY_REQUIRE_EQUAL(plist.second[pos], doc_enum.freq(), "i = " << i << " lb = " << lower_bound);
+        }
+    }
+
+    for (size_t i = 0; i + 1 < posting_lists.size(); ++i) {
+        vec_type expected;
+        std::set_intersection(
+            posting_lists[i].first.begin(),
+            posting_lists[i].first.end(),
+            posting_lists[i + 1].first.begin(),
+            posting_lists[i + 1].first.end(),
+            std::back_inserter(expected));
+        std::vector<typename collection_type::document_enumerator> cursors{coll[i], coll[i + 1]};
+        auto results = pisa::and_query{}(cursors, coll.num_docs());
+        REQUIRE(vec_type(results.begin(), results.end()) == expected);
+    }
+}
+
+TEST_CASE("hybrid_freq_index")
+{
+    test_hybrid_freq_index<pisa::optpfor_block>();
+    test_hybrid_freq_index<pisa::interpolative_block>();
+    test_hybrid_freq_index<pisa::varintgb_block>();
+    test_hybrid_freq_index<pisa::simdbp_block>();
+}
@@ -0,0 +1,159 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include "test_generic_sequence.hpp"
+
+#include "accumulator/simple_accumulator.hpp"
+#include "codec/block_codecs.hpp"
+#include "codec/maskedvbyte.hpp"
+#include "codec/qmx.hpp"
+#include "codec/simdbp.hpp"
+#include "codec/simple16.hpp"
+#include "codec/simple8b.hpp"
+#include "codec/streamvbyte.hpp"
+#include "codec/varintgb.hpp"
+#include "codec/widebp.hpp"
+#include "cursor/impact_cursor.hpp"
+#include "impact_ordered_index.hpp"
+#include "mappable/mapper.hpp"
+#include "query/algorithm/saat_query.hpp"
+#include "temporary_directory.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <vector>
+
+using vec_type = std::vector<uint64_t>;
+
+std::vector<std::pair<vec_type, vec_type>> random_impact_lists(uint64_t universe, std::size_t terms)
+{
+    std::vector<std::pair<vec_type, vec_type>> posting_lists(terms);
+    for (auto& plist: posting_lists) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 10;
+        auto n = uint64_t(universe / avg_gap);
+        plist.first = random_sequence(universe, n, true);
+        plist.second.resize(n);
+        std::generate(plist.second.begin(), plist.second.end(), []() { return rand() % 16; });
+    }
+    return posting_lists;
+}
+
+template <typename BlockCodec>
+void test_impact_ordered_index()
+{
+    pisa::global_parameters params;
+    uint64_t universe = 20000;
+    using collection_type = pisa::impact_ordered_index<BlockCodec>;
+    typename collection_type::builder b(universe, params);
+
+    auto posting_lists = random_impact_lists(universe, 30);
+    for (auto const& plist: posting_lists) {
+        b.add_posting_list(plist.first.size(), plist.first.begin(), plist.second.begin());
+    }
+
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "temp.bin").string();
+    {
+        collection_type coll;
+        b.build(coll);
+        pisa::mapper::freeze(coll, filename.c_str());
+    }
+
+    collection_type coll(pisa::MemorySource::mapped_file(filename));
+    REQUIRE(coll.size() == posting_lists.size());
+    REQUIRE(coll.num_docs() == universe);
+    for (size_t i = 0; i < posting_lists.size(); ++i) {
+        auto const& plist = posting_lists[i];
+        std::vector<std::pair<uint64_t, uint64_t>> expected;
+        for (size_t p = 0; p < plist.first.size(); ++p) {
+            if (plist.second[p] > 0) {
+                expected.emplace_back(plist.first[p], plist.second[p]);
+            }
+        }
+        std::vector<std::pair<uint64_t, uint64_t>> actual;
+        auto segments = coll[i];
+        REQUIRE(segments.size() == expected.size());
+        uint32_t prev_impact = std::numeric_limits<uint32_t>::max();
+        while (not segments.empty()) {
+            auto impact = segments.impact();
+            REQUIRE(impact < prev_impact);
+            prev_impact = impact;
+            auto size = actual.size();
+            segments.consume_segment([&](auto docid) { actual.emplace_back(docid, impact); });
+            REQUIRE(std::is_sorted(std::next(actual.begin(), size), actual.end()));
+        }
+        std::sort(actual.begin(), actual.end());
+        REQUIRE(actual == expected);
+    }
+}
+
+TEST_CASE("impact_ordered_index")
+{
+    test_impact_ordered_index<pisa::optpfor_block>();
+    test_impact_ordered_index<pisa::varint_G8IU_block>();
+    test_impact_ordered_index<pisa::streamvbyte_block>();
+    test_impact_ordered_index<pisa::maskedvbyte_block>();
+    test_impact_ordered_index<pisa::varintgb_block>();
+    test_impact_ordered_index<pisa::interpolative_block>();
+    test_impact_ordered_index<pisa::qmx_block>();
+    test_impact_ordered_index<pisa::simple8b_block>();
+    test_impact_ordered_index<pisa::simple16_block>();
+    test_impact_ordered_index<pisa::simdbp_block>();
+    test_impact_ordered_index<pisa::widebp256_block>();
+    test_impact_ordered_index<pisa::widebp512_block>();
+}
+
+TEST_CASE("Score-at-a-time query")
+{
+    pisa::global_parameters params;
+    uint64_t universe = 20000;
+    using collection_type = pisa::impact_ordered_index<pisa::simdbp_block>;
+    typename collection_type::builder b(universe, params);
+    auto posting_lists = random_impact_lists(universe, 10);
+    for (auto const& plist: posting_lists) {
+        b.add_posting_list(plist.first.size(), plist.first.begin(), plist.second.begin());
+    }
+    collection_type coll;
+    b.build(coll);
+
+    pisa::Query query{{}, {0, 3, 3, 7}, {}};
+    std::map<uint64_t, float> scores;
+    std::size_t total_postings = 0;
+    for (auto [term, weight]: std::vector<std::pair<std::size_t, float>>{{0, 1}, {3, 2}, {7, 1}}) {
+        auto const& plist = posting_lists[term];
+        for (size_t p = 0; p < plist.first.size(); ++p) {
+            if (plist.second[p] > 0) {
+                scores[plist.first[p]] += weight * plist.second[p];
+                total_postings += 1;
+            }
+        }
+    }
+    pisa::topk_queue expected(10);
+    for (auto [docid, score]: scores) {
+        expected.insert(score, docid);
+    }
+    expected.finalize();
+
+    pisa::Simple_Accumulator accumulator(universe);
+    pisa::topk_queue topk(10);
+    pisa::saat_query saat_q(topk);
+    saat_q(pisa::make_impact_cursors(coll, query), accumulator);
+    topk.finalize();
+    REQUIRE(topk.topk().size() == expected.topk().size());
+    for (size_t i = 0; i < topk.topk().size(); ++i) {
+        REQUIRE(topk.topk()[i].first == Approx(expected.topk()[i].first));
+    }
+
+    REQUIRE(saat_q.postings() == total_postings);
+
+    topk.clear();
+    pisa::saat_query anytime_q(topk, 1000);
+    anytime_q(pisa::make_impact_cursors(coll, query), accumulator);
+    topk.finalize();
+    REQUIRE(anytime_q.postings() >= 1000);
+    REQUIRE(anytime_q.postings() < total_postings);
+    REQUIRE(topk.topk().size() == 10);
+    REQUIRE(topk.topk().front().first <= expected.topk().front().first);
+}
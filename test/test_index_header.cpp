@@ -0,0 +1,172 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include "test_generic_sequence.hpp"
+
+#include "block_freq_index.hpp"
+#include "codec/block_codecs.hpp"
+#include "index_header.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "temporary_directory.hpp"
+#include "util/xxhash.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace pisa;
+
+TEST_CASE("xxhash64")
+{
+    auto hash = [](std::string const& s) { return xxhash64_of(s.data(), s.size()); };
+    REQUIRE(hash("") == 0xEF46DB3751D8E999);
+    REQUIRE(hash("abc") == 0x44BC2CF5AD770999);
+    REQUIRE(hash("Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1);
+
+    std::string data(1000, '\0');
+    std::generate(data.begin(), data.end(), []() { return static_cast<char>(rand()); });
+    for (std::size_t step: {1, 7, 31, 32, 33, 200}) {
+        xxhash64 streaming;
+        for (std::size_t pos = 0; pos < data.size(); pos += step) {
+            streaming.update(data.data() + pos, std::min(step, data.size() - pos));
+        }
+        REQUIRE(streaming.digest() == hash(data));
+    }
+}
+
+template <typename Index>
+void build_index(std::string const& filename, std::string const& encoding)
+{
+    global_parameters params;
+    uint64_t universe = 20000;
+    typename Index::builder builder(universe, params);
+    for (int term = 0; term < 20; ++term) {
+        auto n = uint64_t(universe / (1.1 + double(rand()) / RAND_MAX * 10));
+        auto docs = random_sequence(universe, n, true);
+        std::vector<uint64_t> freqs(n, 1);
+        builder.add_posting_list(n, docs.begin(), freqs.begin(), n);
+    }
+    Index index;
+    builder.build(index, encoding);
+    mapper::freeze(index, filename.c_str());
+}
+
+template <typename Index>
+void test_index_header(std::string const& encoding, std::size_t num_sections)
+{
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "index").string();
+    build_index<Index>(filename, encoding);
+
+    auto header = read_index_header(filename);
+    REQUIRE(header);
+    REQUIRE(header->version() == IndexHeader::current_version);
+    REQUIRE(header->encoding() == encoding);
+    REQUIRE(header->num_docs() == 20000);
+    REQUIRE(header->num_terms() == 20);
+    REQUIRE(header->sections().size() == num_sections);
+    {
+        Index index(MemorySource::mapped_file(filename));
+        REQUIRE(index.size() == 20);
+        REQUIRE(index.header().encoding() == encoding);
+    }
+
+    auto bytes = io::load_data(filename);
+    for (auto const& section: header->sections()) {
+        CAPTURE(section.name.data());
+        auto corrupted = bytes;
+        corrupted[section.offset + section.bytes / 2] ^= 1;
+        auto source = MemorySource::from_vector(corrupted);
+        REQUIRE_THROWS_AS(Index(std::move(source)), std::runtime_error);
+        // Without warmup, checksums are not verified.
+        REQUIRE_NOTHROW(Index(MemorySource::from_vector(corrupted), 0));
+    }
+    auto truncated = bytes;
+    truncated.resize(truncated.size() - 1);
+    REQUIRE_THROWS_AS(Index(MemorySource::from_vector(truncated)), std::runtime_error);
+    REQUIRE_THROWS_AS(Index(MemorySource::from_vector(truncated), 0), std::runtime_error);
+
+    // An index built before indexes had headers is the same without it.
+    std::vector<char> legacy(bytes.begin(), bytes.begin() + sizeof(uint64_t));
+    legacy.insert(
+        legacy.end(), bytes.begin() + sizeof(uint64_t) + mapper::size_of(*header), bytes.end());
+    Index index(MemorySource::from_vector(bytes));
+    Index legacy_index(MemorySource::from_vector(legacy));
+    REQUIRE_FALSE(legacy_index.header().valid());
+    REQUIRE(legacy_index.size() == index.size());
+    for (std::size_t term = 0; term < index.size(); ++term) {
+        auto expected = index[term];
+        auto actual = legacy_index[term];
+        REQUIRE(actual.size() == expected.size());
+        for (std::size_t pos = 0; pos < expected.size(); ++pos) {
+            REQUIRE(actual.docid() == expected.docid());
+            actual.next();
+            expected.next();
+        }
+    }
+}
+
+template <typename Index>
+void test_verified_sections(std::string const& encoding)
+{
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "index").string();
+    build_index<Index>(filename, encoding);
+    auto header = read_index_header(filename);
+    std::vector<uint64_t> checksums;
+    for (auto const& section: header->sections()) {
+        checksums.push_back(section.checksum);
+    }
+
+    Index(MemorySource::mapped_file(filename), 0);
+    REQUIRE_FALSE(boost::filesystem::exists(verified_sections_path(filename)));
+    Index(MemorySource::mapped_file(filename));
+    REQUIRE(read_verified_checksums(filename) == checksums);
+
+    // Rewriting the index invalidates the record.
+    auto bytes = io::load_data(filename);
+    auto section = header->sections()[header->sections().size() - 1];
+    bytes[section.offset + section.bytes / 2] ^= 1;
+    {
+        std::ofstream os(filename, std::ios::binary);
+        os.write(bytes.data(), bytes.size());
+    }
+    REQUIRE(read_verified_checksums(filename).empty());
+    REQUIRE_THROWS_AS(Index(MemorySource::mapped_file(filename)), std::runtime_error);
+
+    // Sections recorded as verified are not verified again.
+    record_verified_checksums(filename, checksums);
+    REQUIRE(read_verified_checksums(filename) == checksums);
+    REQUIRE_NOTHROW(Index(MemorySource::mapped_file(filename)));
+}
+
+TEST_CASE("index_header")
+{
+    test_index_header<block_optpfor_index>("block_optpfor", 2);
+    test_index_header<ef_index>("ef", 4);
+    test_index_header<hybrid_optpfor_index>("hybrid_optpfor", 3);
+}
+
+TEST_CASE("index_header_verified_sections")
+{
+    test_verified_sections<block_optpfor_index>("block_optpfor");
+    test_verified_sections<ef_index>("ef");
+    test_verified_sections<hybrid_optpfor_index>("hybrid_optpfor");
+}
+
+TEST_CASE("index_header_missing")
+{
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "index").string();
+    std::vector<uint64_t> data(100, 0);
+    mapper::mappable_vector<uint64_t> vec(data);
+    mapper::freeze(vec, filename.c_str());
+    REQUIRE_FALSE(read_index_header(filename));
+    // Mapped as an index built before indexes had headers.
+    block_optpfor_index index(MemorySource::mapped_file(filename));
+    REQUIRE_FALSE(index.header().valid());
+}
@@ -11,6 +11,7 @@
 #include "binary_collection.hpp"
 #include "filesystem.hpp"
 #include "invert.hpp"
+#include "io.hpp"
 #include "pisa_config.hpp"
 #include "temporary_directory.hpp"
 
@@ -18,186 +19,18 @@ using namespace boost::filesystem;
 using namespace pisa;
 using namespace pisa::literals;
 
-using posting_vector_type = std::vector<std::pair<Term_Id, Document_Id>>;
-using iterator_type = decltype(std::declval<posting_vector_type>().begin());
-using index_type = invert::Inverted_Index<iterator_type>;
-
-TEST_CASE("Map sequence of document terms to sequence of postings", "[invert][unit]")
-{
-    std::vector<std::vector<Term_Id>> documents = {{0_t, 1_t, 2_t, 3_t}, {1_t, 2_t, 3_t, 8_t}};
-    std::vector<gsl::span<Term_Id const>> spans = {
-        gsl::make_span(documents[0]), gsl::make_span(documents[1])};
-
-    auto postings = invert::map_to_postings(invert::Batch{spans, ranges::views::iota(0_d, 2_d)});
-    REQUIRE(
-        postings
-        == std::vector<std::pair<Term_Id, Document_Id>>{
-            {0_t, 0_d}, {1_t, 0_d}, {2_t, 0_d}, {3_t, 0_d}, {1_t, 1_d}, {2_t, 1_d}, {3_t, 1_d}, {8_t, 1_d}});
-}
-
-TEST_CASE("Join term from one index to the same term from another", "[invert][unit]")
-{
-    SECTION("Disjoint")
-    {
-        std::vector<Document_Id> lower_doc{0_d, 3_d, 5_d};
-        std::vector<Frequency> lower_freq{3_f, 4_f, 5_f};
-        std::vector<Document_Id> higher_doc{6_d, 7_d, 9_d};
-        std::vector<Frequency> higher_freq{6_f, 7_f, 8_f};
-        invert::join_term(lower_doc, lower_freq, higher_doc, higher_freq);
-        REQUIRE(lower_doc == std::vector<Document_Id>{0_d, 3_d, 5_d, 6_d, 7_d, 9_d});
-        REQUIRE(lower_freq == std::vector<Frequency>{3_f, 4_f, 5_f, 6_f, 7_f, 8_f});
-    }
-    SECTION("With an overlaping document")
-    {
-        std::vector<Document_Id> lower_doc{0_d, 3_d, 5_d};
-        std::vector<Frequency> lower_freq{3_f, 4_f, 5_f};
-        std::vector<Document_Id> higher_doc{5_d, 7_d, 9_d};
-        std::vector<Frequency> higher_freq{6_f, 7_f, 8_f};
-        invert::join_term(lower_doc, lower_freq, higher_doc, higher_freq);
-        REQUIRE(lower_doc == std::vector<Document_Id>{0_d, 3_d, 5_d, 7_d, 9_d});
-        REQUIRE(lower_freq == std::vector<Frequency>{3_f, 4_f, 11_f, 7_f, 8_f});
-    }
-}
-
-TEST_CASE("Accumulate postings to Inverted_Index", "[invert][unit]")
+TEST_CASE("Iterate over distinct terms of a document", "[invert][unit]")
 {
-    std::vector<std::pair<Term_Id, Document_Id>> postings = {{0_t, 0_d},
-                                                             {0_t, 1_d},
-                                                             {0_t, 2_d},
-                                                             {1_t, 0_d},
-                                                             {1_t, 0_d},
-                                                             {1_t, 0_d},
-                                                             {1_t, 0_d},
-                                                             {1_t, 1_d},
-                                                             {2_t, 5_d}};
-    using iterator_type = decltype(postings.begin());
-    invert::Inverted_Index<iterator_type> index;
-    index(tbb::blocked_range<iterator_type>(postings.begin(), postings.end()));
+    std::vector<Term_Id> document{5_t, 0_t, 3_t, 4_t, 2_t, 6_t, 7_t, 4_t, 5_t};
+    std::vector<Term_Id> buffer;
+    std::vector<std::pair<Term_Id, Frequency>> terms;
+    invert::for_each_term(gsl::make_span(document), buffer, [&](auto term, auto freq) {
+        terms.emplace_back(term, freq);
+    });
     REQUIRE(
-        index.documents
-        == std::unordered_map<Term_Id, std::vector<Document_Id>>{
-            {0_t, {0_d, 1_d, 2_d}}, {1_t, {0_d, 1_d}}, {2_t, {5_d}}});
-    REQUIRE(
-        index.frequencies
-        == std::unordered_map<Term_Id, std::vector<Frequency>>{
-            {0_t, {1_f, 1_f, 1_f}}, {1_t, {4_f, 1_f}}, {2_t, {1_f}}});
-}
-
-TEST_CASE("Accumulate postings to Inverted_Index one by one", "[invert][unit]")
-{
-    std::vector<std::pair<Term_Id, Document_Id>> postings = {
-        {0_t, 0_d}, {0_t, 0_d}, {0_t, 1_d}, {0_t, 4_d}, {1_t, 2_d}, {1_t, 4_d}, {2_t, 0_d},
-        {2_t, 1_d}, {3_t, 0_d}, {3_t, 1_d}, {3_t, 4_d}, {4_t, 1_d}, {4_t, 1_d}, {4_t, 4_d},
-        {5_t, 1_d}, {5_t, 1_d}, {5_t, 2_d}, {5_t, 3_d}, {5_t, 4_d}, {6_t, 1_d}, {6_t, 4_d},
-        {6_t, 4_d}, {6_t, 4_d}, {6_t, 4_d}, {7_t, 1_d}, {8_t, 2_d}, {8_t, 2_d}, {8_t, 2_d},
-        {8_t, 3_d}, {8_t, 4_d}, {9_t, 0_d}, {9_t, 2_d}, {9_t, 3_d}, {9_t, 4_d}};
-    using iterator_type = decltype(postings.begin());
-    invert::Inverted_Index<iterator_type> index;
-    for (auto iter = postings.begin(); iter != postings.end(); ++iter) {
-        index(tbb::blocked_range<iterator_type>(iter, std::next(iter)));
-    }
-    REQUIRE(
-        index.documents
-        == std::unordered_map<Term_Id, std::vector<Document_Id>>{{0_t, {0_d, 1_d, 4_d}},
-                                                                 {1_t, {2_d, 4_d}},
-                                                                 {2_t, {0_d, 1_d}},
-                                                                 {3_t, {0_d, 1_d, 4_d}},
-                                                                 {4_t, {1_d, 4_d}},
-                                                                 {5_t, {1_d, 2_d, 3_d, 4_d}},
-                                                                 {6_t, {1_d, 4_d}},
-                                                                 {7_t, {1_d}},
-                                                                 {8_t, {2_d, 3_d, 4_d}},
-                                                                 {9_t, {0_d, 2_d, 3_d, 4_d}}});
-    REQUIRE(
-        index.frequencies
-        == std::unordered_map<Term_Id, std::vector<Frequency>>{{0_t, {2_f, 1_f, 1_f}},
-                                                               {1_t, {1_f, 1_f}},
-                                                               {2_t, {1_f, 1_f}},
-                                                               {3_t, {1_f, 1_f, 1_f}},
-                                                               {4_t, {2_f, 1_f}},
-                                                               {5_t, {2_f, 1_f, 1_f, 1_f}},
-                                                               {6_t, {1_f, 4_f}},
-                                                               {7_t, {1_f}},
-                                                               {8_t, {3_f, 1_f, 1_f}},
-                                                               {9_t, {1_f, 1_f, 1_f, 1_f}}});
-}
-
-TEST_CASE("Join Inverted_Index to another", "[invert][unit]")
-{
-    auto [lhs, rhs, expected_joined, message] =
-        GENERATE(table<index_type, index_type, index_type, std::string>(
-            {{index_type(
-                  {{0_t, {0_d, 1_d, 2_d}}, {1_t, {0_d, 1_d}}, {2_t, {5_d}}},
-                  {{0_t, {1_f, 1_f, 1_f}}, {1_t, {4_f, 1_f}}, {2_t, {1_f}}}),
-              index_type(
-                  {{3_t, {0_d, 1_d, 2_d}}, {4_t, {0_d, 1_d}}, {5_t, {5_d}}},
-                  {{3_t, {1_f, 1_f, 1_f}}, {4_t, {4_f, 1_f}}, {5_t, {1_f}}}),
-              index_type(
-                  {{0_t, {0_d, 1_d, 2_d}},
-                   {1_t, {0_d, 1_d}},
-                   {2_t, {5_d}},
-                   {3_t, {0_d, 1_d, 2_d}},
-                   {4_t, {0_d, 1_d}},
-                   {5_t, {5_d}}},
-                  {{0_t, {1_f, 1_f, 1_f}},
-                   {1_t, {4_f, 1_f}},
-                   {2_t, {1_f}},
-                   {3_t, {1_f, 1_f, 1_f}},
-                   {4_t, {4_f, 1_f}},
-                   {5_t, {1_f}}}),
-              "disjoint terms"},
-             {index_type(
-                  {{0_t, {0_d, 1_d, 2_d}}, {1_t, {0_d, 1_d}}, {2_t, {5_d}}},
-                  {{0_t, {1_f, 1_f, 1_f}}, {1_t, {4_f, 1_f}}, {2_t, {1_f}}}),
-              index_type(
-                  {{2_t, {6_d, 7_d, 8_d}}, {3_t, {0_d, 1_d}}, {4_t, {5_d}}},
-                  {{2_t, {1_f, 1_f, 1_f}}, {3_t, {4_f, 1_f}}, {4_t, {1_f}}}),
-              index_type(
-                  {{0_t, {0_d, 1_d, 2_d}},
-                   {1_t, {0_d, 1_d}},
-                   {2_t, {5_d, 6_d, 7_d, 8_d}},
-                   {3_t, {0_d, 1_d}},
-                   {4_t, {5_d}}},
-                  {{0_t, {1_f, 1_f, 1_f}},
-                   {1_t, {4_f, 1_f}},
-                   {2_t, {1_f, 1_f, 1_f, 1_f}},
-                   {3_t, {4_f, 1_f}},
-                   {4_t, {1_f}}}),
-              "disjoint documents"},
-             {index_type(
-                  {{0_t, {0_d, 1_d, 2_d}}, {1_t, {0_d, 1_d}}, {2_t, {5_d}}},
-                  {{0_t, {1_f, 1_f, 1_f}}, {1_t, {4_f, 1_f}}, {2_t, {1_f}}}),
-              index_type(
-                  {{2_t, {5_d, 7_d, 8_d}}, {3_t, {0_d, 1_d}}, {4_t, {5_d}}},
-                  {{2_t, {1_f, 1_f, 1_f}}, {3_t, {4_f, 1_f}}, {4_t, {1_f}}}),
-              index_type(
-                  {{0_t, {0_d, 1_d, 2_d}},
-                   {1_t, {0_d, 1_d}},
-                   {2_t, {5_d, 7_d, 8_d}},
-                   {3_t, {0_d, 1_d}},
-                   {4_t, {5_d}}},
-                  {{0_t, {1_f, 1_f, 1_f}},
-                   {1_t, {4_f, 1_f}},
-                   {2_t, {2_f, 1_f, 1_f}},
-                   {3_t, {4_f, 1_f}},
-                   {4_t, {1_f}}}),
-              "overlapping term and document"},
-             {index_type({{0_t, {0_d}}}, {{0_t, {1_f}}}),
-              index_type({{0_t, {0_d}}}, {{0_t, {1_f}}}),
-              index_type({{0_t, {0_d}}}, {{0_t, {2_f}}}),
-              "single posting"}}));
-    WHEN("Join left to right -- " << message)
-    {
-        lhs.join(rhs);
-        REQUIRE(lhs.documents == expected_joined.documents);
-        REQUIRE(lhs.frequencies == expected_joined.frequencies);
-    }
-    WHEN("Join right to left -- " << message)
-    {
-        rhs.join(lhs);
-        REQUIRE(rhs.documents == expected_joined.documents);
-        REQUIRE(rhs.frequencies == expected_joined.frequencies);
-    }
+        terms
+        == std::vector<std::pair<Term_Id, Frequency>>{
+            {0_t, 1_f}, {2_t, 1_f}, {3_t, 1_f}, {4_t, 2_f}, {5_t, 2_f}, {6_t, 1_f}, {7_t, 1_f}});
 }
 
 TEST_CASE("Invert a range of documents from a collection", "[invert][unit]")
@@ -214,35 +47,79 @@ TEST_CASE("Invert a range of documents from a collection", "[invert][unit]")
         collection.begin(), collection.end(), std::back_inserter(document_range), [](auto const& vec) {
             return gsl::span<Term_Id const>(vec);
         });
-    size_t threads = 1;
+    size_t threads = GENERATE(1, 2, 3, 5, 8);
+    CAPTURE(threads);
+
+    auto lists = invert::invert_range(document_range, 0_d, 11, threads);
 
-    auto index = invert::invert_range(document_range, 0_d, threads);
+    std::vector<std::vector<Document_Id>> expected_documents{
+        {0_d, 1_d, 4_d},
+        {2_d, 4_d},
+        {0_d, 1_d},
+        {0_d, 1_d, 4_d},
+        {1_d, 4_d},
+        {1_d, 2_d, 3_d, 4_d},
+        {1_d, 4_d},
+        {1_d},
+        {2_d, 3_d, 4_d},
+        {0_d, 2_d, 3_d, 4_d},
+        {}};
+    std::vector<std::vector<Frequency>> expected_frequencies{
+        {2_f, 1_f, 1_f},
+        {1_f, 1_f},
+        {1_f, 1_f},
+        {1_f, 1_f, 1_f},
+        {2_f, 1_f},
+        {2_f, 1_f, 1_f, 1_f},
+        {1_f, 4_f},
+        {1_f},
+        {3_f, 1_f, 1_f},
+        {1_f, 1_f, 1_f, 1_f},
+        {}};
+    REQUIRE(lists.term_count() == 11);
+    for (auto term = 0_t; term < 11_t; ++term) {
+        CAPTURE(term);
+        auto documents = lists.documents_of(term);
+        auto frequencies = lists.frequencies_of(term);
+        REQUIRE(
+            std::vector<Document_Id>(documents.begin(), documents.end())
+            == expected_documents[term.as_int()]);
+        REQUIRE(
+            std::vector<Frequency>(frequencies.begin(), frequencies.end())
+            == expected_frequencies[term.as_int()]);
+    }
+    REQUIRE(lists.document_sizes == std::vector<std::uint32_t>{5, 9, 6, 3, 11});
 
-    index_type expected(
-        {{0_t, {0_d, 1_d, 4_d}},
-         {1_t, {2_d, 4_d}},
-         {2_t, {0_d, 1_d}},
-         {3_t, {0_d, 1_d, 4_d}},
-         {4_t, {1_d, 4_d}},
-         {5_t, {1_d, 2_d, 3_d, 4_d}},
-         {6_t, {1_d, 4_d}},
-         {7_t, {1_d}},
-         {8_t, {2_d, 3_d, 4_d}},
-         {9_t, {0_d, 2_d, 3_d, 4_d}}},
-        {{0_t, {2_f, 1_f, 1_f}},
-         {1_t, {1_f, 1_f}},
-         {2_t, {1_f, 1_f}},
-         {3_t, {1_f, 1_f, 1_f}},
-         {4_t, {2_f, 1_f}},
-         {5_t, {2_f, 1_f, 1_f, 1_f}},
-         {6_t, {1_f, 4_f}},
-         {7_t, {1_f}},
-         {8_t, {3_f, 1_f, 1_f}},
-         {9_t, {1_f, 1_f, 1_f, 1_f}}},
-        {5, 9, 6, 3, 11});
-    REQUIRE(index.documents == expected.documents);
-    REQUIRE(index.frequencies == expected.frequencies);
-    REQUIRE(index.document_sizes == expected.document_sizes);
+    SECTION("Document IDs start at the first document of the range")
+    {
+        auto shifted = invert::invert_range(document_range, 10_d, 11, threads);
+        auto documents = shifted.documents_of(5_t);
+        REQUIRE(
+            std::vector<Document_Id>(documents.begin(), documents.end())
+            == std::vector<Document_Id>{11_d, 12_d, 13_d, 14_d});
+    }
+    SECTION("Terms must be in range")
+    {
+        REQUIRE_THROWS_AS(
+            invert::invert_range(document_range, 0_d, 9, threads), std::invalid_argument);
+    }
+    SECTION("More terms than occurrences")
+    {
+        auto sparse = invert::invert_range(document_range, 0_d, 1000, threads);
+        REQUIRE(sparse.term_count() == 1000);
+        auto documents = sparse.documents_of(5_t);
+        REQUIRE(
+            std::vector<Document_Id>(documents.begin(), documents.end())
+            == expected_documents[5]);
+        REQUIRE(sparse.documents_of(999_t).empty());
+    }
+    SECTION("Empty range")
+    {
+        auto empty = invert::invert_range({}, 0_d, 3, threads);
+        REQUIRE(empty.term_count() == 3);
+        REQUIRE(empty.documents.empty());
+        REQUIRE(empty.document_sizes.empty());
+    }
 }
 
 TEST_CASE("Invert collection", "[invert][unit]")
@@ -253,6 +130,8 @@ TEST_CASE("Invert collection", "[invert][unit]")
         uint32_t batch_size = GENERATE(1, 2, 3, 4, 5);
         uint32_t threads = GENERATE(1, 2, 3, 4, 5);
         bool with_lex = GENERATE(false, true);
+        auto memory_budget =
+            GENERATE(std::optional<std::size_t>{}, std::optional<std::size_t>{700});
         auto collection_filename = (tmpdir.path() / "fwd").string();
         {
             std::vector<uint32_t> collection_data{
@@ -272,6 +151,7 @@ TEST_CASE("Invert collection", "[invert][unit]")
                     .to_file((tmpdir.path() / "fwd.termlex").string());
             }
         }
+        CAPTURE(memory_budget.has_value());
         WHEN("Run inverting with batch size " << batch_size << " and " << threads << " threads")
         {
             auto index_basename = (tmpdir.path() / "idx").string();
@@ -280,7 +160,12 @@ TEST_CASE("Invert collection", "[invert][unit]")
                 term_count = 10;
             }
             invert::invert_forward_index(
-                collection_filename, index_basename, batch_size, threads, term_count);
+                collection_filename,
+                index_basename,
+                batch_size,
+                threads,
+                term_count,
+                memory_budget);
             THEN("Index is stored in binary_freq_collection format")
             {
                 std::vector<uint32_t> document_data{
@@ -334,3 +219,47 @@ TEST_CASE("Invert collection", "[invert][unit]")
         }
     }
 }
+
+TEST_CASE("Merge batches by ranges of terms", "[invert][unit]")
+{
+    Temporary_Directory tmpdir;
+    std::vector<std::vector<Term_Id>> collection = {
+        /* Doc 0 */ {2_t, 0_t, 3_t, 9_t, 0_t},
+        /* Doc 1 */ {5_t, 0_t, 3_t, 4_t, 2_t, 6_t, 7_t, 4_t, 5_t},
+        /* Doc 2 */ {5_t, 1_t, 8_t, 9_t, 8_t, 8_t},
+        /* Doc 3 */ {8_t, 5_t, 9_t},
+        /* Doc 4 */ {8_t, 6_t, 9_t, 6_t, 6_t, 5_t, 4_t, 3_t, 1_t, 0_t, 6_t}};
+    std::vector<gsl::span<Term_Id const>> documents(collection.begin(), collection.end());
+    auto expected_basename = (tmpdir.path() / "expected").string();
+    invert::write(expected_basename, invert::invert_range(documents, 0_d, 10, 1));
+
+    std::size_t block_terms = GENERATE(1, 3, 1024);
+    std::size_t range_postings = GENERATE(1, 5, 1000);
+    std::size_t threads = GENERATE(1, 2, 3);
+    CAPTURE(block_terms, range_postings, threads);
+    std::vector<invert::Batch_File> batches;
+    for (auto [first, last]: std::vector<std::pair<int, int>>{{0, 2}, {2, 3}, {3, 5}}) {
+        auto lists = invert::invert_range(
+            gsl::make_span(documents).subspan(first, last - first), Document_Id(first), 10, 1);
+        auto basename = (tmpdir.path() / fmt::format("batch.{}", first)).string();
+        invert::write(basename, lists);
+        batches.push_back(invert::batch_file(basename, lists, block_terms));
+    }
+    auto actual_basename = (tmpdir.path() / "actual").string();
+    invert::merge_batches(actual_basename, batches, 10, range_postings, threads, block_terms);
+    for (auto extension: {".docs", ".freqs", ".sizes"}) {
+        CAPTURE(extension);
+        REQUIRE(
+            io::load_data(actual_basename + extension)
+            == io::load_data(expected_basename + extension));
+    }
+}
+
+TEST_CASE("Memory budget too small to invert", "[invert][unit]")
+{
+    Temporary_Directory tmpdir;
+    REQUIRE_THROWS_AS(
+        invert::invert_forward_index(
+            (tmpdir.path() / "fwd").string(), (tmpdir.path() / "idx").string(), 100, 4, 1000, 1000),
+        std::invalid_argument);
+}
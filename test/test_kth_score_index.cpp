@@ -0,0 +1,82 @@
+#define CATCH_CONFIG_MAIN
+
+#include <map>
+#include <random>
+
+#include <catch2/catch.hpp>
+
+#include "kth_score_index.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "temporary_directory.hpp"
+
+using namespace pisa;
+
+TEST_CASE("K-th score index estimates thresholds", "[kth_score_index]")
+{
+    Temporary_Directory tmpdir;
+    auto filename = (tmpdir.path() / "kth_scores").string();
+    {
+        KthScoreIndex kth_scores(
+            {10, 100},
+            {1.0, 0.5, 0.0, 0.0, 3.0, 2.0, 2.0, 1.0},
+            {{{3, 1}, {4.5, 4.0}}, {{0, 2}, {2.5, 0.0}}});
+        mapper::freeze(kth_scores, filename.c_str());
+    }
+
+    KthScoreIndex kth_scores(MemorySource::mapped_file(filename));
+    REQUIRE(kth_scores.num_levels() == 2);
+    REQUIRE(kth_scores.max_k() == 100);
+    REQUIRE(kth_scores.level(5) == std::optional<std::size_t>(0));
+    REQUIRE(kth_scores.level(11) == std::optional<std::size_t>(1));
+    REQUIRE_FALSE(kth_scores.level(101));
+    REQUIRE(kth_scores.num_terms() == 4);
+    REQUIRE(kth_scores.num_pairs() == 2);
+
+    REQUIRE(kth_scores.term_score(2, 0) == 3.0);
+    REQUIRE(kth_scores.term_score(2, 1) == 2.0);
+    REQUIRE(kth_scores.term_score(100, 0) == 0.0);
+    REQUIRE(kth_scores.pair_score(1, 3, 0) == std::optional<float>(4.5));
+    REQUIRE(kth_scores.pair_score(3, 1, 1) == std::optional<float>(4.0));
+    REQUIRE_FALSE(kth_scores.pair_score(1, 2, 0));
+    REQUIRE_FALSE(kth_scores.pair_score(1, 1, 0));
+
+    REQUIRE(kth_scores.estimate_threshold(Query{{}, {0}, {}}, 10) == 1.0);
+    REQUIRE(kth_scores.estimate_threshold(Query{{}, {0, 2}, {}}, 10) == 3.0);
+    REQUIRE(kth_scores.estimate_threshold(Query{{}, {3, 0, 1, 3}, {}}, 10) == 4.5);
+    REQUIRE(kth_scores.estimate_threshold(Query{{}, {3, 0, 1}, {}}, 5) == 4.5);
+    REQUIRE(kth_scores.estimate_threshold(Query{{}, {3, 0, 1}, {}}, 11) == 4.0);
+    REQUIRE(kth_scores.estimate_threshold(Query{{}, {0, 2}, {}}, 100) == 2.0);
+    REQUIRE(kth_scores.estimate_threshold(Query{{}, {3, 0, 1}, {}}, 101) == 0.0);
+}
+
+TEST_CASE("K-th score index finds all stored pairs", "[kth_score_index]")
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<term_id_type> terms(0, 1000);
+    std::map<KthScoreIndex::term_pair, float> expected;
+    while (expected.size() < 5000) {
+        auto left = terms(rng);
+        auto right = terms(rng);
+        if (left < right) {
+            expected.emplace(KthScoreIndex::term_pair{left, right}, expected.size() + 1);
+        }
+    }
+    std::vector<std::pair<KthScoreIndex::term_pair, std::vector<float>>> pairs;
+    for (auto const& [pair, score]: expected) {
+        pairs.push_back({pair, {score}});
+    }
+    KthScoreIndex kth_scores({10}, {}, pairs);
+    REQUIRE(kth_scores.num_pairs() == expected.size());
+    for (term_id_type left = 0; left <= 1000; left += 7) {
+        for (term_id_type right = left + 1; right <= 1000; ++right) {
+            auto pos = expected.find({left, right});
+            auto score = kth_scores.pair_score(right, left, 0);
+            if (pos == expected.end()) {
+                REQUIRE_FALSE(score);
+            } else {
+                REQUIRE(score == std::optional<float>(pos->second));
+            }
+        }
+    }
+}
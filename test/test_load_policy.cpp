@@ -0,0 +1,43 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include <sstream>
+#include <vector>
+
+#include "load_policy.hpp"
+
+using namespace pisa;
+
+TEST_CASE("most_frequent_terms")
+{
+    SECTION("Query log")
+    {
+        std::istringstream is("1:5 3 7\n2:3 9\n3 5 3\n\n4:8\n");
+        REQUIRE(most_frequent_terms(is, 3) == std::vector<std::uint32_t>{3, 5, 7});
+    }
+    SECTION("Terms by decreasing frequency")
+    {
+        std::istringstream is("42\n7\n1000\n3\n");
+        REQUIRE(most_frequent_terms(is, 2) == std::vector<std::uint32_t>{42, 7});
+        is.clear();
+        is.seekg(0);
+        REQUIRE(most_frequent_terms(is, 10) == std::vector<std::uint32_t>{42, 7, 1000, 3});
+    }
+    SECTION("Empty")
+    {
+        std::istringstream is("");
+        REQUIRE(most_frequent_terms(is, 10).empty());
+    }
+}
+
+TEST_CASE("LoadPolicy")
+{
+    LoadPolicy policy;
+    REQUIRE(policy.map_flags() == mapper::map_flags::warmup);
+    REQUIRE(policy.map_options().advice == MapAdvice::Normal);
+    policy.paging = LoadPolicy::Paging::Lazy;
+    policy.populate = true;
+    REQUIRE(policy.map_flags() == 0);
+    REQUIRE(policy.map_options().advice == MapAdvice::Random);
+    REQUIRE(policy.map_options().populate);
+}
@@ -20,6 +20,7 @@ TEST_CASE("Empty memory source", "[mmap][io]")
     REQUIRE(source.span().empty());
     REQUIRE(source.subspan(0).empty());
     REQUIRE_THROWS_AS(source.subspan(1), std::out_of_range);
+    REQUIRE(source.file().empty());
 }
 
 TEST_CASE("Error when mapping non-existent file", "[mmap][io]")
@@ -39,6 +40,7 @@ TEST_CASE("Non-empty memory source", "[mmap][io]")
     }
     auto source = MemorySource::mapped_file(file_path);
     REQUIRE(source.is_mapped());
+    REQUIRE(source.file() == file_path);
     REQUIRE(source.size() == 11);
     REQUIRE(std::string(source.begin(), source.end()) == "Lorem ipsum");
     REQUIRE(std::string_view(source.data(), source.size()) == "Lorem ipsum");
@@ -49,4 +51,28 @@ TEST_CASE("Non-empty memory source", "[mmap][io]")
     REQUIRE(source.subspan(11).empty());
     REQUIRE_THROWS_AS(source.subspan(12), std::out_of_range);
     REQUIRE_THROWS_AS(source.subspan(1, source.size()), std::out_of_range);
+    REQUIRE_NOTHROW(source.will_need(1, 4));
+    REQUIRE_THROWS_AS(source.will_need(1, source.size()), std::out_of_range);
+}
+
+TEST_CASE("Memory mapped file with options", "[mmap][io]")
+{
+    Temporary_Directory temp;
+    auto file_path = (temp.path() / "file");
+    std::string contents(100'000, 'x');
+    {
+        std::ofstream os(file_path.string());
+        os << contents;
+    }
+    auto advice =
+        GENERATE(pisa::MapAdvice::Normal, pisa::MapAdvice::Random, pisa::MapAdvice::Sequential);
+    auto populate = GENERATE(false, true);
+    auto huge_pages = GENERATE(false, true);
+    pisa::MapOptions options;
+    options.advice = advice;
+    options.populate = populate;
+    options.huge_pages = huge_pages;
+    auto source = MemorySource::mapped_file(file_path, options);
+    REQUIRE(source.size() == contents.size());
+    REQUIRE(std::string(source.begin(), source.end()) == contents);
 }
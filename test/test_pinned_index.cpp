@@ -0,0 +1,107 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+#include "test_generic_sequence.hpp"
+
+#include "index_types.hpp"
+#include "pinned_index.hpp"
+#include "pinned_memory.hpp"
+
+#include <cstdlib>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace pisa;
+
+TEST_CASE("PinnedMemory")
+{
+    PinnedMemory memory(10000);
+    REQUIRE(memory.size() == 10000);
+    std::iota(memory.data(), memory.data() + memory.size(), 0);
+    PinnedMemory moved(std::move(memory));
+    REQUIRE(moved.size() == 10000);
+    REQUIRE(memory.size() == 0);
+    REQUIRE(moved.data()[9999] == static_cast<char>(9999));
+
+    REQUIRE(PinnedMemory().size() == 0);
+}
+
+template <typename Index>
+void test_pinned_index()
+{
+    global_parameters params;
+    uint64_t universe = 20000;
+    typename Index::builder builder(universe, params);
+    for (int term = 0; term < 20; ++term) {
+        auto n = uint64_t(universe / (1.1 + double(rand()) / RAND_MAX * 100));
+        auto docs = random_sequence(universe, n, true);
+        std::vector<uint64_t> freqs(n);
+        std::generate(freqs.begin(), freqs.end(), []() { return rand() % 10 + 1; });
+        uint64_t freqs_sum = std::accumulate(freqs.begin(), freqs.end(), uint64_t(0));
+        builder.add_posting_list(n, docs.begin(), freqs.begin(), freqs_sum);
+    }
+    Index index;
+    builder.build(index, "test");
+
+    std::vector<uint32_t> terms{3, 7, 3, 11, 100, 0, 19};
+    pinned_index<Index> const pinned(index, terms, 1 << 20);
+    REQUIRE(pinned.size() == index.size());
+    REQUIRE(pinned.num_docs() == index.num_docs());
+    // Duplicate and out-of-range terms are skipped.
+    REQUIRE(pinned.pinned_lists() == 5);
+    REQUIRE(pinned.pinned_bytes() > 0);
+
+    for (std::size_t term = 0; term < index.size(); ++term) {
+        CAPTURE(term);
+        auto expected = index[term];
+        auto actual = pinned[term];
+        REQUIRE(actual.size() == expected.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            REQUIRE(actual.docid() == expected.docid());
+            REQUIRE(actual.freq() == expected.freq());
+            expected.next();
+            actual.next();
+        }
+        pinned.warmup(term);
+    }
+    REQUIRE(pinned.hits() == 5);
+    REQUIRE(pinned.misses() == 15);
+    REQUIRE(pinned.hit_rate() == Approx(0.25));
+
+    // Lookups are counted by each thread, and summed when reported.
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&]() {
+            for (std::size_t term = 0; term < index.size(); ++term) {
+                static_cast<void>(pinned[term]);
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    REQUIRE(pinned.hits() == 25);
+    REQUIRE(pinned.misses() == 75);
+
+    SECTION("Budget")
+    {
+        pinned_index<Index> const none(index, terms, 0);
+        REQUIRE(none.pinned_lists() == 0);
+        REQUIRE(none.pinned_bytes() == 0);
+        REQUIRE(none.hit_rate() == 0.0);
+
+        // Lists exceeding the remaining budget are skipped, not those after them.
+        auto budget = pinned.pinned_bytes() - 1;
+        pinned_index<Index> const partial(index, terms, budget);
+        REQUIRE(partial.pinned_lists() >= 4);
+        REQUIRE(partial.pinned_bytes() <= budget);
+    }
+}
+
+TEST_CASE("pinned_index")
+{
+    test_pinned_index<block_optpfor_index>();
+    test_pinned_index<ef_index>();
+    test_pinned_index<pefopt_index>();
+}
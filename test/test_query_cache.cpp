@@ -0,0 +1,69 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch.hpp>
+
+#include "query/query_cache.hpp"
+
+using namespace pisa;
+
+Query make_query(std::vector<term_id_type> terms)
+{
+    return Query{std::nullopt, std::move(terms), {}};
+}
+
+TEST_CASE("Query cache hits", "[query_cache]")
+{
+    QueryCache cache(2, 10, 100);
+    std::vector<QueryCache::entry_type> results{{3.0, 1}, {2.0, 7}};
+    cache.insert(QueryCache::key(make_query({4, 1, 4})), results);
+
+    auto lookup = cache.find(QueryCache::key(make_query({4, 4, 1})));
+    REQUIRE(lookup.results != nullptr);
+    REQUIRE(*lookup.results == results);
+
+    lookup = cache.find(QueryCache::key(make_query({4, 1})));
+    REQUIRE(lookup.results == nullptr);
+    REQUIRE_FALSE(lookup.threshold);
+
+    REQUIRE(cache.hits() == 1);
+    REQUIRE(cache.misses() == 1);
+    REQUIRE(cache.hit_rate() == Approx(0.5));
+}
+
+TEST_CASE("Query cache seeds thresholds from sub-queries", "[query_cache]")
+{
+    QueryCache cache(2, 10, 100);
+    cache.insert(QueryCache::key(make_query({1})), {{3.0, 1}, {2.0, 7}});
+    cache.insert(QueryCache::key(make_query({2, 3})), {{5.0, 1}, {4.0, 2}});
+    cache.insert(QueryCache::key(make_query({4})), {{9.0, 1}});
+
+    auto lookup = cache.find(QueryCache::key(make_query({1, 2, 3})));
+    REQUIRE(lookup.results == nullptr);
+    REQUIRE(lookup.threshold == std::optional<Threshold>(4.0));
+
+    // Fewer than k results do not bound the k-th score.
+    lookup = cache.find(QueryCache::key(make_query({4, 5})));
+    REQUIRE_FALSE(lookup.threshold);
+
+    REQUIRE(cache.partial_hits() == 1);
+    REQUIRE(cache.misses() == 1);
+}
+
+TEST_CASE("Query cache evicts least recently used queries", "[query_cache]")
+{
+    QueryCache cache(1, 2, 3);
+    cache.insert(QueryCache::key(make_query({1})), {{1.0, 1}});
+    cache.insert(QueryCache::key(make_query({2})), {{1.0, 2}});
+    REQUIRE(cache.find(QueryCache::key(make_query({1}))).results != nullptr);
+
+    cache.insert(QueryCache::key(make_query({3})), {{1.0, 3}});
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.find(QueryCache::key(make_query({2}))).results == nullptr);
+    REQUIRE(cache.find(QueryCache::key(make_query({1}))).results != nullptr);
+
+    // Bounded by the total number of results.
+    cache.insert(QueryCache::key(make_query({4})), {{3.0, 1}, {2.0, 2}});
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.find(QueryCache::key(make_query({3}))).results == nullptr);
+    REQUIRE(cache.find(QueryCache::key(make_query({4}))).results != nullptr);
+}
@@ -6,6 +6,7 @@
 #include "accumulator/lazy_accumulator.hpp"
 #include "cursor/block_max_scored_cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
+#include "cursor/range_max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
 #include "index_types.hpp"
 #include "pisa_config.hpp"
@@ -104,12 +105,14 @@ TEMPLATE_TEST_CASE(
     wand_query,
     maxscore_query,
     block_max_wand_query,
+    block_max_wand_simd_query,
     block_max_maxscore_query,
     range_query_128<ranked_or_taat_query_acc<Simple_Accumulator>>,
     range_query_128<ranked_or_taat_query_acc<Lazy_Accumulator<4>>>,
     range_query_128<wand_query>,
     range_query_128<maxscore_query>,
     range_query_128<block_max_wand_query>,
+    range_query_128<block_max_wand_simd_query>,
     range_query_128<block_max_maxscore_query>)
 {
     for (auto quantized: {false, true}) {
@@ -178,6 +181,112 @@ TEMPLATE_TEST_CASE("Ranked AND query test", "[query][ranked][integration]", bloc
     }
 }
 
+// NOLINTNEXTLINE(hicpp-explicit-conversions)
+TEMPLATE_TEST_CASE(
+    "Parallel range query test",
+    "[query][ranked][integration]",
+    wand_query,
+    maxscore_query,
+    block_max_wand_query,
+    block_max_maxscore_query)
+{
+    for (auto&& s_name: {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, false, dropped_term_ids);
+        auto scorer = scorer::from_params(ScorerParams(s_name), data->wdata);
+        for (auto num_ranges: {1, 3, 16}) {
+            topk_queue topk_1(10);
+            parallel_range_query<TestType> op_q(topk_1, num_ranges);
+            topk_queue topk_2(10);
+            ranked_or_query or_q(topk_2);
+            for (auto const& q: data->queries) {
+                or_q(make_scored_cursors(data->index, *scorer, q), data->index.num_docs());
+                op_q(
+                    [&] { return make_block_max_scored_cursors(data->index, data->wdata, *scorer, q); },
+                    data->index.num_docs());
+                topk_1.finalize();
+                topk_2.finalize();
+                REQUIRE(topk_2.topk().size() == topk_1.topk().size());
+                for (size_t i = 0; i < topk_2.topk().size(); ++i) {
+                    REQUIRE(topk_2.topk()[i].first == Approx(topk_1.topk()[i].first).epsilon(0.1));
+                }
+                topk_1.clear();
+                topk_2.clear();
+            }
+        }
+    }
+}
+
+TEST_CASE("Range MaxScore query test", "[query][ranked][integration]")
+{
+    using WandRange = wand_data<wand_data_range<128, 1024>>;
+    for (auto&& s_name: {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, false, dropped_term_ids);
+        WandRange wdata(
+            data->document_sizes.begin()->begin(),
+            data->collection.num_docs(),
+            data->collection,
+            ScorerParams(s_name),
+            BlockSize(FixedBlock(5)),
+            false,
+            dropped_term_ids);
+        topk_queue topk_1(10);
+        range_maxscore_query op_q(topk_1);
+        topk_queue topk_2(10);
+        ranked_or_query or_q(topk_2);
+
+        auto scorer = scorer::from_params(ScorerParams(s_name), wdata);
+        for (auto const& q: data->queries) {
+            or_q(make_scored_cursors(data->index, *scorer, q), data->index.num_docs());
+            op_q(
+                make_range_max_scored_cursors(data->index, wdata, *scorer, q),
+                data->index.num_docs());
+            topk_1.finalize();
+            topk_2.finalize();
+            REQUIRE(topk_2.topk().size() == topk_1.topk().size());
+            for (size_t i = 0; i < topk_2.topk().size(); ++i) {
+                REQUIRE(topk_2.topk()[i].first == Approx(topk_1.topk()[i].first).epsilon(0.1));
+            }
+            topk_1.clear();
+            topk_2.clear();
+        }
+    }
+}
+
+TEST_CASE("BlockMax WAND SIMD matches BlockMax WAND", "[query][ranked][integration]")
+{
+    using Cursor = BlockMaxScoredCursor<single_index::document_enumerator, wand_data<wand_data_raw>>;
+    for (auto&& s_name: {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, false, dropped_term_ids);
+        auto scorer = scorer::from_params(ScorerParams(s_name), data->wdata);
+        topk_queue topk_1(10);
+        block_max_wand_simd_query op_q(topk_1);
+        topk_queue topk_2(10);
+        block_max_wand_query bmw_q(topk_2);
+        std::vector<Cursor> cursors;
+        for (auto const& q: data->queries) {
+            make_block_max_scored_cursors(data->index, data->wdata, *scorer, q, cursors);
+            op_q(cursors, data->index.num_docs());
+            bmw_q(
+                make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+                data->index.num_docs());
+            topk_1.finalize();
+            topk_2.finalize();
+            // Scores of a document may differ in the last bits, as its cursors are summed in
+            // a different order, but the documents must be the same.
+            REQUIRE(topk_1.topk().size() == topk_2.topk().size());
+            for (size_t i = 0; i < topk_2.topk().size(); ++i) {
+                REQUIRE(topk_1.topk()[i].second == topk_2.topk()[i].second);
+                REQUIRE(topk_1.topk()[i].first == Approx(topk_2.topk()[i].first));
+            }
+            topk_1.clear();
+            topk_2.clear();
+        }
+    }
+}
+
 TEST_CASE("Top k")
 {
     for (auto&& s_name: {"bm25", "qld"}) {
@@ -204,3 +313,29 @@ TEST_CASE("Top k")
         }
     }
 }
+
+TEST_CASE("Top k with shared threshold")
+{
+    std::atomic<Threshold> shared(0.0);
+    topk_queue topk_1(2);
+    topk_queue topk_2(2);
+    topk_1.set_shared_threshold(&shared);
+    topk_2.set_shared_threshold(&shared);
+
+    topk_1.insert(1.0, 0);
+    REQUIRE(shared.load() == 0.0);
+    topk_1.insert(5.0, 1);
+    REQUIRE(shared.load() == 1.0);
+    topk_1.insert(3.0, 2);
+    REQUIRE(shared.load() == 3.0);
+
+    REQUIRE(topk_2.would_enter(2.0));
+    topk_2.refresh_threshold();
+    REQUIRE_FALSE(topk_2.would_enter(2.0));
+    REQUIRE(topk_2.threshold() == 3.0);
+    REQUIRE(topk_2.insert(4.0, 3));
+    REQUIRE(topk_2.insert(6.0, 4));
+    REQUIRE(shared.load() == 4.0);
+    REQUIRE(topk_1.insert(4.5, 5));
+    REQUIRE(shared.load() == 4.5);
+}
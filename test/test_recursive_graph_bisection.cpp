@@ -2,9 +2,14 @@
 
 #include <catch2/catch.hpp>
 
+#include <cmath>
+#include <random>
+#include <vector>
+
 #include "pisa/forward_index_builder.hpp"
 #include "pisa/invert.hpp"
 #include "pisa/parser.hpp"
+#include "pisa/recursive_graph_bisection.hpp"
 #include "pisa/reorder_docids.hpp"
 #include "pisa/temporary_directory.hpp"
 #include "pisa_config.hpp"
@@ -135,3 +140,37 @@ TEST_CASE("Reorder documents with BP")
         }
     }
 }
+
+TEST_CASE("Compute term gains")
+{
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<uint32_t> small(1, 100);
+    std::uniform_int_distribution<uint32_t> large(1, 10'000);
+    std::size_t count = GENERATE(0, 1, 7, 8, 9, 100, 1001);
+    std::vector<uint32_t> from_degrees(count);
+    std::vector<uint32_t> to_degrees(count);
+    for (std::size_t pos = 0; pos < count; ++pos) {
+        // Degrees out of the range of precomputed logarithms in some of the terms.
+        from_degrees[pos] = pos % 5 == 0 ? large(gen) : small(gen);
+        to_degrees[pos] = pos % 3 == 0 ? large(gen) : small(gen) - 1;
+    }
+    float logn1 = std::log2(150'000);
+    float logn2 = std::log2(120'000);
+    std::vector<double> gains(count);
+    bp::compute_term_gains(
+        logn1, logn2, from_degrees.data(), to_degrees.data(), gains.data(), count);
+    for (std::size_t pos = 0; pos < count; ++pos) {
+        CAPTURE(pos, from_degrees[pos], to_degrees[pos]);
+        auto from_deg = static_cast<double>(from_degrees[pos]);
+        auto to_deg = static_cast<double>(to_degrees[pos]);
+        auto expb = [&](double deg1, double deg2) {
+            return deg1 * logn1 - deg1 * std::log2(deg1 + 1) + deg2 * logn2
+                - deg2 * std::log2(deg2 + 1);
+        };
+        auto expected = expb(from_deg, to_deg) - expb(from_deg - 1, to_deg + 1);
+        REQUIRE(gains[pos] == Approx(expected).margin(0.5).epsilon(1e-3));
+        REQUIRE(
+            gains[pos]
+            == Approx(bp::term_gain(logn1, logn2, from_degrees[pos], to_degrees[pos])));
+    }
+}
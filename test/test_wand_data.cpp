@@ -128,3 +128,56 @@ TEST_CASE("wand_data_range")
         }
     }
 }
+
+TEST_CASE("wand_data with score-optimal blocks")
+{
+    auto scorer_name = "bm25";
+    std::uint64_t block_size = 32;
+
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    std::unordered_set<size_t> dropped_term_ids;
+    wand_data<wand_data_raw> wdata(
+        document_sizes.begin()->begin(),
+        collection.num_docs(),
+        collection,
+        ScorerParams(scorer_name),
+        BlockSize(OptimalBlock(block_size)),
+        false,
+        dropped_term_ids);
+
+    auto scorer = scorer::from_params(ScorerParams(scorer_name), wdata);
+
+    SECTION("Number of blocks does not exceed fixed partitioning")
+    {
+        size_t term_id = 0;
+        for (auto const& seq: collection) {
+            auto [docids, scores] =
+                optimal_block_partition(seq, scorer->term_scorer(term_id), block_size);
+            REQUIRE(docids.size() == scores.size());
+            REQUIRE(docids.size() <= ceil_div(seq.docs.size(), block_size));
+            REQUIRE(docids.back() == *std::prev(seq.docs.end()));
+            term_id += 1;
+        }
+    }
+
+    SECTION("Block-max scores are upper bounds")
+    {
+        size_t term_id = 0;
+        for (auto const& seq: collection) {
+            auto max = wdata.max_term_weight(term_id);
+            auto w = wdata.getenum(term_id);
+            auto s = scorer->term_scorer(term_id);
+            for (auto&& [docid, freq]: ranges::views::zip(seq.docs, seq.freqs)) {
+                float score = s(docid, freq);
+                w.next_geq(docid);
+                CHECKED_ELSE(w.score() >= score)
+                {
+                    FAIL("Term: " << term_id << " docid: " << docid << ", block docid: " << w.docid());
+                }
+                REQUIRE(w.score() <= max);
+            }
+            term_id += 1;
+        }
+    }
+}
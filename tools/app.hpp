@@ -11,7 +11,10 @@
 #include <range/v3/view/transform.hpp>
 #include <spdlog/spdlog.h>
 
+#include "hybrid_freq_index.hpp"
+#include "index_header.hpp"
 #include "io.hpp"
+#include "load_policy.hpp"
 #include "query/queries.hpp"
 #include "scorer/scorer.hpp"
 #include "sharding.hpp"
@@ -23,25 +26,120 @@ namespace pisa {
 namespace arg {
 
     struct Encoding {
-        explicit Encoding(CLI::App* app)
+        explicit Encoding(CLI::App* app) : Encoding(app, true) {}
+        [[nodiscard]] auto index_encoding() const -> std::string const& { return m_encoding; }
+
+      protected:
+        Encoding(CLI::App* app, bool required)
         {
-            app->add_option("-e,--encoding", m_encoding, "Index encoding")->required();
+            auto* encoding = app->add_option("-e,--encoding", m_encoding, "Index encoding");
+            if (required) {
+                encoding->required();
+            }
         }
-        [[nodiscard]] auto index_encoding() const -> std::string const& { return m_encoding; }
 
       private:
         std::string m_encoding;
     };
 
+    struct DensityThreshold {
+        explicit DensityThreshold(CLI::App* app)
+        {
+            app->add_option(
+                "--density-threshold",
+                m_density_threshold,
+                "Fraction of documents above which posting lists of hybrid indexes are bitmaps",
+                true);
+        }
+        [[nodiscard]] auto density_threshold() const -> double { return m_density_threshold; }
+
+      private:
+        double m_density_threshold = default_density_threshold;
+    };
+
+    struct Load {
+        explicit Load(CLI::App* app)
+        {
+            app->add_flag(
+                "--lazy",
+                m_lazy,
+                "Page the index and WAND data in on demand instead of reading them at startup, "
+                "without verifying the index checksums or warming up the lists of query terms");
+            auto* warmup_log = app->add_option(
+                "--warmup-log",
+                m_warmup_log,
+                "Query log, or list of terms by decreasing frequency, made of term IDs; with "
+                "--lazy, the posting lists of its most frequent terms are warmed up");
+            app->add_option(
+                   "--warmup-top",
+                   m_warmup_top,
+                   "Number of the most frequent terms of --warmup-log to warm up",
+                   true)
+                ->needs(warmup_log);
+            app->add_option(
+                   "--pin-budget",
+                   m_pin_budget,
+                   "Megabytes of the posting lists of the most frequent terms of --warmup-log to "
+                   "pin in memory, locked in RAM and backed by huge pages")
+                ->needs(warmup_log);
+            app->add_flag(
+                "--populate",
+                m_populate,
+                "Read the whole index and WAND data into memory when mapping them (MAP_POPULATE)");
+            app->add_flag(
+                "--huge-pages", m_huge_pages, "Back the mappings with transparent huge pages");
+        }
+
+        /// \throws std::runtime_error  if the warmup log cannot be read
+        [[nodiscard]] auto load_policy() const -> pisa::LoadPolicy
+        {
+            pisa::LoadPolicy policy;
+            if (m_lazy) {
+                policy.paging = pisa::LoadPolicy::Paging::Lazy;
+            }
+            policy.populate = m_populate;
+            policy.huge_pages = m_huge_pages;
+            if (m_warmup_log) {
+                std::ifstream is(*m_warmup_log);
+                if (not is) {
+                    throw std::runtime_error(
+                        fmt::format("Cannot read warmup log {}", *m_warmup_log));
+                }
+                policy.warmup_terms = most_frequent_terms(is, m_warmup_top);
+            }
+            policy.pin_budget = m_pin_budget * 1024 * 1024;
+            return policy;
+        }
+
+      private:
+        bool m_lazy = false;
+        std::optional<std::string> m_warmup_log;
+        std::size_t m_warmup_top = 10'000;
+        std::size_t m_pin_budget = 0;
+        bool m_populate = false;
+        bool m_huge_pages = false;
+    };
+
     enum class WandMode : bool { Required, Optional };
 
-    template <WandMode Mode = WandMode::Required>
+    /// Whether a tool can use WAND data built with fixed docid ranges. Only those that can accept
+    /// `--range-wand`, so that others reject it rather than read range WAND data as raw data.
+    enum class WandRange : bool { Unsupported, Supported };
+
+    template <WandMode Mode = WandMode::Required, WandRange Range = WandRange::Unsupported>
     struct WandData {
         explicit WandData(CLI::App* app)
         {
             auto* wand = app->add_option("-w,--wand", m_wand_data_path, "WAND data filename");
-            app->add_flag("--compressed-wand", m_wand_compressed, "Compressed WAND data file")
-                ->needs(wand);
+            auto* compressed =
+                app->add_flag("--compressed-wand", m_wand_compressed, "Compressed WAND data file")
+                    ->needs(wand);
+            if constexpr (Range == WandRange::Supported) {
+                auto description = "WAND data built with fixed docid ranges";
+                app->add_flag("--range-wand", m_wand_range, description)
+                    ->needs(wand)
+                    ->excludes(compressed);
+            }
 
             if constexpr (Mode == WandMode::Required) {
                 wand->required();
@@ -57,6 +155,7 @@ namespace arg {
             }
         }
         [[nodiscard]] auto is_wand_compressed() const -> bool { return m_wand_compressed; }
+        [[nodiscard]] auto is_wand_range() const -> bool { return m_wand_range; }
 
         /// Transform paths for `shard`.
         void apply_shard(Shard_Id shard)
@@ -69,18 +168,48 @@ namespace arg {
       private:
         std::optional<std::string> m_wand_data_path;
         bool m_wand_compressed = false;
+        bool m_wand_range = false;
     };
 
     struct Index: public Encoding {
-        explicit Index(CLI::App* app) : Encoding(app)
+        // The encoding is optional, as indexes with a header record it.
+        explicit Index(CLI::App* app) : Encoding(app, false)
         {
             app->add_option("-i,--index", m_index, "Inverted index filename")->required();
         }
 
         [[nodiscard]] auto index_filename() const -> std::string const& { return m_index; }
 
+        /// The encoding given with `--encoding`, or else the one recorded in the index header.
+        ///
+        /// \throws std::runtime_error  if neither is known, or if they differ
+        [[nodiscard]] auto index_encoding() const -> std::string const&
+        {
+            if (not m_resolved_encoding) {
+                m_resolved_encoding = resolve_encoding();
+            }
+            return *m_resolved_encoding;
+        }
+
       private:
+        [[nodiscard]] auto resolve_encoding() const -> std::string
+        {
+            auto const& encoding = Encoding::index_encoding();
+            auto header = read_index_header(m_index);
+            auto recorded = header ? header->encoding() : std::string{};
+            if (encoding.empty() && recorded.empty()) {
+                throw std::runtime_error(fmt::format(
+                    "Encoding of index {} is not recorded in the index, use --encoding", m_index));
+            }
+            if (not encoding.empty() && not recorded.empty() && encoding != recorded) {
+                throw std::runtime_error(fmt::format(
+                    "Index {} is encoded with {}, not {}", m_index, recorded, encoding));
+            }
+            return encoding.empty() ? recorded : encoding;
+        }
+
         std::string m_index;
+        mutable std::optional<std::string> m_resolved_encoding;
     };
 
     enum class QueryMode : bool { Ranked, Unranked };
@@ -220,13 +349,20 @@ namespace arg {
         {
             m_option = app->add_option(
                 "-T,--thresholds", m_thresholds_filename, "File containing query thresholds");
+            app->add_option(
+                   "--kth-scores",
+                   m_kth_scores_filename,
+                   "K-th score index used to estimate query thresholds")
+                ->excludes(m_option);
         }
 
         [[nodiscard]] auto thresholds_file() const { return m_thresholds_filename; }
+        [[nodiscard]] auto kth_scores_file() const { return m_kth_scores_filename; }
         [[nodiscard]] auto* thresholds_option() { return m_option; }
 
       private:
         std::optional<std::string> m_thresholds_filename;
+        std::optional<std::string> m_kth_scores_filename;
         CLI::Option* m_option;
     };
 
@@ -288,6 +424,10 @@ namespace arg {
                 ->required();
             app->add_option(
                 "--term-count", m_term_count, "Number of distinct terms in the forward index");
+            app->add_option(
+                "--memory-budget",
+                m_memory_budget,
+                "Megabytes of memory to invert and merge batches in, limiting their size");
         }
 
         [[nodiscard]] auto input_basename() const -> std::string { return m_input_basename; }
@@ -297,6 +437,15 @@ namespace arg {
             return m_term_count;
         }
 
+        /// The memory budget in bytes.
+        [[nodiscard]] auto memory_budget() const -> std::optional<std::size_t>
+        {
+            if (m_memory_budget) {
+                return *m_memory_budget * 1024 * 1024;
+            }
+            return std::nullopt;
+        }
+
         /// Transform paths for `shard`.
         void apply_shard(Shard_Id shard)
         {
@@ -308,6 +457,7 @@ namespace arg {
         std::string m_input_basename{};
         std::string m_output_basename{};
         std::optional<std::uint32_t> m_term_count{};
+        std::optional<std::size_t> m_memory_budget{};
     };
 
     struct Compress {
@@ -347,6 +497,14 @@ namespace arg {
                 block_group
                     ->add_option("-l,--lambda", m_lambda, "Lambda parameter for variable blocks")
                     ->excludes(block_size_opt);
+            auto block_opt_size_opt =
+                block_group
+                    ->add_option(
+                        "--opt-block-size",
+                        m_opt_block_size,
+                        "Average block size for score-optimal variable blocks")
+                    ->excludes(block_size_opt)
+                    ->excludes(block_lambda_opt);
             block_group->require_option();
 
             app->add_flag("--compress", m_compress, "Compress additional data");
@@ -354,7 +512,8 @@ namespace arg {
             add_scorer_options(app, *this, ScorerMode::Required);
             app->add_flag("--range", m_range, "Create docid-range based data")
                 ->excludes(block_size_opt)
-                ->excludes(block_lambda_opt);
+                ->excludes(block_lambda_opt)
+                ->excludes(block_opt_size_opt);
             app->add_option(
                 "--terms-to-drop",
                 m_terms_to_drop_filename,
@@ -370,6 +529,10 @@ namespace arg {
                 spdlog::info("Lambda {}", *m_lambda);
                 return VariableBlock(*m_lambda);
             }
+            if (m_opt_block_size) {
+                spdlog::info("Score-optimal block size: {}", *m_opt_block_size);
+                return OptimalBlock(*m_opt_block_size);
+            }
             spdlog::info("Fixed block size: {}", *m_fixed_block_size);
             return FixedBlock(*m_fixed_block_size);
         }
@@ -401,6 +564,7 @@ namespace arg {
       private:
         std::optional<float> m_lambda{};
         std::optional<uint64_t> m_fixed_block_size{};
+        std::optional<uint64_t> m_opt_block_size{};
         std::string m_input_basename;
         std::string m_output;
         ScorerParams m_params;
@@ -410,6 +574,95 @@ namespace arg {
         std::string m_terms_to_drop_filename;
     };
 
+    struct BuildIndex {
+        explicit BuildIndex(CLI::App* app) : m_params("")
+        {
+            app->add_option("-i,--input", m_input_basename, "Forward index basename")->required();
+            app->add_option("-o,--output", m_output, "Output index filename")->required();
+            app->add_option("-w,--wand", m_wand_data_path, "Output WAND data filename")
+                ->required();
+            app->add_option(
+                "--term-count", m_term_count, "Number of distinct terms in the forward index");
+            app->add_option(
+                "--memory-budget",
+                m_memory_budget,
+                "Megabytes of memory to invert and merge batches in, limiting their size");
+            auto block_group = app->add_option_group("blocks");
+            auto block_size_opt = block_group->add_option(
+                "-b,--block-size", m_fixed_block_size, "Block size for fixed-length blocks");
+            auto block_lambda_opt =
+                block_group
+                    ->add_option("-l,--lambda", m_lambda, "Lambda parameter for variable blocks")
+                    ->excludes(block_size_opt);
+            block_group
+                ->add_option(
+                    "--opt-block-size",
+                    m_opt_block_size,
+                    "Average block size for score-optimal variable blocks")
+                ->excludes(block_size_opt)
+                ->excludes(block_lambda_opt);
+            block_group->require_option();
+            add_scorer_options(app, *this, ScorerMode::Required);
+            auto compress =
+                app->add_flag("--compress-wand", m_compress, "Compress additional data");
+            app->add_flag("--quantize", m_quantize, "Quantize scores of the WAND data");
+            app->add_flag("--range", m_range, "Create docid-range based WAND data")
+                ->excludes(compress);
+        }
+
+        [[nodiscard]] auto input_basename() const -> std::string { return m_input_basename; }
+        [[nodiscard]] auto output() const -> std::string { return m_output; }
+        [[nodiscard]] auto wand_data_path() const -> std::string { return m_wand_data_path; }
+        [[nodiscard]] auto term_count() const -> std::optional<std::uint32_t>
+        {
+            return m_term_count;
+        }
+
+        /// The memory budget in bytes.
+        [[nodiscard]] auto memory_budget() const -> std::optional<std::size_t>
+        {
+            if (m_memory_budget) {
+                return *m_memory_budget * 1024 * 1024;
+            }
+            return std::nullopt;
+        }
+
+        [[nodiscard]] auto scorer_params() const { return m_params; }
+        [[nodiscard]] auto block_size() const -> BlockSize
+        {
+            if (m_lambda) {
+                spdlog::info("Lambda {}", *m_lambda);
+                return VariableBlock(*m_lambda);
+            }
+            if (m_opt_block_size) {
+                spdlog::info("Score-optimal block size: {}", *m_opt_block_size);
+                return OptimalBlock(*m_opt_block_size);
+            }
+            spdlog::info("Fixed block size: {}", *m_fixed_block_size);
+            return FixedBlock(*m_fixed_block_size);
+        }
+        [[nodiscard]] auto compress() const -> bool { return m_compress; }
+        [[nodiscard]] auto range() const -> bool { return m_range; }
+        [[nodiscard]] auto quantize() const -> bool { return m_quantize; }
+
+        template <typename T>
+        friend CLI::Option* add_scorer_options(CLI::App* app, T& args, ScorerMode scorer_mode);
+
+      private:
+        std::string m_input_basename{};
+        std::string m_output{};
+        std::string m_wand_data_path{};
+        std::optional<std::uint32_t> m_term_count{};
+        std::optional<std::size_t> m_memory_budget{};
+        std::optional<float> m_lambda{};
+        std::optional<uint64_t> m_fixed_block_size{};
+        std::optional<uint64_t> m_opt_block_size{};
+        ScorerParams m_params;
+        bool m_compress = false;
+        bool m_range = false;
+        bool m_quantize = false;
+    };
+
     struct ReorderDocuments {
         explicit ReorderDocuments(CLI::App* app)
         {
@@ -593,9 +846,15 @@ struct Args: public T... {
 
 using InvertArgs = Args<arg::Invert, arg::Threads, arg::BatchSize<100'000>>;
 using ReorderDocuments = Args<arg::ReorderDocuments, arg::Threads>;
-using CompressArgs =
-    pisa::Args<arg::Compress, arg::Encoding, arg::Quantize<arg::ScorerMode::Optional>>;
+using CompressArgs = pisa::Args<
+    arg::Compress,
+    arg::Encoding,
+    arg::Quantize<arg::ScorerMode::Optional>,
+    arg::DensityThreshold,
+    arg::Threads>;
 using CreateWandDataArgs = pisa::Args<arg::CreateWandData>;
+using BuildIndexArgs =
+    pisa::Args<arg::BuildIndex, arg::Encoding, arg::Threads, arg::BatchSize<100'000>>;
 
 struct TailyStatsArgs: pisa::Args<arg::WandData<arg::WandMode::Required>, arg::Scorer> {
     explicit TailyStatsArgs(CLI::App* app)
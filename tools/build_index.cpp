@@ -0,0 +1,78 @@
+#include <string>
+#include <tuple>
+
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <tbb/global_control.h>
+
+#include "CLI/CLI.hpp"
+#include "app.hpp"
+#include "build_index.hpp"
+#include "index_types.hpp"
+#include "wand_data.hpp"
+
+using namespace pisa;
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+using wand_range_index = wand_data<wand_data_range<128, 1024>>;
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+    CLI::App app{
+        "Builds a compressed index and its WAND data from a forward index in one pass, "
+        "without writing the inverted index."};
+    BuildIndexArgs args(&app);
+    CLI11_PARSE(app, argc, argv);
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, args.threads() + 1);
+    spdlog::info("Number of worker threads: {}", args.threads());
+
+    auto params = std::make_tuple(
+        args.input_basename(),
+        args.output(),
+        args.wand_data_path(),
+        args.index_encoding(),
+        args.scorer_params(),
+        args.block_size(),
+        args.quantize(),
+        args.batch_size(),
+        args.threads(),
+        args.term_count(),
+        args.memory_budget());
+
+    try {
+        /**/
+        if (false) {
+#define LOOP_BODY(R, DATA, T)                                                                     \
+    }                                                                                             \
+    else if (args.index_encoding() == BOOST_PP_STRINGIZE(T))                                      \
+    {                                                                                             \
+        using index_type = BOOST_PP_CAT(T, _index);                                               \
+        if (args.compress()) {                                                                    \
+            std::apply(build_index<index_type, wand_uniform_index>, params);                      \
+        } else if (args.range()) {                                                                \
+            std::apply(build_index<index_type, wand_range_index>, params);                        \
+        } else {                                                                                  \
+            std::apply(build_index<index_type, wand_raw_index>, params);                          \
+        }
+            /**/
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_BLOCK_INDEX_TYPES);
+#undef LOOP_BODY
+
+        } else {
+            spdlog::error(
+                "Unknown type {}, indexes are built in one pass with block codecs only",
+                args.index_encoding());
+            return 1;
+        }
+    } catch (io::NoSuchFile const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    } catch (std::invalid_argument const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "app.hpp"
+#include "binary_freq_collection.hpp"
+#include "configuration.hpp"
+#include "index_types.hpp"
+#include "linear_quantizer.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "scorer/scorer.hpp"
+#include "util/progress.hpp"
+#include "util/util.hpp"
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+template <typename Scorer>
+void quantize_scores(
+    Scorer const& scorer,
+    LinearQuantizer const& quantizer,
+    std::size_t term_id,
+    binary_freq_collection::sequence const& plist,
+    std::vector<std::uint32_t>& impacts)
+{
+    auto term_scorer = scorer.term_scorer(term_id);
+    impacts.clear();
+    for (std::size_t pos = 0; pos < plist.docs.size(); ++pos) {
+        auto doc = *(plist.docs.begin() + pos);
+        auto freq = *(plist.freqs.begin() + pos);
+        impacts.push_back(quantizer(term_scorer(doc, freq)));
+    }
+}
+
+template <typename IndexType, typename WandType>
+void compress_impact_ordered_index(
+    std::string const& input_basename,
+    std::string const& wand_data_filename,
+    ScorerParams const& scorer_params,
+    std::string const& output_filename,
+    bool check)
+{
+    binary_freq_collection input(input_basename.c_str());
+    WandType const wdata(MemorySource::mapped_file(wand_data_filename));
+    auto scorer = scorer::from_params(scorer_params, wdata);
+    LinearQuantizer quantizer(wdata.index_max_term_weight(), configuration::get().quantization_bits);
+
+    spdlog::info("Processing {} documents", input.num_docs());
+    double tick = get_time_usecs();
+
+    global_parameters params;
+    typename IndexType::builder builder(input.num_docs(), params);
+    std::vector<std::uint32_t> impacts;
+    {
+        pisa::progress progress("Create index", input.size());
+        std::size_t term_id = 0;
+        for (auto const& plist: input) {
+            quantize_scores(*scorer, quantizer, term_id, plist, impacts);
+            builder.add_posting_list(plist.docs.size(), plist.docs.begin(), impacts.begin());
+            progress.update(1);
+            term_id += 1;
+        }
+    }
+    {
+        IndexType index;
+        builder.build(index);
+        double elapsed_secs = (get_time_usecs() - tick) / 1000000;
+        spdlog::info("Index compressed in {} seconds", elapsed_secs);
+        mapper::freeze(index, output_filename.c_str());
+    }
+
+    if (check) {
+        spdlog::info("Checking the written data, just to be extra safe...");
+        IndexType index(MemorySource::mapped_file(output_filename));
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> expected;
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> actual;
+        std::size_t term_id = 0;
+        for (auto const& plist: input) {
+            quantize_scores(*scorer, quantizer, term_id, plist, impacts);
+            expected.clear();
+            for (std::size_t pos = 0; pos < plist.docs.size(); ++pos) {
+                if (impacts[pos] > 0) {
+                    expected.emplace_back(*(plist.docs.begin() + pos), impacts[pos]);
+                }
+            }
+            actual.clear();
+            for (auto segments = index[term_id]; not segments.empty();) {
+                auto impact = segments.impact();
+                segments.consume_segment([&](auto docid) { actual.emplace_back(docid, impact); });
+            }
+            std::sort(actual.begin(), actual.end());
+            if (actual != expected) {
+                spdlog::error("Postings of term {} differ", term_id);
+                std::exit(1);
+            }
+            term_id += 1;
+        }
+        spdlog::info("Everything is OK!");
+    }
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+
+int main(int argc, char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    App<arg::Compress, arg::Encoding, arg::WandData<arg::WandMode::Required>, arg::Scorer> app{
+        "Compresses an impact-ordered inverted index of quantized scores, "
+        "used for score-at-a-time query processing."};
+    CLI11_PARSE(app, argc, argv);
+
+    auto params = std::make_tuple(
+        app.input_basename(), app.wand_data_path(), app.scorer_params(), app.output(), app.check());
+
+    /**/
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                                     \
+    }                                                                                             \
+    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                       \
+    {                                                                                             \
+        using index_type = BOOST_PP_CAT(T, _impact_index);                                        \
+        if (app.is_wand_compressed()) {                                                           \
+            std::apply(compress_impact_ordered_index<index_type, wand_uniform_index>, params);    \
+        } else {                                                                                  \
+            std::apply(compress_impact_ordered_index<index_type, wand_raw_index>, params);        \
+        }
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_BLOCK_INDEX_TYPES);
+#undef LOOP_BODY
+
+    } else {
+        spdlog::error(
+            "Unknown type {}, impact-ordered indexes use block codecs", app.index_encoding());
+        return 1;
+    }
+}
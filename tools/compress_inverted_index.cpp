@@ -8,6 +8,7 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <tbb/global_control.h>
 
 #include "CLI/CLI.hpp"
 #include "app.hpp"
@@ -25,6 +26,8 @@ int main(int argc, char** argv)
     CLI::App app{"Compresses an inverted index"};
     pisa::CompressArgs args(&app);
     CLI11_PARSE(app, argc, argv);
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, args.threads() + 1);
+    spdlog::info("Number of worker threads: {}", args.threads());
     pisa::compress(
         args.input_basename(),
         args.wand_data_path(),
@@ -32,5 +35,6 @@ int main(int argc, char** argv)
         args.output(),
         args.scorer_params(),
         args.quantize(),
-        args.check());
+        args.check(),
+        args.density_threshold());
 }
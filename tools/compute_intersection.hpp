@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <mio/mmap.hpp>
+#include <spdlog/spdlog.h>
+
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "intersection.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "query/queries.hpp"
+#include "wand_types.hpp"
+
+namespace pisa {
+
+template <typename IndexType, typename WandType>
+void compute_intersection(
+    std::string const& index_filename,
+    std::optional<std::string> const& wand_data_filename,
+    std::vector<Query> const& queries,
+    intersection::IntersectionType intersection_type,
+    std::optional<std::uint8_t> max_term_count)
+{
+    IndexType index(MemorySource::mapped_file(index_filename), 0);
+
+    WandType wdata;
+
+    mio::mmap_source md;
+    if (wand_data_filename) {
+        std::error_code error;
+        md.map(*wand_data_filename, error);
+        if (error) {
+            spdlog::error("error mapping file: {}, exiting...", error.message());
+            std::abort();
+        }
+        mapper::map(wdata, md, mapper::map_flags::warmup);
+    }
+
+    std::size_t qid = 0U;
+
+    auto print_intersection = [&](auto const& query, auto const& mask) {
+        auto intersection = Intersection::compute(index, wdata, query, mask);
+        std::cout << fmt::format(
+            "{}\t{}\t{}\t{}\n",
+            query.id ? *query.id : std::to_string(qid),
+            mask.to_ulong(),
+            intersection.length,
+            intersection.max_score);
+    };
+
+    for (auto&& query: queries) {
+        if (intersection_type == intersection::IntersectionType::Combinations) {
+            for_all_subsets(query, max_term_count, print_intersection);
+        } else {
+            auto intersection = Intersection::compute(index, wdata, query);
+            std::cout << fmt::format(
+                "{}\t{}\t{}\n",
+                query.id ? *query.id : std::to_string(qid),
+                intersection.length,
+                intersection.max_score);
+        }
+        qid += 1;
+    }
+}
+
+using ComputeIntersectionFn = void(
+    std::string const& index_filename,
+    std::optional<std::string> const& wand_data_filename,
+    std::vector<Query> const& queries,
+    intersection::IntersectionType intersection_type,
+    std::optional<std::uint8_t> max_term_count);
+
+}  // namespace pisa
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/range/adaptor/transformed.hpp>
+
+#include "index_types.hpp"
+#include "memory_source.hpp"
+#include "query/queries.hpp"
+
+namespace pisa {
+
+template <typename Index>
+void count_postings(
+    std::string const& index_filename,
+    std::vector<pisa::Query> const& queries,
+    std::string const& separator,
+    bool sum,
+    bool print_qid)
+{
+    Index index(MemorySource::mapped_file(index_filename));
+    auto body = [&] {
+        if (sum) {
+            return std::function<void(Query const&)>([&](auto const& query) {
+                auto count = std::accumulate(
+                    query.terms.begin(), query.terms.end(), 0, [&](auto s, auto term_id) {
+                        return s + index[term_id].size();
+                    });
+                std::cout << count << '\n';
+            });
+        }
+        return std::function<void(Query const&)>([&](auto const& query) {
+            std::cout << boost::algorithm::join(
+                query.terms | boost::adaptors::transformed([&index](auto term_id) {
+                    return std::to_string(index[term_id].size());
+                }),
+                separator);
+            std::cout << '\n';
+        });
+    }();
+    for (auto const& query: queries) {
+        if (print_qid && query.id) {
+            std::cout << *query.id << ":";
+        }
+        body(query);
+    }
+}
+
+using CountPostingsFn = void(
+    std::string const& index_filename,
+    std::vector<pisa::Query> const& queries,
+    std::string const& separator,
+    bool sum,
+    bool print_qid);
+
+}  // namespace pisa
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <CLI/CLI.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/functional/hash.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "app.hpp"
+#include "create_kth_score_index.hpp"
+#include "index_registry.hpp"
+#include "wand_types.hpp"
+
+using namespace pisa;
+
+auto read_pairs(std::string const& pairs_filename)
+    -> std::vector<std::pair<term_id_type, term_id_type>>
+{
+    std::vector<std::pair<term_id_type, term_id_type>> pairs;
+    std::ifstream is(pairs_filename);
+    std::string line;
+    while (std::getline(is, line)) {
+        std::vector<std::string> term_ids;
+        boost::algorithm::split(
+            term_ids, line, boost::is_any_of(" \t"), boost::algorithm::token_compress_on);
+        if (term_ids.size() != 2) {
+            throw std::runtime_error(fmt::format("Expected a pair of terms in line: {}", line));
+        }
+        pairs.emplace_back(std::stoul(term_ids[0]), std::stoul(term_ids[1]));
+    }
+    return pairs;
+}
+
+/// Selects the `max_pairs` term pairs co-occurring in the most queries,
+/// among those co-occurring in at least `min_frequency` queries.
+auto frequent_pairs(
+    std::vector<Query> const& queries, std::size_t max_pairs, std::size_t min_frequency)
+    -> std::vector<std::pair<term_id_type, term_id_type>>
+{
+    using term_pair = std::pair<term_id_type, term_id_type>;
+    std::unordered_map<term_pair, std::size_t, boost::hash<term_pair>> frequencies;
+    for (auto const& query: queries) {
+        auto terms = query.terms;
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+        for (std::size_t left = 0; left < terms.size(); ++left) {
+            for (std::size_t right = left + 1; right < terms.size(); ++right) {
+                frequencies[{terms[left], terms[right]}] += 1;
+            }
+        }
+    }
+    std::vector<std::pair<std::size_t, term_pair>> candidates;
+    for (auto const& [pair, frequency]: frequencies) {
+        if (frequency >= min_frequency) {
+            candidates.emplace_back(frequency, pair);
+        }
+    }
+    auto selected = std::min(max_pairs, candidates.size());
+    std::partial_sort(
+        candidates.begin(),
+        std::next(candidates.begin(), selected),
+        candidates.end(),
+        [](auto const& lhs, auto const& rhs) {
+            return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+        });
+    std::vector<term_pair> pairs;
+    pairs.reserve(selected);
+    std::transform(
+        candidates.begin(),
+        std::next(candidates.begin(), selected),
+        std::back_inserter(pairs),
+        [](auto const& candidate) { return candidate.second; });
+    spdlog::info(
+        "Selected {} of {} pairs occurring in at least {} queries",
+        pairs.size(),
+        frequencies.size(),
+        min_frequency);
+    return pairs;
+}
+
+int main(int argc, const char** argv)
+{
+    spdlog::drop("");
+    spdlog::set_default_logger(spdlog::stderr_color_mt(""));
+
+    std::optional<std::string> pairs_filename;
+    std::string output_filename;
+    std::vector<std::uint64_t> ks{10, 100, 1000};
+    std::size_t max_pairs = 1'000'000;
+    std::size_t min_pair_frequency = 2;
+    bool quantized = false;
+
+    App<arg::Index,
+        arg::WandData<arg::WandMode::Required>,
+        arg::Query<arg::QueryMode::Unranked>,
+        arg::Scorer>
+        app{"Computes the k-th highest scores of all terms, and of the given term pairs or "
+            "those co-occurring the most in a query log, used to estimate query thresholds."};
+    app.add_option("-k", ks, "The numbers of top results", true);
+    auto* pairs_option = app.add_option(
+        "-p,--pairs",
+        pairs_filename,
+        "A file containing term pairs, one tab-separated pair per line");
+    app.add_option(
+           "--max-pairs", max_pairs, "Maximum number of pairs selected from the queries", true)
+        ->excludes(pairs_option);
+    app.add_option(
+           "--min-pair-frequency",
+           min_pair_frequency,
+           "Minimum number of queries in which a selected pair occurs",
+           true)
+        ->excludes(pairs_option);
+    app.add_option("-o,--output", output_filename, "Output filename")->required();
+    app.add_flag("--quantized", quantized, "Quantizes the scores");
+
+    CLI11_PARSE(app, argc, argv);
+
+    std::sort(ks.begin(), ks.end());
+    ks.erase(std::unique(ks.begin(), ks.end()), ks.end());
+    if (ks.empty() || ks.front() == 0) {
+        spdlog::error("Values of k must be positive");
+        return 1;
+    }
+
+    std::vector<std::pair<term_id_type, term_id_type>> pairs;
+    if (pairs_filename) {
+        pairs = read_pairs(*pairs_filename);
+    } else if (app.query_file()) {
+        pairs = frequent_pairs(app.queries(), max_pairs, min_pair_frequency);
+    }
+
+    auto wand_type = wand_type_name(app.is_wand_compressed(), quantized, false);
+    auto* run = IndexRegistry<CreateKthScoreIndexFn>::instance().find(
+        index_registry_key(app.index_encoding(), wand_type));
+    if (run == nullptr) {
+        spdlog::error("Unknown type {}", app.index_encoding());
+        return 0;
+    }
+    run(app.index_filename(),
+        app.wand_data_path(),
+        app.index_encoding(),
+        app.scorer_params(),
+        ks,
+        pairs,
+        output_filename);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include "cursor/max_scored_cursor.hpp"
+#include "index_types.hpp"
+#include "kth_score_index.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "query/algorithm.hpp"
+#include "query/queries.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_types.hpp"
+
+namespace pisa {
+
+/// Appends to `out` the `k`-th score of the sorted `results` for each `k` in `ks`,
+/// or 0 if there are fewer than `k` results.
+inline void append_kth_scores(
+    std::vector<topk_queue::entry_type> const& results,
+    std::vector<std::uint64_t> const& ks,
+    std::vector<float>& out)
+{
+    for (auto k: ks) {
+        out.push_back(results.size() >= k ? results[k - 1].first : 0.0F);
+    }
+}
+
+template <typename IndexType, typename WandType>
+void create_kth_score_index(
+    const std::string& index_filename,
+    const std::string& wand_data_filename,
+    std::string const& type,
+    ScorerParams const& scorer_params,
+    std::vector<std::uint64_t> const& ks,
+    std::vector<std::pair<term_id_type, term_id_type>> const& pairs,
+    std::string const& output_filename)
+{
+    IndexType index(MemorySource::mapped_file(index_filename));
+    WandType const wdata(MemorySource::mapped_file(wand_data_filename));
+    auto scorer = scorer::from_params(scorer_params, wdata);
+    auto max_k = ks.back();
+
+    spdlog::info("Computing k-th scores of {} terms", index.size());
+    std::vector<float> term_scores(index.size() * ks.size(), 0.0F);
+    tbb::parallel_for(
+        tbb::blocked_range<std::size_t>(0, index.size()),
+        [&](tbb::blocked_range<std::size_t> const& terms) {
+            topk_queue topk(max_k);
+            std::vector<float> scores;
+            for (auto term = terms.begin(); term != terms.end(); ++term) {
+                auto list = index[term];
+                if (list.size() < ks.front()) {
+                    continue;
+                }
+                auto term_scorer = scorer->term_scorer(term);
+                for (; list.docid() < index.num_docs(); list.next()) {
+                    topk.insert(term_scorer(list.docid(), list.freq()));
+                }
+                topk.finalize();
+                scores.clear();
+                append_kth_scores(topk.topk(), ks, scores);
+                std::copy(
+                    scores.begin(), scores.end(), std::next(term_scores.begin(), term * ks.size()));
+                topk.clear();
+            }
+        });
+
+    spdlog::info("Computing k-th scores of {} pairs", pairs.size());
+    std::vector<std::pair<KthScoreIndex::term_pair, std::vector<float>>> pair_scores(pairs.size());
+    tbb::parallel_for(
+        tbb::blocked_range<std::size_t>(0, pairs.size()),
+        [&](tbb::blocked_range<std::size_t> const& range) {
+            topk_queue topk(max_k);
+            for (auto idx = range.begin(); idx != range.end(); ++idx) {
+                Query query{{}, {pairs[idx].first, pairs[idx].second}, {}};
+                wand_query wand_q(topk);
+                wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+                topk.finalize();
+                pair_scores[idx].first = pairs[idx];
+                append_kth_scores(topk.topk(), ks, pair_scores[idx].second);
+                topk.clear();
+            }
+        });
+
+    KthScoreIndex kth_scores(ks, std::move(term_scores), pair_scores);
+    spdlog::info("Writing {}", output_filename);
+    mapper::freeze(kth_scores, output_filename.c_str());
+}
+
+using CreateKthScoreIndexFn = void(
+    const std::string& index_filename,
+    const std::string& wand_data_filename,
+    std::string const& type,
+    ScorerParams const& scorer_params,
+    std::vector<std::uint64_t> const& ks,
+    std::vector<std::pair<term_id_type, term_id_type>> const& pairs,
+    std::string const& output_filename);
+
+}  // namespace pisa
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <mio/mmap.hpp>
+#include <range/v3/view/enumerate.hpp>
+#include <spdlog/spdlog.h>
+#include <tbb/parallel_for.h>
+
+#include "accumulator/lazy_accumulator.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/range_max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "kth_score_index.hpp"
+#include "memory_source.hpp"
+#include "payload_vector.hpp"
+#include "query/algorithm.hpp"
+#include "query/queries.hpp"
+#include "scorer/scorer.hpp"
+#include "util/util.hpp"
+#include "wand_types.hpp"
+
+namespace pisa {
+
+template <typename IndexType, typename WandType>
+void evaluate_queries(
+    const std::string& index_filename,
+    const std::string& wand_data_filename,
+    const std::vector<Query>& queries,
+    const std::optional<std::string>& thresholds_filename,
+    const std::optional<std::string>& kth_scores_filename,
+    std::string const& type,
+    std::string const& query_type,
+    uint64_t k,
+    std::string const& documents_filename,
+    ScorerParams const& scorer_params,
+    std::string const& run_id,
+    std::string const& iteration)
+{
+    IndexType index(MemorySource::mapped_file(index_filename));
+    WandType const wdata(MemorySource::mapped_file(wand_data_filename));
+
+    auto scorer = scorer::from_params(scorer_params, wdata);
+
+    std::optional<KthScoreIndex> kth_scores;
+    if (kth_scores_filename) {
+        kth_scores.emplace(MemorySource::mapped_file(*kth_scores_filename));
+    }
+    auto initial_threshold = [&](Query const& query) -> Threshold {
+        return kth_scores ? kth_scores->estimate_threshold(query, k) : 0.0F;
+    };
+    std::function<std::vector<std::pair<float, uint64_t>>(Query)> query_fun;
+
+    if (query_type == "wand") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            topk.set_threshold(initial_threshold(query));
+            wand_query wand_q(topk);
+            wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "block_max_wand") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            topk.set_threshold(initial_threshold(query));
+            block_max_wand_query block_max_wand_q(topk);
+            block_max_wand_q(
+                make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "block_max_wand_simd") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            topk.set_threshold(initial_threshold(query));
+            block_max_wand_simd_query block_max_wand_simd_q(topk);
+            block_max_wand_simd_q(
+                make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "block_max_maxscore") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            topk.set_threshold(initial_threshold(query));
+            block_max_maxscore_query block_max_maxscore_q(topk);
+            block_max_maxscore_q(
+                make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "range_maxscore") {
+        if constexpr (std::is_same_v<WandType, wand_range_index>) {
+            query_fun = [&](Query query) {
+                topk_queue topk(k);
+                range_maxscore_query range_maxscore_q(topk);
+                range_maxscore_q(
+                    make_range_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+                topk.finalize();
+                return topk.topk();
+            };
+        } else {
+            spdlog::error("Query type {} requires range WAND data (--range-wand)", query_type);
+            return;
+        }
+    } else if (query_type == "block_max_ranked_and") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            block_max_ranked_and_query block_max_ranked_and_q(topk);
+            block_max_ranked_and_q(
+                make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "ranked_and") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            ranked_and_query ranked_and_q(topk);
+            ranked_and_q(make_scored_cursors(index, *scorer, query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "ranked_or") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            ranked_or_query ranked_or_q(topk);
+            ranked_or_q(make_scored_cursors(index, *scorer, query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "maxscore") {
+        query_fun = [&](Query query) {
+            topk_queue topk(k);
+            topk.set_threshold(initial_threshold(query));
+            maxscore_query maxscore_q(topk);
+            maxscore_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "ranked_or_taat") {
+        query_fun = [&, accumulator = Simple_Accumulator(index.num_docs())](Query query) mutable {
+            topk_queue topk(k);
+            ranked_or_taat_query ranked_or_taat_q(topk);
+            ranked_or_taat_q(
+                make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "ranked_or_taat_lazy") {
+        query_fun = [&, accumulator = Lazy_Accumulator<4>(index.num_docs())](Query query) mutable {
+            topk_queue topk(k);
+            ranked_or_taat_query ranked_or_taat_q(topk);
+            ranked_or_taat_q(
+                make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
+            topk.finalize();
+            return topk.topk();
+        };
+    } else {
+        spdlog::error("Unsupported query type: {}", query_type);
+    }
+
+    auto source = std::make_shared<mio::mmap_source>(documents_filename.c_str());
+    auto docmap = Payload_Vector<>::from(*source);
+
+    std::vector<std::vector<std::pair<float, uint64_t>>> raw_results(queries.size());
+    auto start_batch = std::chrono::steady_clock::now();
+    tbb::parallel_for(size_t(0), queries.size(), [&, query_fun](size_t query_idx) {
+        raw_results[query_idx] = query_fun(queries[query_idx]);
+    });
+    auto end_batch = std::chrono::steady_clock::now();
+
+    for (size_t query_idx = 0; query_idx < raw_results.size(); ++query_idx) {
+        auto results = raw_results[query_idx];
+        auto qid = queries[query_idx].id;
+        for (auto&& [rank, result]: ranges::views::enumerate(results)) {
+            std::cout << fmt::format(
+                "{}\t{}\t{}\t{}\t{}\t{}\n",
+                qid.value_or(std::to_string(query_idx)),
+                iteration,
+                docmap[result.second],
+                rank,
+                result.first,
+                run_id);
+        }
+    }
+    auto end_print = std::chrono::steady_clock::now();
+    double batch_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end_batch - start_batch).count();
+    double batch_with_print_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end_print - start_batch).count();
+    spdlog::info("Time taken to process queries: {}ms", batch_ms);
+    spdlog::info("Time taken to process queries with printing: {}ms", batch_with_print_ms);
+}
+
+using EvaluateQueriesFn = void(
+    std::string const& index_filename,
+    std::string const& wand_data_filename,
+    std::vector<Query> const& queries,
+    std::optional<std::string> const& thresholds_filename,
+    std::optional<std::string> const& kth_scores_filename,
+    std::string const& type,
+    std::string const& query_type,
+    uint64_t k,
+    std::string const& documents_filename,
+    ScorerParams const& scorer_params,
+    std::string const& run_id,
+    std::string const& iteration);
+
+}  // namespace pisa
@@ -28,10 +28,14 @@ int main(int argc, char** argv)
             args.output_basename(),
             args.batch_size(),
             args.threads(),
-            args.term_count());
+            args.term_count(),
+            args.memory_budget());
         return 0;
     } catch (pisa::io::NoSuchFile err) {
         spdlog::error("{}", err.what());
         return 1;
+    } catch (std::invalid_argument const& err) {
+        spdlog::error("{}", err.what());
+        return 1;
     }
 }
@@ -1,161 +1,17 @@
-#include <iostream>
 #include <optional>
-#include <unordered_set>
+#include <string>
 
-#include "boost/algorithm/string/classification.hpp"
-#include "boost/algorithm/string/split.hpp"
-#include <boost/functional/hash.hpp>
-
-#include "mio/mmap.hpp"
-#include "spdlog/sinks/stdout_color_sinks.h"
-#include "spdlog/spdlog.h"
-
-#include "mappable/mapper.hpp"
+#include <CLI/CLI.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
 
 #include "app.hpp"
-#include "cursor/max_scored_cursor.hpp"
-#include "index_types.hpp"
-#include "io.hpp"
-#include "query/algorithm.hpp"
-#include "util/util.hpp"
-#include "wand_data_compressed.hpp"
-#include "wand_data_raw.hpp"
-
-#include "query/algorithm.hpp"
-#include "scorer/scorer.hpp"
-
-#include "CLI/CLI.hpp"
+#include "index_registry.hpp"
+#include "kth_threshold.hpp"
+#include "wand_types.hpp"
 
 using namespace pisa;
 
-std::set<uint32_t> parse_tuple(std::string const& line, size_t k)
-{
-    std::vector<std::string> term_ids;
-    boost::algorithm::split(term_ids, line, boost::is_any_of(" \t"));
-    if (term_ids.size() != k) {
-        throw std::runtime_error(fmt::format(
-            "Wrong number of terms in line: {} (expected {} but found {})", line, k, term_ids.size()));
-    }
-
-    std::set<uint32_t> term_ids_int;
-    for (auto&& term_id: term_ids) {
-        try {
-            term_ids_int.insert(std::stoi(term_id));
-        } catch (...) {
-            throw std::runtime_error(
-                fmt::format("Cannot convert {} to int in line: {}", term_id, line));
-        }
-    }
-    return term_ids_int;
-}
-
-template <typename IndexType, typename WandType>
-void kt_thresholds(
-    const std::string& index_filename,
-    const std::string& wand_data_filename,
-    const std::vector<Query>& queries,
-    std::string const& type,
-    ScorerParams const& scorer_params,
-    uint64_t k,
-    bool quantized,
-    std::optional<std::string> pairs_filename,
-    std::optional<std::string> triples_filename,
-    bool all_pairs,
-    bool all_triples)
-{
-    IndexType index;
-    mio::mmap_source m(index_filename.c_str());
-    mapper::map(index, m);
-
-    WandType wdata;
-
-    auto scorer = scorer::from_params(scorer_params, wdata);
-
-    mio::mmap_source md;
-    std::error_code error;
-    md.map(wand_data_filename, error);
-    if (error) {
-        spdlog::error("error mapping file: {}, exiting...", error.message());
-        std::abort();
-    }
-    mapper::map(wdata, md, mapper::map_flags::warmup);
-
-    using Pair = std::set<uint32_t>;
-    std::unordered_set<Pair, boost::hash<Pair>> pairs_set;
-
-    using Triple = std::set<uint32_t>;
-    std::unordered_set<Triple, boost::hash<Triple>> triples_set;
-
-    std::string line;
-    if (all_pairs) {
-        spdlog::info("All pairs are available.");
-    }
-    if (pairs_filename) {
-        std::ifstream pin(*pairs_filename);
-        while (std::getline(pin, line)) {
-            pairs_set.insert(parse_tuple(line, 2));
-        }
-        spdlog::info("Number of pairs loaded: {}", pairs_set.size());
-    }
-
-    if (all_triples) {
-        spdlog::info("All triples are available.");
-    }
-    if (triples_filename) {
-        std::ifstream trin(*triples_filename);
-        while (std::getline(trin, line)) {
-            triples_set.insert(parse_tuple(line, 3));
-        }
-        spdlog::info("Number of triples loaded: {}", triples_set.size());
-    }
-
-    for (auto const& query: queries) {
-        float threshold = 0;
-
-        auto terms = query.terms;
-        topk_queue topk(k);
-        wand_query wand_q(topk);
-
-        for (auto&& term: terms) {
-            Query query;
-            query.terms.push_back(term);
-            wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-            threshold = std::max(threshold, topk.size() == k ? topk.threshold() : 0.0F);
-            topk.clear();
-        }
-        for (size_t i = 0; i < terms.size(); ++i) {
-            for (size_t j = i + 1; j < terms.size(); ++j) {
-                if (pairs_set.count({terms[i], terms[j]}) > 0 or all_pairs) {
-                    Query query;
-                    query.terms = {terms[i], terms[j]};
-                    wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                    threshold = std::max(threshold, topk.size() == k ? topk.threshold() : 0.0F);
-                    topk.clear();
-                }
-            }
-        }
-        for (size_t i = 0; i < terms.size(); ++i) {
-            for (size_t j = i + 1; j < terms.size(); ++j) {
-                for (size_t s = j + 1; s < terms.size(); ++s) {
-                    if (triples_set.count({terms[i], terms[j], terms[s]}) > 0 or all_triples) {
-                        Query query;
-                        query.terms = {terms[i], terms[j], terms[s]};
-                        wand_q(
-                            make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                        threshold = std::max(threshold, topk.size() == k ? topk.threshold() : 0.0F);
-                        topk.clear();
-                    }
-                }
-            }
-        }
-        std::cout << threshold << '\n';
-    }
-}
-
-using wand_raw_index = wand_data<wand_data_raw>;
-using wand_uniform_index = wand_data<wand_data_compressed<>>;
-using wand_uniform_index_quantized = wand_data<wand_data_compressed<PayloadType::Quantized>>;
-
 int main(int argc, const char** argv)
 {
     spdlog::drop("");
@@ -188,8 +44,14 @@ int main(int argc, const char** argv)
 
     CLI11_PARSE(app, argc, argv);
 
-    auto params = std::make_tuple(
-        app.index_filename(),
+    auto wand_type = wand_type_name(app.is_wand_compressed(), quantized, false);
+    auto* run = IndexRegistry<KthThresholdsFn>::instance().find(
+        index_registry_key(app.index_encoding(), wand_type));
+    if (run == nullptr) {
+        spdlog::error("Unknown type {}", app.index_encoding());
+        return 0;
+    }
+    run(app.index_filename(),
         app.wand_data_path(),
         app.queries(),
         app.index_encoding(),
@@ -200,28 +62,4 @@ int main(int argc, const char** argv)
         triples_filename,
         all_pairs,
         all_triples);
-
-    /**/
-    if (false) {
-#define LOOP_BODY(R, DATA, T)                                                                      \
-    }                                                                                              \
-    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                        \
-    {                                                                                              \
-        if (app.is_wand_compressed()) {                                                            \
-            if (quantized) {                                                                       \
-                std::apply(                                                                        \
-                    kt_thresholds<BOOST_PP_CAT(T, _index), wand_uniform_index_quantized>, params); \
-            } else {                                                                               \
-                std::apply(kt_thresholds<BOOST_PP_CAT(T, _index), wand_uniform_index>, params);    \
-            }                                                                                      \
-        } else {                                                                                   \
-            std::apply(kt_thresholds<BOOST_PP_CAT(T, _index), wand_raw_index>, params);            \
-        }
-        /**/
-        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
-#undef LOOP_BODY
-
-    } else {
-        spdlog::error("Unknown type {}", app.index_encoding());
-    }
 }
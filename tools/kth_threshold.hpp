@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/functional/hash.hpp>
+#include <fmt/format.h>
+#include <mio/mmap.hpp>
+#include <spdlog/spdlog.h>
+
+#include "cursor/max_scored_cursor.hpp"
+#include "index_types.hpp"
+#include "mappable/mapper.hpp"
+#include "memory_source.hpp"
+#include "query/algorithm.hpp"
+#include "query/queries.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_types.hpp"
+
+namespace pisa {
+
+inline std::set<uint32_t> parse_tuple(std::string const& line, size_t k)
+{
+    std::vector<std::string> term_ids;
+    boost::algorithm::split(term_ids, line, boost::is_any_of(" \t"));
+    if (term_ids.size() != k) {
+        throw std::runtime_error(fmt::format(
+            "Wrong number of terms in line: {} (expected {} but found {})", line, k, term_ids.size()));
+    }
+
+    std::set<uint32_t> term_ids_int;
+    for (auto&& term_id: term_ids) {
+        try {
+            term_ids_int.insert(std::stoi(term_id));
+        } catch (...) {
+            throw std::runtime_error(
+                fmt::format("Cannot convert {} to int in line: {}", term_id, line));
+        }
+    }
+    return term_ids_int;
+}
+
+template <typename IndexType, typename WandType>
+void kt_thresholds(
+    const std::string& index_filename,
+    const std::string& wand_data_filename,
+    const std::vector<Query>& queries,
+    std::string const& type,
+    ScorerParams const& scorer_params,
+    uint64_t k,
+    bool quantized,
+    std::optional<std::string> pairs_filename,
+    std::optional<std::string> triples_filename,
+    bool all_pairs,
+    bool all_triples)
+{
+    IndexType index(MemorySource::mapped_file(index_filename), 0);
+
+    WandType wdata;
+
+    auto scorer = scorer::from_params(scorer_params, wdata);
+
+    mio::mmap_source md;
+    std::error_code error;
+    md.map(wand_data_filename, error);
+    if (error) {
+        spdlog::error("error mapping file: {}, exiting...", error.message());
+        std::abort();
+    }
+    mapper::map(wdata, md, mapper::map_flags::warmup);
+
+    using Pair = std::set<uint32_t>;
+    std::unordered_set<Pair, boost::hash<Pair>> pairs_set;
+
+    using Triple = std::set<uint32_t>;
+    std::unordered_set<Triple, boost::hash<Triple>> triples_set;
+
+    std::string line;
+    if (all_pairs) {
+        spdlog::info("All pairs are available.");
+    }
+    if (pairs_filename) {
+        std::ifstream pin(*pairs_filename);
+        while (std::getline(pin, line)) {
+            pairs_set.insert(parse_tuple(line, 2));
+        }
+        spdlog::info("Number of pairs loaded: {}", pairs_set.size());
+    }
+
+    if (all_triples) {
+        spdlog::info("All triples are available.");
+    }
+    if (triples_filename) {
+        std::ifstream trin(*triples_filename);
+        while (std::getline(trin, line)) {
+            triples_set.insert(parse_tuple(line, 3));
+        }
+        spdlog::info("Number of triples loaded: {}", triples_set.size());
+    }
+
+    for (auto const& query: queries) {
+        float threshold = 0;
+
+        auto terms = query.terms;
+        topk_queue topk(k);
+        wand_query wand_q(topk);
+
+        for (auto&& term: terms) {
+            Query query;
+            query.terms.push_back(term);
+            wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+            threshold = std::max(threshold, topk.size() == k ? topk.threshold() : 0.0F);
+            topk.clear();
+        }
+        for (size_t i = 0; i < terms.size(); ++i) {
+            for (size_t j = i + 1; j < terms.size(); ++j) {
+                if (pairs_set.count({terms[i], terms[j]}) > 0 or all_pairs) {
+                    Query query;
+                    query.terms = {terms[i], terms[j]};
+                    wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+                    threshold = std::max(threshold, topk.size() == k ? topk.threshold() : 0.0F);
+                    topk.clear();
+                }
+            }
+        }
+        for (size_t i = 0; i < terms.size(); ++i) {
+            for (size_t j = i + 1; j < terms.size(); ++j) {
+                for (size_t s = j + 1; s < terms.size(); ++s) {
+                    if (triples_set.count({terms[i], terms[j], terms[s]}) > 0 or all_triples) {
+                        Query query;
+                        query.terms = {terms[i], terms[j], terms[s]};
+                        wand_q(
+                            make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+                        threshold = std::max(threshold, topk.size() == k ? topk.threshold() : 0.0F);
+                        topk.clear();
+                    }
+                }
+            }
+        }
+        std::cout << threshold << '\n';
+    }
+}
+
+using KthThresholdsFn = void(
+    const std::string& index_filename,
+    const std::string& wand_data_filename,
+    const std::vector<Query>& queries,
+    std::string const& type,
+    ScorerParams const& scorer_params,
+    uint64_t k,
+    bool quantized,
+    std::optional<std::string> pairs_filename,
+    std::optional<std::string> triples_filename,
+    bool all_pairs,
+    bool all_triples);
+
+}  // namespace pisa
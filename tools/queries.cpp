@@ -1,296 +1,19 @@
-#include <algorithm>
 #include <iostream>
-#include <numeric>
 #include <optional>
 #include <string>
 
 #include <CLI/CLI.hpp>
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/split.hpp>
-#include <range/v3/view/enumerate.hpp>
 #include <spdlog/sinks/null_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <tbb/global_control.h>
 
-#include "accumulator/lazy_accumulator.hpp"
 #include "app.hpp"
-#include "cursor/block_max_scored_cursor.hpp"
-#include "cursor/cursor.hpp"
-#include "cursor/max_scored_cursor.hpp"
-#include "cursor/scored_cursor.hpp"
-#include "index_types.hpp"
-#include "mappable/mapper.hpp"
-#include "memory_source.hpp"
-#include "query/algorithm.hpp"
-#include "scorer/scorer.hpp"
-#include "timer.hpp"
-#include "topk_queue.hpp"
-#include "util/util.hpp"
-#include "wand_data_compressed.hpp"
-#include "wand_data_raw.hpp"
+#include "index_registry.hpp"
+#include "queries.hpp"
+#include "wand_types.hpp"
 
 using namespace pisa;
-using ranges::views::enumerate;
-
-template <typename Fn>
-void extract_times(
-    Fn fn,
-    std::vector<Query> const& queries,
-    std::vector<Threshold> const& thresholds,
-    std::string const& index_type,
-    std::string const& query_type,
-    size_t runs,
-    std::ostream& os)
-{
-    std::vector<std::size_t> times(runs);
-    for (auto&& [qid, query]: enumerate(queries)) {
-        do_not_optimize_away(fn(query, thresholds[qid]));
-        std::generate(times.begin(), times.end(), [&fn, &q = query, &t = thresholds[qid]]() {
-            return run_with_timer<std::chrono::microseconds>(
-                       [&]() { do_not_optimize_away(fn(q, t)); })
-                .count();
-        });
-        auto mean = std::accumulate(times.begin(), times.end(), std::size_t{0}, std::plus<>()) / runs;
-        os << fmt::format("{}\t{}\n", query.id.value_or(std::to_string(qid)), mean);
-    }
-}
-
-template <typename Functor>
-void op_perftest(
-    Functor query_func,
-    std::vector<Query> const& queries,
-    std::vector<Threshold> const& thresholds,
-    std::string const& index_type,
-    std::string const& query_type,
-    size_t runs,
-    std::uint64_t k,
-    bool safe)
-{
-    std::vector<double> query_times;
-    std::size_t num_reruns = 0;
-    spdlog::info("Safe: {}", safe);
-
-    for (size_t run = 0; run <= runs; ++run) {
-        size_t idx = 0;
-        for (auto const& query: queries) {
-            auto usecs = run_with_timer<std::chrono::microseconds>([&]() {
-                uint64_t result = query_func(query, thresholds[idx]);
-                if (safe && result < k) {
-                    num_reruns += 1;
-                    result = query_func(query, 0);
-                }
-                do_not_optimize_away(result);
-            });
-            if (run != 0) {  // first run is not timed
-                query_times.push_back(usecs.count());
-            }
-            idx += 1;
-        }
-    }
-
-    if (false) {
-        for (auto t: query_times) {
-            std::cout << (t / 1000) << std::endl;
-        }
-    } else {
-        std::sort(query_times.begin(), query_times.end());
-        double avg =
-            std::accumulate(query_times.begin(), query_times.end(), double()) / query_times.size();
-        double q50 = query_times[query_times.size() / 2];
-        double q90 = query_times[90 * query_times.size() / 100];
-        double q95 = query_times[95 * query_times.size() / 100];
-        double q99 = query_times[99 * query_times.size() / 100];
-
-        spdlog::info("---- {} {}", index_type, query_type);
-        spdlog::info("Mean: {}", avg);
-        spdlog::info("50% quantile: {}", q50);
-        spdlog::info("90% quantile: {}", q90);
-        spdlog::info("95% quantile: {}", q95);
-        spdlog::info("99% quantile: {}", q99);
-        spdlog::info("Num. reruns: {}", num_reruns);
-
-        stats_line()("type", index_type)("query", query_type)("avg", avg)("q50", q50)("q90", q90)(
-            "q95", q95)("q99", q99);
-    }
-}
-
-template <typename IndexType, typename WandType>
-void perftest(
-    const std::string& index_filename,
-    const std::optional<std::string>& wand_data_filename,
-    const std::vector<Query>& queries,
-    const std::optional<std::string>& thresholds_filename,
-    std::string const& type,
-    std::string const& query_type,
-    uint64_t k,
-    const ScorerParams& scorer_params,
-    bool extract,
-    bool safe)
-{
-    spdlog::info("Loading index from {}", index_filename);
-    IndexType index(MemorySource::mapped_file(index_filename));
-
-    spdlog::info("Warming up posting lists");
-    std::unordered_set<term_id_type> warmed_up;
-    for (auto const& q: queries) {
-        for (auto t: q.terms) {
-            if (!warmed_up.count(t)) {
-                index.warmup(t);
-                warmed_up.insert(t);
-            }
-        }
-    }
-
-    WandType const wdata = [&] {
-        if (wand_data_filename) {
-            return WandType(MemorySource::mapped_file(*wand_data_filename));
-        }
-        return WandType{};
-    }();
-
-    std::vector<Threshold> thresholds(queries.size(), 0.0);
-    if (thresholds_filename) {
-        std::string t;
-        std::ifstream tin(*thresholds_filename);
-        size_t idx = 0;
-        while (std::getline(tin, t)) {
-            thresholds[idx] = std::stof(t);
-            idx += 1;
-        }
-        if (idx != queries.size()) {
-            throw std::invalid_argument("Invalid thresholds file.");
-        }
-    }
-
-    auto scorer = scorer::from_params(scorer_params, wdata);
-
-    spdlog::info("Performing {} queries", type);
-    spdlog::info("K: {}", k);
-
-    std::vector<std::string> query_types;
-    boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
-
-    for (auto&& t: query_types) {
-        spdlog::info("Query type: {}", t);
-        std::function<uint64_t(Query, Threshold)> query_fun;
-        if (t == "and") {
-            query_fun = [&](Query query, Threshold) {
-                and_query and_q;
-                return and_q(make_cursors(index, query), index.num_docs()).size();
-            };
-        } else if (t == "or") {
-            query_fun = [&](Query query, Threshold) {
-                or_query<false> or_q;
-                return or_q(make_cursors(index, query), index.num_docs());
-            };
-        } else if (t == "or_freq") {
-            query_fun = [&](Query query, Threshold) {
-                or_query<true> or_q;
-                return or_q(make_cursors(index, query), index.num_docs());
-            };
-        } else if (t == "wand" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                wand_query wand_q(topk);
-                wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_wand" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_maxscore_query block_max_maxscore_q(topk);
-                block_max_maxscore_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_and" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                ranked_and_query ranked_and_q(topk);
-                ranked_and_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "block_max_ranked_and" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_ranked_and_query block_max_ranked_and_q(topk);
-                block_max_ranked_and_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_or" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                ranked_or_query ranked_or_q(topk);
-                ranked_or_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                maxscore_query maxscore_q(topk);
-                maxscore_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_or_taat" && wand_data_filename) {
-            Simple_Accumulator accumulator(index.num_docs());
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            query_fun = [&, ranked_or_taat_q, accumulator](Query query, Threshold t) mutable {
-                topk.set_threshold(t);
-                ranked_or_taat_q(
-                    make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else if (t == "ranked_or_taat_lazy" && wand_data_filename) {
-            Lazy_Accumulator<4> accumulator(index.num_docs());
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            query_fun = [&, ranked_or_taat_q, accumulator](Query query, Threshold t) mutable {
-                topk.set_threshold(t);
-                ranked_or_taat_q(
-                    make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
-                topk.finalize();
-                return topk.topk().size();
-            };
-        } else {
-            spdlog::error("Unsupported query type: {}", t);
-            break;
-        }
-        if (extract) {
-            extract_times(query_fun, queries, thresholds, type, t, 2, std::cout);
-        } else {
-            op_perftest(query_fun, queries, thresholds, type, t, 2, k, safe);
-        }
-    }
-}
-
-using wand_raw_index = wand_data<wand_data_raw>;
-using wand_uniform_index = wand_data<wand_data_compressed<>>;
-using wand_uniform_index_quantized = wand_data<wand_data_compressed<PayloadType::Quantized>>;
 
 int main(int argc, const char** argv)
 {
@@ -298,19 +21,59 @@ int main(int argc, const char** argv)
     bool silent = false;
     bool safe = false;
     bool quantized = false;
+    std::vector<std::size_t> throughput_threads;
+    std::size_t intra_query_threads = 1;
+    std::optional<std::size_t> cache_queries;
+    std::optional<std::size_t> cache_results;
+    bool impact_ordered = false;
+    std::optional<std::size_t> postings_budget;
 
     App<arg::Index,
-        arg::WandData<arg::WandMode::Optional>,
+        arg::WandData<arg::WandMode::Optional, arg::WandRange::Supported>,
         arg::Query<arg::QueryMode::Ranked>,
         arg::Algorithm,
         arg::Scorer,
-        arg::Thresholds>
+        arg::Thresholds,
+        arg::Load>
         app{"Benchmarks queries on a given index."};
     app.add_flag("--quantized", quantized, "Quantized scores");
-    app.add_flag("--extract", extract, "Extract individual query times");
+    auto* extract_option = app.add_flag("--extract", extract, "Extract individual query times");
     app.add_flag("--silent", silent, "Suppress logging");
     app.add_flag("--safe", safe, "Rerun if not enough results with pruning.")
         ->needs(app.thresholds_option());
+    auto* throughput_option = app.add_option(
+           "--throughput",
+           throughput_threads,
+           "Measure throughput (QPS) with queries sharded over the given numbers of threads, "
+           "e.g., `--throughput 1 2 4 8`")
+        ->excludes(extract_option);
+    app.add_option(
+        "--intra-query-threads",
+        intra_query_threads,
+        "Process each query with this many threads by partitioning the document space "
+        "(wand, maxscore, and BlockMax algorithms)");
+    auto* cache_option = app.add_option(
+        "--cache-size",
+        cache_queries,
+        "Replay the queries with a result cache holding at most this many queries, "
+        "and compare latencies with and without the cache");
+    cache_option->excludes(extract_option)->excludes(throughput_option);
+    app.add_option(
+           "--cache-results",
+           cache_results,
+           "Maximum number of results stored in the cache (default: cache size times k)")
+        ->needs(cache_option);
+    auto* impact_option = app.add_flag(
+        "--impact-ordered",
+        impact_ordered,
+        "The index is impact-ordered (see compress_impact_ordered_index), "
+        "queried score-at-a-time with the `saat` query type");
+    impact_option->excludes(cache_option);
+    app.add_option(
+           "--postings-budget",
+           postings_budget,
+           "Stop score-at-a-time processing once this many postings have been processed")
+        ->needs(impact_option);
     CLI11_PARSE(app, argc, argv);
 
     if (silent) {
@@ -322,37 +85,55 @@ int main(int argc, const char** argv)
         std::cout << "qid\tusec\n";
     }
 
-    auto params = std::make_tuple(
-        app.index_filename(),
+    std::optional<tbb::global_control> control;
+    if (intra_query_threads > 1) {
+        control.emplace(tbb::global_control::max_allowed_parallelism, intra_query_threads);
+    }
+
+    if (impact_ordered) {
+        auto* run = IndexRegistry<ImpactPerftestFn>::instance().find(app.index_encoding());
+        if (run == nullptr) {
+            spdlog::error(
+                "Unknown type {}, impact-ordered indexes use block codecs", app.index_encoding());
+            return 0;
+        }
+        run(app.index_filename(),
+            app.queries(),
+            app.index_encoding(),
+            app.algorithm(),
+            app.k(),
+            extract,
+            throughput_threads,
+            postings_budget,
+            app.load_policy());
+        return 0;
+    }
+
+    std::optional<std::pair<std::size_t, std::size_t>> cache_size;
+    if (cache_queries) {
+        cache_size = std::make_pair(*cache_queries, cache_results.value_or(*cache_queries * app.k()));
+    }
+
+    auto wand_type = wand_type_name(app.is_wand_compressed(), quantized, app.is_wand_range());
+    auto* run = IndexRegistry<PerftestFn>::instance().find(
+        index_registry_key(app.index_encoding(), wand_type));
+    if (run == nullptr) {
+        spdlog::error("Unknown type {}", app.index_encoding());
+        return 0;
+    }
+    run(app.index_filename(),
         app.wand_data_path(),
         app.queries(),
         app.thresholds_file(),
+        app.kth_scores_file(),
         app.index_encoding(),
         app.algorithm(),
         app.k(),
         app.scorer_params(),
         extract,
-        safe);
-    /**/
-    if (false) {
-#define LOOP_BODY(R, DATA, T)                                                                        \
-    }                                                                                                \
-    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                          \
-    {                                                                                                \
-        if (app.is_wand_compressed()) {                                                              \
-            if (quantized) {                                                                         \
-                std::apply(perftest<BOOST_PP_CAT(T, _index), wand_uniform_index_quantized>, params); \
-            } else {                                                                                 \
-                std::apply(perftest<BOOST_PP_CAT(T, _index), wand_uniform_index>, params);           \
-            }                                                                                        \
-        } else {                                                                                     \
-            std::apply(perftest<BOOST_PP_CAT(T, _index), wand_raw_index>, params);                   \
-        }
-        /**/
-        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
-#undef LOOP_BODY
-
-    } else {
-        spdlog::error("Unknown type {}", app.index_encoding());
-    }
+        safe,
+        throughput_threads,
+        intra_query_threads,
+        cache_size,
+        app.load_policy());
 }
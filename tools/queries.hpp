@@ -0,0 +1,918 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <range/v3/view/enumerate.hpp>
+#include <spdlog/spdlog.h>
+
+#include "accumulator/lazy_accumulator.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/cursor.hpp"
+#include "cursor/impact_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/range_max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "kth_score_index.hpp"
+#include "load_policy.hpp"
+#include "memory_source.hpp"
+#include "pinned_index.hpp"
+#include "query/algorithm.hpp"
+#include "query/queries.hpp"
+#include "query/query_cache.hpp"
+#include "scorer/scorer.hpp"
+#include "timer.hpp"
+#include "topk_queue.hpp"
+#include "util/util.hpp"
+#include "wand_types.hpp"
+
+namespace pisa {
+
+template <typename Fn>
+void extract_times(
+    Fn fn,
+    std::vector<Query> const& queries,
+    std::vector<Threshold> const& thresholds,
+    std::string const& index_type,
+    std::string const& query_type,
+    size_t runs,
+    std::ostream& os)
+{
+    std::vector<std::size_t> times(runs);
+    for (auto&& [qid, query]: ranges::views::enumerate(queries)) {
+        do_not_optimize_away(fn(query, thresholds[qid]));
+        std::generate(times.begin(), times.end(), [&fn, &q = query, &t = thresholds[qid]]() {
+            return run_with_timer<std::chrono::microseconds>(
+                       [&]() { do_not_optimize_away(fn(q, t)); })
+                .count();
+        });
+        auto mean = std::accumulate(times.begin(), times.end(), std::size_t{0}, std::plus<>()) / runs;
+        os << fmt::format("{}\t{}\n", query.id.value_or(std::to_string(qid)), mean);
+    }
+}
+
+template <typename Functor>
+void op_perftest(
+    Functor query_func,
+    std::vector<Query> const& queries,
+    std::vector<Threshold> const& thresholds,
+    std::string const& index_type,
+    std::string const& query_type,
+    size_t runs,
+    std::uint64_t k,
+    bool safe)
+{
+    std::vector<double> query_times;
+    std::size_t num_reruns = 0;
+    spdlog::info("Safe: {}", safe);
+
+    for (size_t run = 0; run <= runs; ++run) {
+        size_t idx = 0;
+        for (auto const& query: queries) {
+            auto usecs = run_with_timer<std::chrono::microseconds>([&]() {
+                uint64_t result = query_func(query, thresholds[idx]);
+                if (safe && result < k) {
+                    num_reruns += 1;
+                    result = query_func(query, 0);
+                }
+                do_not_optimize_away(result);
+            });
+            if (run != 0) {  // first run is not timed
+                query_times.push_back(usecs.count());
+            }
+            idx += 1;
+        }
+    }
+
+    if (false) {
+        for (auto t: query_times) {
+            std::cout << (t / 1000) << std::endl;
+        }
+    } else {
+        std::sort(query_times.begin(), query_times.end());
+        double avg =
+            std::accumulate(query_times.begin(), query_times.end(), double()) / query_times.size();
+        double q50 = query_times[query_times.size() / 2];
+        double q90 = query_times[90 * query_times.size() / 100];
+        double q95 = query_times[95 * query_times.size() / 100];
+        double q99 = query_times[99 * query_times.size() / 100];
+
+        spdlog::info("---- {} {}", index_type, query_type);
+        spdlog::info("Mean: {}", avg);
+        spdlog::info("50% quantile: {}", q50);
+        spdlog::info("90% quantile: {}", q90);
+        spdlog::info("95% quantile: {}", q95);
+        spdlog::info("99% quantile: {}", q99);
+        spdlog::info("Num. reruns: {}", num_reruns);
+
+        stats_line()("type", index_type)("query", query_type)("avg", avg)("q50", q50)("q90", q90)(
+            "q95", q95)("q99", q99);
+    }
+}
+
+/// Warms up the posting lists of `index` selected by `policy`: those of its warmup terms and, if
+/// the index is loaded eagerly, those of all query terms. Returns the number of lists warmed up,
+/// including those already pinned in memory.
+template <typename Index>
+auto warmup_posting_lists(
+    Index const& index, std::vector<Query> const& queries, LoadPolicy const& policy) -> std::size_t
+{
+    spdlog::info("Warming up posting lists");
+    std::unordered_set<term_id_type> warmed_up;
+    auto warmup = [&](auto term) {
+        if (term < index.size() && warmed_up.insert(term).second) {
+            index.warmup(term);
+        }
+    };
+    for (auto t: policy.warmup_terms) {
+        warmup(t);
+    }
+    if (policy.paging == LoadPolicy::Paging::Eager) {
+        for (auto const& q: queries) {
+            for (auto t: q.terms) {
+                warmup(t);
+            }
+        }
+    }
+    return warmed_up.size();
+}
+
+/// Reports the time spent loading an index with its WAND data, and warming up its posting lists.
+inline void report_startup(
+    std::string const& index_type,
+    LoadPolicy const& policy,
+    std::chrono::steady_clock::duration load_time,
+    std::chrono::steady_clock::duration warmup_time,
+    std::size_t warmed_up)
+{
+    auto millis = [](auto duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+    auto paging = policy.paging == LoadPolicy::Paging::Eager ? "eager" : "lazy";
+    spdlog::info(
+        "Index loaded ({} paging) in {} ms, {} posting lists warmed up in {} ms",
+        paging,
+        millis(load_time),
+        warmed_up,
+        millis(warmup_time));
+    stats_line()("type", index_type)("paging", paging)("load_ms", millis(load_time))(
+        "warmup_ms", millis(warmup_time))("warmed_up_lists", warmed_up);
+}
+
+/// Reports the posting lists pinned in memory, and how many of the lookups they served.
+template <typename Index>
+void report_pinning(std::string const& index_type, pinned_index<Index> const& index)
+{
+    spdlog::info(
+        "{} posting lists pinned in {} bytes{}, hit rate: {}",
+        index.pinned_lists(),
+        index.pinned_bytes(),
+        index.locked() ? "" : " (not locked, see RLIMIT_MEMLOCK)",
+        index.hit_rate());
+    stats_line()("type", index_type)("pinned_lists", index.pinned_lists())(
+        "pinned_bytes", index.pinned_bytes())("pinned_hits", index.hits())(
+        "pinned_misses", index.misses())("pinned_hit_rate", index.hit_rate());
+}
+
+/// Pins the calling thread to `cpu` (modulo the number of available CPUs).
+/// Does nothing on platforms that do not support thread affinity.
+inline void pin_current_thread(std::size_t cpu)
+{
+#if defined(__linux__)
+    auto num_cpus = std::max(std::thread::hardware_concurrency(), 1U);
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu % num_cpus, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
+        spdlog::warn("Unable to pin thread to CPU {}", cpu % num_cpus);
+    }
+#else
+    (void)cpu;
+#endif
+}
+
+/// Measures the throughput of `query_func` by sharding the query stream over
+/// a number of worker threads, for each of the thread counts in `thread_counts`.
+///
+/// Each worker owns a copy of `query_func` (and therefore its own top-k queue, cursors, and
+/// accumulator), which is reused for all queries it processes. Queries are pulled
+/// from a shared counter, so that workers never wait on each other.
+template <typename Functor>
+void op_throughput(
+    Functor query_func,
+    std::vector<Query> const& queries,
+    std::vector<Threshold> const& thresholds,
+    std::string const& index_type,
+    std::string const& query_type,
+    std::vector<std::size_t> const& thread_counts,
+    size_t runs,
+    std::uint64_t k,
+    bool safe)
+{
+    if (queries.empty()) {
+        spdlog::warn("No queries to run");
+        return;
+    }
+    for (auto num_threads: thread_counts) {
+        if (num_threads == 0) {
+            spdlog::error("Number of threads must be positive");
+            continue;
+        }
+        std::size_t const total_queries = queries.size() * runs;
+        std::vector<std::vector<double>> thread_times(num_threads);
+        std::vector<std::size_t> thread_reruns(num_threads, 0);
+        std::atomic_size_t next_query{0};
+        std::atomic_size_t ready{0};
+        std::atomic_bool go{false};
+
+        auto worker = [&](std::size_t thread_idx) {
+            pin_current_thread(thread_idx);
+            auto fn = query_func;
+            auto& times = thread_times[thread_idx];
+            times.reserve(total_queries / num_threads + 1);
+
+            // Warm up the worker on its share of the queries, untimed.
+            for (auto idx = thread_idx; idx < queries.size(); idx += num_threads) {
+                do_not_optimize_away(fn(queries[idx], thresholds[idx]));
+            }
+
+            ready.fetch_add(1);
+            while (not go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            for (auto pos = next_query.fetch_add(1); pos < total_queries;
+                 pos = next_query.fetch_add(1)) {
+                auto idx = pos % queries.size();
+                auto usecs = run_with_timer<std::chrono::microseconds>([&]() {
+                    uint64_t result = fn(queries[idx], thresholds[idx]);
+                    if (safe && result < k) {
+                        thread_reruns[thread_idx] += 1;
+                        result = fn(queries[idx], 0);
+                    }
+                    do_not_optimize_away(result);
+                });
+                times.push_back(usecs.count());
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(num_threads);
+        for (std::size_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
+            workers.emplace_back(worker, thread_idx);
+        }
+        while (ready.load() < num_threads) {
+            std::this_thread::yield();
+        }
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& thread: workers) {
+            thread.join();
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        std::vector<double> query_times;
+        query_times.reserve(total_queries);
+        for (auto const& times: thread_times) {
+            query_times.insert(query_times.end(), times.begin(), times.end());
+        }
+        std::size_t num_reruns =
+            std::accumulate(thread_reruns.begin(), thread_reruns.end(), std::size_t{0});
+
+        std::sort(query_times.begin(), query_times.end());
+        double avg =
+            std::accumulate(query_times.begin(), query_times.end(), double()) / query_times.size();
+        double q50 = query_times[query_times.size() / 2];
+        double q90 = query_times[90 * query_times.size() / 100];
+        double q95 = query_times[95 * query_times.size() / 100];
+        double q99 = query_times[99 * query_times.size() / 100];
+        double qps = total_queries / (static_cast<double>(elapsed.count()) / 1'000'000);
+
+        spdlog::info("---- {} {} ({} threads)", index_type, query_type, num_threads);
+        spdlog::info("Throughput (QPS): {}", qps);
+        spdlog::info("Mean: {}", avg);
+        spdlog::info("50% quantile: {}", q50);
+        spdlog::info("90% quantile: {}", q90);
+        spdlog::info("95% quantile: {}", q95);
+        spdlog::info("99% quantile: {}", q99);
+        spdlog::info("Num. reruns: {}", num_reruns);
+
+        stats_line()("type", index_type)("query", query_type)("threads", num_threads)("qps", qps)(
+            "avg", avg)("q50", q50)("q90", q90)("q95", q95)("q99", q99);
+    }
+}
+
+/// Cursors reused across the queries run by a query function.
+///
+/// Copies start out empty, so that each copy of a query function, such as the one owned by
+/// every worker of `op_throughput`, fills its own buffer.
+template <typename Cursor>
+struct CursorBuffer {
+    CursorBuffer() = default;
+    CursorBuffer(CursorBuffer const&) {}
+    CursorBuffer(CursorBuffer&&) noexcept = default;
+    CursorBuffer& operator=(CursorBuffer const&)
+    {
+        cursors.clear();
+        return *this;
+    }
+    CursorBuffer& operator=(CursorBuffer&&) noexcept = default;
+    ~CursorBuffer() = default;
+
+    std::vector<Cursor> cursors;
+};
+
+/// Top-k queue and query algorithm working on it, reused across the queries run by a query
+/// function, so that algorithms keeping buffers reuse them too.
+///
+/// Copies get their own queue and algorithm.
+template <typename QueryAlg>
+struct RankedQueryState {
+    explicit RankedQueryState(std::size_t k) : topk(k), query_alg(topk) {}
+    RankedQueryState(RankedQueryState const& other) : RankedQueryState(other.topk.capacity()) {}
+    RankedQueryState& operator=(RankedQueryState const&) = delete;
+    ~RankedQueryState() = default;
+
+    topk_queue topk;
+    QueryAlg query_alg;
+};
+
+struct RankedQueryOptions {
+    /// If greater than one, the docid space is partitioned and the ranges are processed in parallel.
+    std::size_t intra_query_threads = 1;
+    /// If not null, results are looked up in and stored to this cache.
+    QueryCache* cache = nullptr;
+    /// If not null, used to estimate a safe initial threshold of each query.
+    KthScoreIndex const* kth_scores = nullptr;
+};
+
+/// Runs the query algorithm of `state` on `cursors`, filled by `make_cursors(cursors)`,
+/// and returns the number of results.
+template <typename QueryAlg, typename Cursors, typename CursorFactory>
+auto run_ranked_query(
+    RankedQueryState<QueryAlg>& state,
+    Cursors& cursors,
+    Query const& query,
+    Threshold threshold,
+    CursorFactory make_cursors,
+    uint64_t max_docid,
+    RankedQueryOptions const& options) -> std::size_t
+{
+    auto& topk = state.topk;
+    topk.clear();
+    if (options.kth_scores != nullptr) {
+        threshold =
+            std::max(threshold, options.kth_scores->estimate_threshold(query, topk.capacity()));
+    }
+    topk.set_threshold(threshold);
+    std::optional<QueryCache::key_type> key;
+    if (options.cache != nullptr) {
+        key = QueryCache::key(query);
+        auto lookup = options.cache->find(*key);
+        if (lookup.results != nullptr) {
+            for (auto const& [score, docid]: *lookup.results) {
+                topk.insert(score, docid);
+            }
+            topk.finalize();
+            return topk.topk().size();
+        }
+        if (lookup.threshold) {
+            topk.set_threshold(std::max(threshold, *lookup.threshold));
+        }
+    }
+    if (options.intra_query_threads > 1) {
+        parallel_range_query<QueryAlg> query_alg(topk, options.intra_query_threads * 4);
+        query_alg(
+            [&] {
+                Cursors range_cursors;
+                make_cursors(range_cursors);
+                return range_cursors;
+            },
+            max_docid);
+    } else {
+        make_cursors(cursors);
+        state.query_alg(cursors, max_docid);
+    }
+    topk.finalize();
+    if (key) {
+        options.cache->insert(std::move(*key), topk.topk());
+    }
+    return topk.topk().size();
+}
+
+/// Replays the queries once in order, first without and then with `cache`,
+/// and reports the latencies of both runs along with the cache statistics.
+template <typename Functor>
+void op_replay(
+    Functor query_func,
+    std::vector<Query> const& queries,
+    std::vector<Threshold> const& thresholds,
+    std::string const& index_type,
+    std::string const& query_type,
+    QueryCache& cache,
+    RankedQueryOptions& options)
+{
+    auto replay = [&]() {
+        std::vector<double> query_times;
+        query_times.reserve(queries.size());
+        for (auto&& [idx, query]: ranges::views::enumerate(queries)) {
+            auto usecs = run_with_timer<std::chrono::microseconds>(
+                [&]() { do_not_optimize_away(query_func(query, thresholds[idx])); });
+            query_times.push_back(usecs.count());
+        }
+        std::sort(query_times.begin(), query_times.end());
+        return query_times;
+    };
+
+    options.cache = nullptr;
+    replay();  // not timed, warms up the posting lists
+    auto uncached_times = replay();
+    cache.clear();
+    options.cache = &cache;
+    auto cached_times = replay();
+    options.cache = nullptr;
+
+    if (cache.hits() + cache.partial_hits() + cache.misses() == 0) {
+        spdlog::warn("Query type {} does not use the cache", query_type);
+    }
+
+    auto mean = [](std::vector<double> const& times) {
+        return std::accumulate(times.begin(), times.end(), double()) / times.size();
+    };
+    auto quantile = [](std::vector<double> const& times, std::size_t percent) {
+        return times[percent * times.size() / 100];
+    };
+    spdlog::info("---- {} {} (cache replay)", index_type, query_type);
+    spdlog::info("Mean: {} (without cache: {})", mean(cached_times), mean(uncached_times));
+    for (auto percent: {50, 90, 95, 99}) {
+        spdlog::info(
+            "{}% quantile: {} (without cache: {})",
+            percent,
+            quantile(cached_times, percent),
+            quantile(uncached_times, percent));
+    }
+    spdlog::info(
+        "Cache hits: {}, partial hits: {}, misses: {}, hit rate: {}",
+        cache.hits(),
+        cache.partial_hits(),
+        cache.misses(),
+        cache.hit_rate());
+
+    stats_line()("type", index_type)("query", query_type)("avg", mean(cached_times))(
+        "q50", quantile(cached_times, 50))("q90", quantile(cached_times, 90))(
+        "q95", quantile(cached_times, 95))("q99", quantile(cached_times, 99))(
+        "uncached_avg", mean(uncached_times))("uncached_q50", quantile(uncached_times, 50))(
+        "uncached_q99", quantile(uncached_times, 99))("hits", cache.hits())(
+        "partial_hits", cache.partial_hits())("misses", cache.misses());
+}
+
+/// Runs the queries of `perftest` on `index`, after warming up its posting lists. The time since
+/// `warmup_start` is reported as the warmup time.
+template <typename Index, typename WandType>
+void perftest_index(
+    Index const& index,
+    WandType const& wdata,
+    const std::optional<std::string>& wand_data_filename,
+    const std::vector<Query>& queries,
+    const std::optional<std::string>& thresholds_filename,
+    const std::optional<std::string>& kth_scores_filename,
+    std::string const& type,
+    std::string const& query_type,
+    uint64_t k,
+    const ScorerParams& scorer_params,
+    bool extract,
+    bool safe,
+    std::vector<std::size_t> const& throughput_threads,
+    std::size_t intra_query_threads,
+    std::optional<std::pair<std::size_t, std::size_t>> cache_size,
+    LoadPolicy const& load_policy,
+    std::chrono::steady_clock::duration load_time,
+    std::chrono::steady_clock::time_point warmup_start)
+{
+    auto warmed_up = warmup_posting_lists(index, queries, load_policy);
+    if (not extract) {
+        report_startup(
+            type,
+            load_policy,
+            load_time,
+            std::chrono::steady_clock::now() - warmup_start,
+            warmed_up);
+    }
+
+    std::vector<Threshold> thresholds(queries.size(), 0.0);
+    if (thresholds_filename) {
+        std::string t;
+        std::ifstream tin(*thresholds_filename);
+        size_t idx = 0;
+        while (std::getline(tin, t)) {
+            thresholds[idx] = std::stof(t);
+            idx += 1;
+        }
+        if (idx != queries.size()) {
+            throw std::invalid_argument("Invalid thresholds file.");
+        }
+    }
+
+    auto scorer = scorer::from_params(scorer_params, wdata);
+
+    std::optional<KthScoreIndex> kth_scores;
+    if (kth_scores_filename) {
+        kth_scores.emplace(MemorySource::mapped_file(*kth_scores_filename));
+        if (kth_scores->max_k() < k) {
+            spdlog::warn(
+                "K-th score index was built for k up to {}, thresholds will not be estimated",
+                kth_scores->max_k());
+        }
+    }
+
+    RankedQueryOptions options{intra_query_threads, nullptr, kth_scores ? &*kth_scores : nullptr};
+    std::optional<QueryCache> cache;
+    if (cache_size) {
+        cache.emplace(k, cache_size->first, cache_size->second);
+    }
+
+    spdlog::info("Performing {} queries", type);
+    spdlog::info("K: {}", k);
+
+    using Enumerator = typename Index::document_enumerator;
+    using ScoredBuffer = CursorBuffer<ScoredCursor<Enumerator>>;
+    using MaxScoredBuffer = CursorBuffer<MaxScoredCursor<Enumerator>>;
+    using BlockMaxScoredBuffer = CursorBuffer<BlockMaxScoredCursor<Enumerator, WandType>>;
+
+    std::vector<std::string> query_types;
+    boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
+
+    for (auto&& t: query_types) {
+        spdlog::info("Query type: {}", t);
+        std::function<uint64_t(Query, Threshold)> query_fun;
+        if (t == "and") {
+            query_fun = [&, buffer = CursorBuffer<Enumerator>()](Query query, Threshold) mutable {
+                and_query and_q;
+                make_cursors(index, query, buffer.cursors);
+                return and_q(buffer.cursors, index.num_docs()).size();
+            };
+        } else if (t == "or") {
+            query_fun = [&, buffer = CursorBuffer<Enumerator>()](Query query, Threshold) mutable {
+                or_query<false> or_q;
+                make_cursors(index, query, buffer.cursors);
+                return or_q(buffer.cursors, index.num_docs());
+            };
+        } else if (t == "or_freq") {
+            query_fun = [&, buffer = CursorBuffer<Enumerator>()](Query query, Threshold) mutable {
+                or_query<true> or_q;
+                make_cursors(index, query, buffer.cursors);
+                return or_q(buffer.cursors, index.num_docs());
+            };
+        } else if (t == "wand" && wand_data_filename) {
+            query_fun = [&, state = RankedQueryState<wand_query>(k), buffer = MaxScoredBuffer()](
+                            Query query, Threshold t) mutable {
+                return run_ranked_query(
+                    state,
+                    buffer.cursors,
+                    query,
+                    t,
+                    [&](auto& cursors) {
+                        make_max_scored_cursors(index, wdata, *scorer, query, cursors);
+                    },
+                    index.num_docs(),
+                    options);
+            };
+        } else if (t == "block_max_wand" && wand_data_filename) {
+            query_fun = [&,
+                         state = RankedQueryState<block_max_wand_query>(k),
+                         buffer = BlockMaxScoredBuffer()](Query query, Threshold t) mutable {
+                return run_ranked_query(
+                    state,
+                    buffer.cursors,
+                    query,
+                    t,
+                    [&](auto& cursors) {
+                        make_block_max_scored_cursors(index, wdata, *scorer, query, cursors);
+                    },
+                    index.num_docs(),
+                    options);
+            };
+        } else if (t == "block_max_wand_simd" && wand_data_filename) {
+            query_fun = [&,
+                         state = RankedQueryState<block_max_wand_simd_query>(k),
+                         buffer = BlockMaxScoredBuffer()](Query query, Threshold t) mutable {
+                return run_ranked_query(
+                    state,
+                    buffer.cursors,
+                    query,
+                    t,
+                    [&](auto& cursors) {
+                        make_block_max_scored_cursors(index, wdata, *scorer, query, cursors);
+                    },
+                    index.num_docs(),
+                    options);
+            };
+        } else if (t == "block_max_maxscore" && wand_data_filename) {
+            query_fun = [&,
+                         state = RankedQueryState<block_max_maxscore_query>(k),
+                         buffer = BlockMaxScoredBuffer()](Query query, Threshold t) mutable {
+                return run_ranked_query(
+                    state,
+                    buffer.cursors,
+                    query,
+                    t,
+                    [&](auto& cursors) {
+                        make_block_max_scored_cursors(index, wdata, *scorer, query, cursors);
+                    },
+                    index.num_docs(),
+                    options);
+            };
+        } else if (t == "range_maxscore" && wand_data_filename) {
+            if constexpr (std::is_same_v<WandType, wand_range_index>) {
+                query_fun = [&,
+                             topk = topk_queue(k),
+                             buffer = CursorBuffer<RangeMaxScoredCursor<Enumerator, WandType>>()](
+                                Query query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    range_maxscore_query range_maxscore_q(topk);
+                    make_range_max_scored_cursors(index, wdata, *scorer, query, buffer.cursors);
+                    range_maxscore_q(buffer.cursors, index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else {
+                spdlog::error("Query type {} requires range WAND data (--range-wand)", t);
+                break;
+            }
+        } else if (t == "ranked_and" && wand_data_filename) {
+            query_fun = [&, topk = topk_queue(k), buffer = ScoredBuffer()](
+                            Query query, Threshold t) mutable {
+                topk.clear();
+                topk.set_threshold(t);
+                ranked_and_query ranked_and_q(topk);
+                make_scored_cursors(index, *scorer, query, buffer.cursors);
+                ranked_and_q(buffer.cursors, index.num_docs());
+                topk.finalize();
+                return topk.topk().size();
+            };
+        } else if (t == "block_max_ranked_and" && wand_data_filename) {
+            query_fun = [&, topk = topk_queue(k), buffer = BlockMaxScoredBuffer()](
+                            Query query, Threshold t) mutable {
+                topk.clear();
+                topk.set_threshold(t);
+                block_max_ranked_and_query block_max_ranked_and_q(topk);
+                make_block_max_scored_cursors(index, wdata, *scorer, query, buffer.cursors);
+                block_max_ranked_and_q(buffer.cursors, index.num_docs());
+                topk.finalize();
+                return topk.topk().size();
+            };
+        } else if (t == "ranked_or" && wand_data_filename) {
+            query_fun = [&, topk = topk_queue(k), buffer = ScoredBuffer()](
+                            Query query, Threshold t) mutable {
+                topk.clear();
+                topk.set_threshold(t);
+                ranked_or_query ranked_or_q(topk);
+                make_scored_cursors(index, *scorer, query, buffer.cursors);
+                ranked_or_q(buffer.cursors, index.num_docs());
+                topk.finalize();
+                return topk.topk().size();
+            };
+        } else if (t == "maxscore" && wand_data_filename) {
+            query_fun = [&,
+                         state = RankedQueryState<maxscore_query>(k),
+                         buffer = MaxScoredBuffer()](Query query, Threshold t) mutable {
+                return run_ranked_query(
+                    state,
+                    buffer.cursors,
+                    query,
+                    t,
+                    [&](auto& cursors) {
+                        make_max_scored_cursors(index, wdata, *scorer, query, cursors);
+                    },
+                    index.num_docs(),
+                    options);
+            };
+        } else if (t == "ranked_or_taat" && wand_data_filename) {
+            query_fun = [&,
+                         topk = topk_queue(k),
+                         accumulator = Simple_Accumulator(index.num_docs()),
+                         buffer = ScoredBuffer()](Query query, Threshold t) mutable {
+                topk.clear();
+                topk.set_threshold(t);
+                ranked_or_taat_query ranked_or_taat_q(topk);
+                make_scored_cursors(index, *scorer, query, buffer.cursors);
+                ranked_or_taat_q(buffer.cursors, index.num_docs(), accumulator);
+                topk.finalize();
+                return topk.topk().size();
+            };
+        } else if (t == "ranked_or_taat_lazy" && wand_data_filename) {
+            query_fun = [&,
+                         topk = topk_queue(k),
+                         accumulator = Lazy_Accumulator<4>(index.num_docs()),
+                         buffer = ScoredBuffer()](Query query, Threshold t) mutable {
+                topk.clear();
+                topk.set_threshold(t);
+                ranked_or_taat_query ranked_or_taat_q(topk);
+                make_scored_cursors(index, *scorer, query, buffer.cursors);
+                ranked_or_taat_q(buffer.cursors, index.num_docs(), accumulator);
+                topk.finalize();
+                return topk.topk().size();
+            };
+        } else {
+            spdlog::error("Unsupported query type: {}", t);
+            break;
+        }
+        if (extract) {
+            extract_times(query_fun, queries, thresholds, type, t, 2, std::cout);
+        } else if (not throughput_threads.empty()) {
+            op_throughput(query_fun, queries, thresholds, type, t, throughput_threads, 2, k, safe);
+        } else if (cache) {
+            op_replay(query_fun, queries, thresholds, type, t, *cache, options);
+        } else {
+            op_perftest(query_fun, queries, thresholds, type, t, 2, k, safe);
+        }
+    }
+}
+
+template <typename IndexType, typename WandType>
+void perftest(
+    const std::string& index_filename,
+    const std::optional<std::string>& wand_data_filename,
+    const std::vector<Query>& queries,
+    const std::optional<std::string>& thresholds_filename,
+    const std::optional<std::string>& kth_scores_filename,
+    std::string const& type,
+    std::string const& query_type,
+    uint64_t k,
+    const ScorerParams& scorer_params,
+    bool extract,
+    bool safe,
+    std::vector<std::size_t> const& throughput_threads,
+    std::size_t intra_query_threads,
+    std::optional<std::pair<std::size_t, std::size_t>> cache_size,
+    LoadPolicy const& load_policy)
+{
+    spdlog::info("Loading index from {}", index_filename);
+    auto load_start = std::chrono::steady_clock::now();
+    IndexType mapped_index(
+        MemorySource::mapped_file(index_filename, load_policy.map_options()),
+        load_policy.map_flags());
+    WandType const wdata = [&] {
+        if (wand_data_filename) {
+            return WandType(
+                MemorySource::mapped_file(*wand_data_filename, load_policy.map_options()),
+                load_policy.map_flags());
+        }
+        return WandType{};
+    }();
+    auto warmup_start = std::chrono::steady_clock::now();
+    auto run = [&](auto const& index) {
+        perftest_index(
+            index,
+            wdata,
+            wand_data_filename,
+            queries,
+            thresholds_filename,
+            kth_scores_filename,
+            type,
+            query_type,
+            k,
+            scorer_params,
+            extract,
+            safe,
+            throughput_threads,
+            intra_query_threads,
+            cache_size,
+            load_policy,
+            warmup_start - load_start,
+            warmup_start);
+    };
+    // Without a budget, nothing is pinned, and lookups go to the index directly.
+    if (load_policy.pin_budget > 0) {
+        pinned_index<IndexType> const index(
+            mapped_index, load_policy.warmup_terms, load_policy.pin_budget);
+        run(index);
+        if (not extract) {
+            report_pinning(type, index);
+        }
+    } else {
+        run(mapped_index);
+    }
+}
+
+template <typename IndexType>
+void impact_perftest(
+    const std::string& index_filename,
+    std::vector<Query> const& queries,
+    std::string const& type,
+    std::string const& query_type,
+    uint64_t k,
+    bool extract,
+    std::vector<std::size_t> const& throughput_threads,
+    std::optional<std::size_t> postings_budget,
+    LoadPolicy const& load_policy)
+{
+    spdlog::info("Loading impact-ordered index from {}", index_filename);
+    auto load_start = std::chrono::steady_clock::now();
+    IndexType index(
+        MemorySource::mapped_file(index_filename, load_policy.map_options()),
+        load_policy.map_flags());
+    auto warmup_start = std::chrono::steady_clock::now();
+    auto warmed_up = warmup_posting_lists(index, queries, load_policy);
+    if (not extract) {
+        report_startup(
+            type,
+            load_policy,
+            warmup_start - load_start,
+            std::chrono::steady_clock::now() - warmup_start,
+            warmed_up);
+    }
+
+    std::vector<Threshold> thresholds(queries.size(), 0.0);
+    auto budget = postings_budget.value_or(std::numeric_limits<std::size_t>::max());
+
+    spdlog::info("Performing {} queries", type);
+    spdlog::info("K: {}", k);
+    if (postings_budget) {
+        spdlog::info("Postings budget: {}", *postings_budget);
+    }
+
+    using ImpactBuffer = CursorBuffer<ImpactCursor<typename IndexType::segment_enumerator>>;
+
+    std::vector<std::string> query_types;
+    boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
+
+    for (auto&& t: query_types) {
+        spdlog::info("Query type: {}", t);
+        std::function<uint64_t(Query, Threshold)> query_fun;
+        if (t == "saat") {
+            query_fun = [&,
+                         topk = topk_queue(k),
+                         accumulator = Lazy_Accumulator<4>(index.num_docs()),
+                         buffer = ImpactBuffer()](Query query, Threshold) mutable {
+                topk.clear();
+                saat_query saat_q(topk, budget);
+                make_impact_cursors(index, query, buffer.cursors);
+                saat_q(buffer.cursors, accumulator);
+                topk.finalize();
+                return topk.topk().size();
+            };
+        } else {
+            spdlog::error("Unsupported query type for impact-ordered indexes: {}", t);
+            break;
+        }
+        if (extract) {
+            extract_times(query_fun, queries, thresholds, type, t, 2, std::cout);
+        } else if (not throughput_threads.empty()) {
+            op_throughput(query_fun, queries, thresholds, type, t, throughput_threads, 2, k, false);
+        } else {
+            op_perftest(query_fun, queries, thresholds, type, t, 2, k, false);
+        }
+    }
+}
+
+using PerftestFn = void(
+    std::string const& index_filename,
+    std::optional<std::string> const& wand_data_filename,
+    std::vector<Query> const& queries,
+    std::optional<std::string> const& thresholds_filename,
+    std::optional<std::string> const& kth_scores_filename,
+    std::string const& type,
+    std::string const& query_type,
+    uint64_t k,
+    ScorerParams const& scorer_params,
+    bool extract,
+    bool safe,
+    std::vector<std::size_t> const& throughput_threads,
+    std::size_t intra_query_threads,
+    std::optional<std::pair<std::size_t, std::size_t>> cache_size,
+    LoadPolicy const& load_policy);
+
+using ImpactPerftestFn = void(
+    std::string const& index_filename,
+    std::vector<Query> const& queries,
+    std::string const& type,
+    std::string const& query_type,
+    uint64_t k,
+    bool extract,
+    std::vector<std::size_t> const& throughput_threads,
+    std::optional<std::size_t> postings_budget,
+    LoadPolicy const& load_policy);
+
+}  // namespace pisa
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/range/adaptor/transformed.hpp>
+#include <spdlog/spdlog.h>
+
+#include "cursor/cursor.hpp"
+#include "index_types.hpp"
+#include "memory_source.hpp"
+#include "query/algorithm.hpp"
+#include "query/queries.hpp"
+
+namespace pisa {
+
+template <typename IndexType>
+void selective_queries(
+    const std::string& index_filename,
+    std::string const& encoding,
+    std::vector<Query> const& queries)
+{
+    spdlog::info("Loading index from {}", index_filename);
+    IndexType index(MemorySource::mapped_file(index_filename));
+
+    spdlog::info("Performing {} queries", encoding);
+
+    using boost::adaptors::transformed;
+    using boost::algorithm::join;
+    for (auto const& query: queries) {
+        size_t and_results = and_query()(make_cursors(index, query), index.num_docs()).size();
+        size_t or_results = or_query<false>()(make_cursors(index, query), index.num_docs());
+
+        double selectiveness = double(and_results) / double(or_results);
+        if (selectiveness < 0.005) {
+            std::cout
+                << join(query.terms | transformed([](auto d) { return std::to_string(d); }), " ")
+                << '\n';
+        }
+    }
+}
+
+using SelectiveQueriesFn = void(
+    const std::string& index_filename,
+    std::string const& encoding,
+    std::vector<Query> const& queries);
+
+}  // namespace pisa
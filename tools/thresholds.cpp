@@ -1,63 +1,17 @@
 #include <iostream>
-#include <optional>
-#include <tuple>
+#include <limits>
 
 #include <CLI/CLI.hpp>
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/split.hpp>
-#include <mio/mmap.hpp>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
 #include "app.hpp"
-#include "cursor/max_scored_cursor.hpp"
-#include "cursor/scored_cursor.hpp"
-#include "index_types.hpp"
-#include "io.hpp"
-#include "mappable/mapper.hpp"
-#include "memory_source.hpp"
-#include "query/algorithm.hpp"
-#include "scorer/scorer.hpp"
-#include "util/util.hpp"
-#include "wand_data_compressed.hpp"
-#include "wand_data_raw.hpp"
+#include "index_registry.hpp"
+#include "thresholds.hpp"
+#include "wand_types.hpp"
 
 using namespace pisa;
 
-template <typename IndexType, typename WandType>
-void thresholds(
-    const std::string& index_filename,
-    const std::string& wand_data_filename,
-    const std::vector<Query>& queries,
-    std::string const& type,
-    ScorerParams const& scorer_params,
-    uint64_t k,
-    bool quantized)
-{
-    IndexType index(MemorySource::mapped_file(index_filename));
-    WandType const wdata(MemorySource::mapped_file(wand_data_filename));
-
-    auto scorer = scorer::from_params(scorer_params, wdata);
-
-    topk_queue topk(k);
-    wand_query wand_q(topk);
-    for (auto const& query: queries) {
-        wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-        topk.finalize();
-        auto results = topk.topk();
-        topk.clear();
-        float threshold = 0.0;
-        if (results.size() == k) {
-            threshold = results.back().first;
-        }
-        std::cout << threshold << '\n';
-    }
-}
-
-using wand_raw_index = wand_data<wand_data_raw>;
-using wand_uniform_index = wand_data<wand_data_compressed<>>;
-using wand_uniform_index_quantized = wand_data<wand_data_compressed<PayloadType::Quantized>>;
-
 int main(int argc, const char** argv)
 {
     spdlog::drop("");
@@ -74,36 +28,18 @@ int main(int argc, const char** argv)
 
     CLI11_PARSE(app, argc, argv);
 
-    auto params = std::make_tuple(
-        app.index_filename(),
+    auto wand_type = wand_type_name(app.is_wand_compressed(), quantized, false);
+    auto* run = IndexRegistry<ThresholdsFn>::instance().find(
+        index_registry_key(app.index_encoding(), wand_type));
+    if (run == nullptr) {
+        spdlog::error("Unknown type {}", app.index_encoding());
+        return 0;
+    }
+    run(app.index_filename(),
         app.wand_data_path(),
         app.queries(),
         app.index_encoding(),
         app.scorer_params(),
         app.k(),
         quantized);
-
-    /**/
-    if (false) {
-#define LOOP_BODY(R, DATA, T)                                                                   \
-    }                                                                                           \
-    else if (app.index_encoding() == BOOST_PP_STRINGIZE(T))                                     \
-    {                                                                                           \
-        if (app.is_wand_compressed()) {                                                         \
-            if (quantized) {                                                                    \
-                std::apply(                                                                     \
-                    thresholds<BOOST_PP_CAT(T, _index), wand_uniform_index_quantized>, params); \
-            } else {                                                                            \
-                std::apply(thresholds<BOOST_PP_CAT(T, _index), wand_uniform_index>, params);    \
-            }                                                                                   \
-        } else {                                                                                \
-            std::apply(thresholds<BOOST_PP_CAT(T, _index), wand_raw_index>, params);            \
-        }
-        /**/
-        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
-#undef LOOP_BODY
-
-    } else {
-        spdlog::error("Unknown type {}", app.index_encoding());
-    }
 }
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cursor/max_scored_cursor.hpp"
+#include "index_types.hpp"
+#include "memory_source.hpp"
+#include "query/algorithm.hpp"
+#include "query/queries.hpp"
+#include "scorer/scorer.hpp"
+#include "wand_types.hpp"
+
+namespace pisa {
+
+template <typename IndexType, typename WandType>
+void thresholds(
+    const std::string& index_filename,
+    const std::string& wand_data_filename,
+    const std::vector<Query>& queries,
+    std::string const& type,
+    ScorerParams const& scorer_params,
+    uint64_t k,
+    bool quantized)
+{
+    IndexType index(MemorySource::mapped_file(index_filename));
+    WandType const wdata(MemorySource::mapped_file(wand_data_filename));
+
+    auto scorer = scorer::from_params(scorer_params, wdata);
+
+    topk_queue topk(k);
+    wand_query wand_q(topk);
+    for (auto const& query: queries) {
+        wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+        topk.finalize();
+        auto results = topk.topk();
+        topk.clear();
+        float threshold = 0.0;
+        if (results.size() == k) {
+            threshold = results.back().first;
+        }
+        std::cout << threshold << '\n';
+    }
+}
+
+using ThresholdsFn = void(
+    const std::string& index_filename,
+    const std::string& wand_data_filename,
+    const std::vector<Query>& queries,
+    std::string const& type,
+    ScorerParams const& scorer_params,
+    uint64_t k,
+    bool quantized);
+
+}  // namespace pisa
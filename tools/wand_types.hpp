@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_range.hpp"
+#include "wand_data_raw.hpp"
+
+namespace pisa {
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed<>>;
+using wand_uniform_index_quantized = wand_data<wand_data_compressed<PayloadType::Quantized>>;
+using wand_range_index = wand_data<wand_data_range<128, 1024>>;
+
+/// Name of the type of WAND data selected by the command line flags, under which functions
+/// instantiated for it are registered (see `tools/CMakeLists.txt`).
+inline auto wand_type_name(bool compressed, bool quantized, bool range) -> std::string
+{
+    if (compressed) {
+        return quantized ? "quantized" : "compressed";
+    }
+    if (range) {
+        return "range";
+    }
+    return "raw";
+}
+
+}  // namespace pisa